@@ -0,0 +1,345 @@
+/* atlas.c: Texture atlases.
+ *
+ * Small pixmaps meant for menus, toolbars and icons are numerous and
+ * usually drawn together, they are packed into shared atlases with
+ * a shelf packer, so that each window renderer draws them from a
+ * single texture. Pixmaps are inserted incrementally, updating the
+ * textures already uploaded in place, atlases are compacted once
+ * enough of them is left unused by removed pixmaps.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Gap left between packed pixmaps, so that filtering doesn't bleed
+ * neighbouring pixels in.
+ */
+#define DANTE_ATLAS_PADDING 1
+
+/* Returns true if pixmaps with the 'usage' hint should be packed. */
+static UDboolean danteAtlasUsage(UDenum usage);
+/* Allocates a 'w' x 'h' area of 'atlas' into 'rect', it returns
+ * false if it doesn't fit.
+ */
+static UDboolean danteAtlasPack(DanteAtlas* atlas, int w, int h, SDL_Rect* rect);
+/* Copies the pixels of the pixmap 'obj' into 'rect' of 'pixels'. */
+static void danteAtlasCopy(SDL_Surface* pixels, const DanteObject* obj, const SDL_Rect* rect);
+/* Packs every pixmap of 'atlas' again from scratch, reclaiming the
+ * areas of removed pixmaps, pixmaps that don't fit anymore are
+ * removed, it returns false if out of memory.
+ */
+static UDboolean danteAtlasCompact(DanteAtlas* atlas);
+/* Allocates an empty atlas, NULL if out of memory. */
+static DanteAtlas* danteAtlasCreate(void);
+/* Frees 'atlas', which must have no pixmaps. */
+static void danteAtlasFree(DanteAtlas* atlas);
+/* Allocates the internal pixmap of an atlas outside of the object
+ * slices, so that it has no handle the application could reach,
+ * NULL if out of memory.
+ */
+static DanteObject* danteAtlasPixmapCreate(void);
+/* Frees the internal pixmap 'obj' along with its pixels. */
+static void danteAtlasPixmapFree(DanteObject* obj);
+/* Inserts the pixmap 'obj' into 'atlas', it returns false if it doesn't fit. */
+static UDboolean danteAtlasInsert(DanteAtlas* atlas, DanteObject* obj);
+
+static UDboolean danteAtlasUsage(UDenum usage)
+{
+	switch (usage) {
+	case UDESK_PIXMAP_USAGE_MENU:
+	case UDESK_PIXMAP_USAGE_TOOLBAR_SMALL:
+	case UDESK_PIXMAP_USAGE_TOOLBAR_MEDIUM:
+	case UDESK_PIXMAP_USAGE_ICON_SMALL:
+		return true;
+	
+	default:
+		return false;
+	}
+}
+
+static UDboolean danteAtlasPack(DanteAtlas* atlas, int w, int h, SDL_Rect* rect)
+{
+	DanteShelf* best = NULL;
+	DanteShelf* shelf;
+	int top;
+	UDint i;
+	
+	w += DANTE_ATLAS_PADDING;
+	h += DANTE_ATLAS_PADDING;
+	
+	/* the lowest shelf with room wastes the least height */
+	for (i = 0; i < atlas->num_shelves; i++) {
+		shelf = &atlas->shelves[i];
+		if (shelf->h >= h && shelf->x + w <= DANTE_ATLAS_SIZE && (!best || shelf->h < best->h)) {
+			best = shelf;
+		}
+	}
+	if (!best) {
+		top = 0;
+		if (atlas->num_shelves > 0) {
+			shelf = &atlas->shelves[atlas->num_shelves - 1];
+			top = shelf->y + shelf->h;
+		}
+		if (atlas->num_shelves == DANTE_ATLAS_SHELVES || top + h > DANTE_ATLAS_SIZE) {
+			return false;
+		}
+		
+		best = &atlas->shelves[atlas->num_shelves++];
+		best->y = top;
+		best->h = h;
+		best->x = 0;
+	}
+	
+	rect->x = best->x;
+	rect->y = best->y;
+	rect->w = w - DANTE_ATLAS_PADDING;
+	rect->h = h - DANTE_ATLAS_PADDING;
+	best->x += w;
+	atlas->allocated += (Uint32)w * (Uint32)best->h;
+	atlas->used += (Uint32)w * (Uint32)h;
+	return true;
+}
+
+static void danteAtlasCopy(SDL_Surface* pixels, const DanteObject* obj, const SDL_Rect* rect)
+{
+	const SDL_Surface* src = obj->d.pix.pixels;
+	int y;
+	
+	for (y = 0; y < rect->h; y++) {
+		memcpy((Uint8*)pixels->pixels + (rect->y + y) * pixels->pitch + rect->x * 4,
+		       (const Uint8*)src->pixels + y * src->pitch,
+		       rect->w * 4);
+	}
+}
+
+static UDboolean danteAtlasCompact(DanteAtlas* atlas)
+{
+	SDL_Surface* pixels;
+	DanteObject* obj;
+	DanteObject* next;
+	DanteObject* members = atlas->members;
+	
+	pixels = SDL_CreateRGBSurfaceWithFormat(0, DANTE_ATLAS_SIZE, DANTE_ATLAS_SIZE, 32, DANTE_PIXMAP_FORMAT);
+	if (!pixels) {
+		return false;
+	}
+	
+	memset(pixels->pixels, 0, pixels->pitch * pixels->h);
+	atlas->num_shelves = 0;
+	atlas->allocated = 0;
+	atlas->used = 0;
+	atlas->members = NULL;
+	for (obj = members; obj; obj = next) {
+		DantePixmapObject* pix = &obj->d.pix;
+		
+		next = pix->atlas_next;
+		if (!danteAtlasPack(atlas, pix->pixels->w, pix->pixels->h, &pix->atlas_rect)) {
+			/* drawn from its own textures from now on */
+			pix->atlas = NULL;
+			pix->atlas_next = NULL;
+			continue;
+		}
+		
+		danteAtlasCopy(pixels, obj, &pix->atlas_rect);
+		pix->atlas_next = atlas->members;
+		atlas->members = obj;
+	}
+	
+	/* windows drawing the old textures record their lists again */
+	if (!dantePixmapReplace(atlas->pixmap, pixels, false)) {
+		while (atlas->members) {
+			obj = atlas->members;
+			atlas->members = obj->d.pix.atlas_next;
+			obj->d.pix.atlas = NULL;
+			obj->d.pix.atlas_next = NULL;
+		}
+		
+		return false;
+	}
+	
+	return true;
+}
+
+static DanteObject* danteAtlasPixmapCreate(void)
+{
+	DanteObject* obj;
+	
+	obj = (DanteObject*)calloc(1, sizeof(*obj));
+	if (!obj) {
+		return NULL;
+	}
+	
+	obj->type = UDESK_HANDLE_PIXMAP;
+	obj->handle = UDESK_HANDLE_NONE;
+	obj->refs = 1;
+	obj->slot = -1;
+	obj->range = -1;
+	dantePixmapInit(obj);
+	return obj;
+}
+
+static void danteAtlasPixmapFree(DanteObject* obj)
+{
+	dantePixmapReplace(obj, NULL, false);
+	free(obj);
+}
+
+static DanteAtlas* danteAtlasCreate(void)
+{
+	DanteAtlas* atlas;
+	SDL_Surface* pixels;
+	
+	atlas = (DanteAtlas*)malloc(sizeof(*atlas));
+	if (!atlas) {
+		return NULL;
+	}
+	
+	atlas->pixmap = danteAtlasPixmapCreate();
+	pixels = SDL_CreateRGBSurfaceWithFormat(0, DANTE_ATLAS_SIZE, DANTE_ATLAS_SIZE, 32, DANTE_PIXMAP_FORMAT);
+	if (!atlas->pixmap || !pixels) {
+		if (pixels) {
+			SDL_FreeSurface(pixels);
+		}
+		if (atlas->pixmap) {
+			danteAtlasPixmapFree(atlas->pixmap);
+		}
+		
+		free(atlas);
+		return NULL;
+	}
+	
+	memset(pixels->pixels, 0, pixels->pitch * pixels->h);
+	if (!dantePixmapReplace(atlas->pixmap, pixels, false)) {
+		danteAtlasPixmapFree(atlas->pixmap);
+		free(atlas);
+		return NULL;
+	}
+	
+	atlas->num_shelves = 0;
+	atlas->allocated = 0;
+	atlas->used = 0;
+	atlas->members = NULL;
+	atlas->next = dante_context->atlases;
+	dante_context->atlases = atlas;
+	return atlas;
+}
+
+static void danteAtlasFree(DanteAtlas* atlas)
+{
+	DanteAtlas** link;
+	
+	for (link = &dante_context->atlases; *link != atlas; link = &(*link)->next);
+	
+	*link = atlas->next;
+	danteAtlasPixmapFree(atlas->pixmap);
+	free(atlas);
+}
+
+static UDboolean danteAtlasInsert(DanteAtlas* atlas, DanteObject* obj)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	SDL_Surface* pixels = dantePixmapWritable(atlas->pixmap);
+	
+	if (!pixels || !danteAtlasPack(atlas, pix->pixels->w, pix->pixels->h, &pix->atlas_rect)) {
+		return false;
+	}
+	
+	danteAtlasCopy(pixels, obj, &pix->atlas_rect);
+	dantePixmapUpdate(atlas->pixmap, &pix->atlas_rect);
+	pix->atlas = atlas;
+	pix->atlas_next = atlas->members;
+	atlas->members = obj;
+	return true;
+}
+
+void DANTEAPIENTRY danteAtlasAdd(DanteObject* obj)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	DanteAtlas* atlas;
+	
+	if (!pix->pixels || !danteAtlasUsage(pix->usage) ||
+	    pix->pixels->w > DANTE_ATLAS_MAX_PIXMAP || pix->pixels->h > DANTE_ATLAS_MAX_PIXMAP) {
+		return;
+	}
+	
+	for (atlas = dante_context->atlases; atlas; atlas = atlas->next) {
+		if (danteAtlasInsert(atlas, obj)) {
+			return;
+		}
+	}
+	
+	/* reclaim removed pixmaps areas before growing */
+	for (atlas = dante_context->atlases; atlas; atlas = atlas->next) {
+		if (atlas->allocated - atlas->used >= (Uint32)DANTE_ATLAS_SIZE * DANTE_ATLAS_SIZE / 4 &&
+		    danteAtlasCompact(atlas) && danteAtlasInsert(atlas, obj)) {
+			return;
+		}
+	}
+	
+	atlas = danteAtlasCreate();
+	if (atlas) {
+		danteAtlasInsert(atlas, obj);
+	}
+}
+
+void DANTEAPIENTRY danteAtlasRemove(DanteObject* obj)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	DanteAtlas* atlas = pix->atlas;
+	DanteObject** link;
+	
+	for (link = &atlas->members; *link != obj; link = &(*link)->d.pix.atlas_next);
+	
+	/* the area is reclaimed when the atlas is compacted */
+	*link = pix->atlas_next;
+	atlas->used -= (Uint32)(pix->atlas_rect.w + DANTE_ATLAS_PADDING) * (Uint32)(pix->atlas_rect.h + DANTE_ATLAS_PADDING);
+	pix->atlas = NULL;
+	pix->atlas_next = NULL;
+	if (!atlas->members) {
+		danteAtlasFree(atlas);
+	}
+}
+
+void DANTEAPIENTRY danteDestroyAtlases(void)
+{
+	DanteObject* obj;
+	
+	while (dante_context->atlases) {
+		DanteAtlas* atlas = dante_context->atlases;
+		
+		while (atlas->members) {
+			obj = atlas->members;
+			atlas->members = obj->d.pix.atlas_next;
+			obj->d.pix.atlas = NULL;
+			obj->d.pix.atlas_next = NULL;
+		}
+		
+		danteAtlasFree(atlas);
+	}
+}
@@ -0,0 +1,47 @@
+/* bench.h: Benchmark helpers.
+ *
+ * Shared by the benchmark programs built by the Makefile bench target,
+ * they link dante objects directly to reach its internal functions.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DANTE_BENCH_H_
+#define DANTE_BENCH_H_
+#include "dante.h"
+
+/* Creates a headless context, unless DANTE_HEADLESS is already set
+ * in the environment, exits on failure.
+ */
+void benchInit(int* argc, char** argv[]);
+/* Destroys the context created by benchInit(). */
+void benchQuit(void);
+/* Returns the time elapsed from an arbitrary point, in seconds. */
+double benchNow(void);
+/* Prints the measurement 'value', in 'unit', of the benchmark 'name'. */
+void benchReport(const char* name, double value, const char* unit);
+
+#endif /* DANTE_BENCH_H_ */
@@ -0,0 +1,103 @@
+/* convert.c: Pixel conversion benchmark.
+ *
+ * Times danteConvertBand() with each conversion kernel supported by
+ * the CPU, converting a single strip on the calling thread and a whole
+ * image split across workers, reports the source bytes converted per
+ * second.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Benchmark image size. */
+#define BENCH_WIDTH 2048
+#define BENCH_HEIGHT 1024
+/* Rows of the single thread strip, below the parallel threshold. */
+#define BENCH_STRIP 64
+/* Minimum duration of each measurement, in seconds. */
+#define BENCH_TIME 0.5
+
+/* Returns the GB/s converting 'rows' rows of 'src' to 'dst'. */
+static double benchConvert(SDL_Surface* dst, int rows, const Uint8* src, int bpp, UDenum format);
+
+static double benchConvert(SDL_Surface* dst, int rows, const Uint8* src, int bpp, UDenum format)
+{
+	double start, elapsed;
+	unsigned long runs = 0;
+	
+	start = benchNow();
+	do {
+		danteConvertBand(dst, 0, rows, src, dst->w * bpp, format);
+		runs++;
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME);
+	
+	return (double)runs * dst->w * rows * bpp / elapsed / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+	SDL_Surface* dst;
+	Uint8* src;
+	const char* kernel;
+	char name[64];
+	size_t i, size = (size_t)BENCH_WIDTH * BENCH_HEIGHT * 4;
+	UDint level;
+	
+	benchInit(&argc, &argv);
+	dst = SDL_CreateRGBSurfaceWithFormat(0, BENCH_WIDTH, BENCH_HEIGHT, 32, DANTE_PIXMAP_FORMAT);
+	src = (Uint8*)malloc(size);
+	if (!dst || !src) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	/* mixed alpha, so no premultiplication shortcut is taken */
+	srand(1);
+	for (i = 0; i < size; i++) {
+		src[i] = (Uint8)rand();
+	}
+	
+	for (level = 0; (kernel = danteSelectConvert(level)) != NULL; level++) {
+		sprintf(name, "convert %s rgba strip", kernel);
+		benchReport(name, benchConvert(dst, BENCH_STRIP, src, 4, UDESK_RGBA), "GB/s");
+		sprintf(name, "convert %s rgba image", kernel);
+		benchReport(name, benchConvert(dst, BENCH_HEIGHT, src, 4, UDESK_RGBA), "GB/s");
+		sprintf(name, "convert %s rgb strip", kernel);
+		benchReport(name, benchConvert(dst, BENCH_STRIP, src, 3, UDESK_RGB_EXT), "GB/s");
+		sprintf(name, "convert %s rgb image", kernel);
+		benchReport(name, benchConvert(dst, BENCH_HEIGHT, src, 3, UDESK_RGB_EXT), "GB/s");
+	}
+	
+	danteInitConvert();
+	free(src);
+	SDL_FreeSurface(dst);
+	benchQuit();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/* dispatch.c: Event dispatch benchmark.
+ *
+ * Pushes keyboard events for a window into the SDL queue and runs
+ * the event loop until its handler, which reads one field, got every
+ * one of them, reporting the time of each dispatch. It checks that
+ * every event object is taken from the context event ring, rather
+ * than allocated, and references its SDL event in place, inside the
+ * event loop batch, rather than a copy.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Events pushed each round, well below the SDL queue capacity. */
+#define BENCH_EVENTS 4096
+/* Minimum duration of the measurement, in seconds. */
+#define BENCH_TIME 1.0
+
+/* Window keyboard handler, reading the event type, checking where
+ * the event lives and stopping the event loop once every pushed
+ * event was dispatched.
+ */
+static void benchDispatchHandler(UDhandle event);
+
+/* events dispatched, and expected by the end of the round. */
+static unsigned long bench_handled;
+static unsigned long bench_expected;
+/* events allocated outside the ring, or copied out of the batch. */
+static unsigned long bench_allocated;
+static unsigned long bench_copied;
+/* event types read by the handler, so the query isn't optimized out. */
+static unsigned long bench_types;
+
+static void benchDispatchHandler(UDhandle event)
+{
+	const DanteObject* ring = dante_context->cache;
+	const DanteEventLoop* loop = dante_context->loop;
+	const DanteObject* obj = dante_context->ev;
+	const SDL_Event* sev = obj->d.ev.sev;
+	UDint type;
+	
+	udeskGetEventiv(event, UDESK_EVENT_TYPE, &type);
+	bench_types += (type == UDESK_EVENT_KEYBOARD);
+	if (obj < ring || obj >= ring + DANTE_EVENT_RING) {
+		bench_allocated++;
+	}
+	if (sev < loop->batch || sev >= loop->batch + DANTE_EVENT_BATCH) {
+		bench_copied++;
+	}
+	if (++bench_handled == bench_expected) {
+		udeskMakeContextNone();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	SDL_Event sev;
+	DanteObject* obj;
+	UDhandle win;
+	double start, elapsed;
+	int i;
+	
+	benchInit(&argc, &argv);
+	udeskGenObjects(UDESK_HANDLE_WINDOW, 1, &win);
+	udeskSetWindowi(win, UDESK_WINDOW_MODE, UDESK_WINDOW_SHOW);
+	udeskRegisterHandler(win, UDESK_EVENT_KEYBOARD, benchDispatchHandler);
+	if (udeskGetError() != UDESK_NO_ERROR) {
+		fprintf(stderr, "%s: window creation failed\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	obj = danteRetrieveObject(win, UDESK_HANDLE_WINDOW);
+	memset(&sev, 0, sizeof(sev));
+	sev.type = SDL_KEYDOWN;
+	sev.key.windowID = SDL_GetWindowID(obj->d.win.swin);
+	sev.key.state = SDL_PRESSED;
+	
+	/* events of the window being shown aren't measured */
+	SDL_PumpEvents();
+	SDL_FlushEvent(SDL_WINDOWEVENT);
+	
+	start = benchNow();
+	do {
+		for (i = 0; i < BENCH_EVENTS; i++) {
+			SDL_PushEvent(&sev);
+		}
+		
+		bench_expected += BENCH_EVENTS;
+		udeskMakeContextCurrent();
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME);
+	
+	benchReport("event dispatch", elapsed * 1e9 / bench_handled, "ns/event");
+	benchReport("event objects allocated", (double)bench_allocated, "events");
+	benchReport("SDL events copied", (double)bench_copied, "events");
+	
+	udeskDeleteObjects(1, &win);
+	benchQuit();
+	
+	if (bench_allocated > 0 || bench_copied > 0 || bench_types != bench_handled) {
+		fprintf(stderr, "%s: of %lu events %lu were allocated, %lu copied\n", argv[0], bench_handled, bench_allocated, bench_copied);
+		return EXIT_FAILURE;
+	}
+	
+	return EXIT_SUCCESS;
+}
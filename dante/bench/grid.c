@@ -0,0 +1,182 @@
+/* grid.c: Spatial index benchmark.
+ *
+ * Lays out 10 to 10,000 children over a window sized area, then
+ * reports the time of picking the object under random points with
+ * the window spatial index, compared to a linear scan of the children,
+ * and the time of moving a child.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Indexed area, a full HD window. */
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+/* Random points picked each round. */
+#define BENCH_POINTS 4096
+/* Minimum duration of each measurement, in seconds. */
+#define BENCH_TIME 0.25
+
+/* Lays 'num' children of 'win' out in a square grid, tiling the area. */
+static void benchLayout(DanteObject* win, DanteObject* children, int num);
+/* Returns the ns taken by each pick of 'grid', or of a linear scan
+ * of 'children' if 'linear' is true, counting hits in 'hits'.
+ */
+static double benchPick(const DanteGrid* grid, const DanteObject* children, int num, UDboolean linear, unsigned long* hits);
+/* Returns the ns taken by each update of 'grid' moving a child. */
+static double benchMove(DanteGrid* grid, DanteObject* children, int num);
+
+/* random points, x and y interleaved. */
+static UDint bench_points[BENCH_POINTS * 2];
+
+static void benchLayout(DanteObject* win, DanteObject* children, int num)
+{
+	int side = 1, i;
+	
+	while (side * side < num) {
+		side++;
+	}
+	for (i = 0; i < num; i++) {
+		children[i].type = UDESK_HANDLE_LAYER;
+		children[i].parent = win;
+		children[i].slot = -1;
+		children[i].area.x = (i % side) * BENCH_WIDTH / side;
+		children[i].area.y = (i / side) * BENCH_HEIGHT / side;
+		children[i].area.w = BENCH_WIDTH / side;
+		children[i].area.h = BENCH_HEIGHT / side;
+	}
+}
+
+static double benchPick(const DanteGrid* grid, const DanteObject* children, int num, UDboolean linear, unsigned long* hits)
+{
+	const SDL_Rect* area;
+	UDint x, y;
+	double start, elapsed;
+	unsigned long runs = 0;
+	int i, j;
+	
+	start = benchNow();
+	do {
+		for (i = 0; i < BENCH_POINTS; i++) {
+			x = bench_points[i * 2];
+			y = bench_points[i * 2 + 1];
+			if (!linear) {
+				*hits += (danteGridPick(grid, x, y) != NULL);
+				continue;
+			}
+			
+			/* the last laid out child is the topmost one */
+			for (j = num - 1; j >= 0; j--) {
+				area = &children[j].area;
+				if (x >= area->x && x < area->x + area->w && y >= area->y && y < area->y + area->h) {
+					(*hits)++;
+					break;
+				}
+			}
+		}
+		
+		runs++;
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME);
+	
+	return elapsed * 1e9 / ((double)runs * BENCH_POINTS);
+}
+
+static double benchMove(DanteGrid* grid, DanteObject* children, int num)
+{
+	double start, elapsed;
+	unsigned long runs = 0;
+	int i;
+	
+	start = benchNow();
+	do {
+		for (i = 0; i < num; i++) {
+			children[i].area.x += (runs & 1)? -1 : 1;
+			danteGridUpdate(grid, &children[i]);
+		}
+		
+		runs++;
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME || (runs & 1));
+	
+	return elapsed * 1e9 / ((double)runs * num);
+}
+
+int main(int argc, char* argv[])
+{
+	static const int sizes[] = { 10, 100, 1000, 10000 };
+	DanteObject win;
+	DanteObject* children;
+	DanteGrid grid;
+	char name[64];
+	unsigned long hits = 0;
+	int i, j, num;
+	
+	(void)argc;
+	
+	srand(1);
+	for (i = 0; i < BENCH_POINTS; i++) {
+		bench_points[i * 2] = rand() % BENCH_WIDTH;
+		bench_points[i * 2 + 1] = rand() % BENCH_HEIGHT;
+	}
+	
+	memset(&win, 0, sizeof(win));
+	win.type = UDESK_HANDLE_WINDOW;
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		num = sizes[i];
+		children = (DanteObject*)calloc(num, sizeof(*children));
+		if (!children) {
+			fprintf(stderr, "%s: out of memory\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+		
+		benchLayout(&win, children, num);
+		danteGridInit(&grid, BENCH_WIDTH, BENCH_HEIGHT);
+		for (j = 0; j < num; j++) {
+			if (!danteGridUpdate(&grid, &children[j])) {
+				fprintf(stderr, "%s: out of memory\n", argv[0]);
+				return EXIT_FAILURE;
+			}
+		}
+		
+		sprintf(name, "grid %d children pick", num);
+		benchReport(name, benchPick(&grid, children, num, false, &hits), "ns");
+		sprintf(name, "grid %d children linear scan", num);
+		benchReport(name, benchPick(&grid, children, num, true, &hits), "ns");
+		sprintf(name, "grid %d children move", num);
+		benchReport(name, benchMove(&grid, children, num), "ns");
+		
+		danteGridClear(&grid);
+		free(children);
+	}
+	
+	/* keeps the picks from being optimized out */
+	return (hits > 0)? EXIT_SUCCESS : EXIT_FAILURE;
+}
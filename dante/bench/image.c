@@ -0,0 +1,228 @@
+/* image.c: Image decoding benchmark.
+ *
+ * Writes QOI images, then reports the latency of decoding a single
+ * large image and the throughput of a batch of asynchronous loads,
+ * spread across the worker threads.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Single image size. */
+#define BENCH_LARGE 4096
+/* Batch image size and count. */
+#define BENCH_SMALL 512
+#define BENCH_BATCH 64
+/* Minimum duration of each measurement, in seconds. */
+#define BENCH_TIME 1.0
+
+/* Writes a 'size' by 'size' QOI image to the file 'name', whose
+ * pixels depend on 'seed', returns false on failure.
+ */
+static UDboolean benchWriteQOI(const char* name, int size, unsigned int seed);
+/* Stores 'v' in 'p' as a big endian 32 bit value. */
+static void benchPut32(Uint8* p, Uint32 v);
+
+static void benchPut32(Uint8* p, Uint32 v)
+{
+	p[0] = (Uint8)(v >> 24);
+	p[1] = (Uint8)(v >> 16);
+	p[2] = (Uint8)(v >> 8);
+	p[3] = (Uint8)v;
+}
+
+static UDboolean benchWriteQOI(const char* name, int size, unsigned int seed)
+{
+	Uint8 index[64 * 4];
+	Uint8 prev[4] = { 0, 0, 0, 255 };
+	Uint8 px[4];
+	Uint8* data;
+	Uint8* out;
+	FILE* f;
+	int x, y, h, run = 0;
+	int vr, vg, vb, vgr, vgb;
+	size_t len;
+	UDboolean ok;
+	
+	data = (Uint8*)malloc((size_t)size * size * 5 + 22);
+	if (!data) {
+		return false;
+	}
+	
+	memcpy(data, "qoif", 4);
+	benchPut32(data + 4, (Uint32)size);
+	benchPut32(data + 8, (Uint32)size);
+	data[12] = 4;
+	data[13] = 0;
+	out = data + 14;
+	memset(index, 0, sizeof(index));
+	srand(seed);
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			/* noisy gradients, translucent on the right half,
+			 * exercising every chunk type
+			 */
+			px[0] = (Uint8)(x + (rand() & 3));
+			px[1] = (Uint8)y;
+			px[2] = (Uint8)((x + y) / 2 + (rand() & 31));
+			px[3] = (x < size / 2) ? 255 : (Uint8)(y & 0xf0);
+			if (memcmp(px, prev, 4) == 0) {
+				run++;
+				if (run == 62) {
+					*out++ = (Uint8)(0xc0 | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				*out++ = (Uint8)(0xc0 | (run - 1));
+				run = 0;
+			}
+			
+			h = ((px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64) * 4;
+			if (memcmp(index + h, px, 4) == 0) {
+				*out++ = (Uint8)(h / 4);
+				memcpy(prev, px, 4);
+				continue;
+			}
+			
+			memcpy(index + h, px, 4);
+			vr = (Sint8)(px[0] - prev[0]);
+			vg = (Sint8)(px[1] - prev[1]);
+			vb = (Sint8)(px[2] - prev[2]);
+			vgr = vr - vg;
+			vgb = vb - vg;
+			if (px[3] != prev[3]) {
+				*out++ = 0xff;
+				memcpy(out, px, 4);
+				out += 4;
+			} else if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+				*out++ = (Uint8)(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+			} else if (vgr >= -8 && vgr <= 7 && vg >= -32 && vg <= 31 && vgb >= -8 && vgb <= 7) {
+				*out++ = (Uint8)(0x80 | (vg + 32));
+				*out++ = (Uint8)((vgr + 8) << 4 | (vgb + 8));
+			} else {
+				*out++ = 0xfe;
+				memcpy(out, px, 3);
+				out += 3;
+			}
+			
+			memcpy(prev, px, 4);
+		}
+	}
+	if (run > 0) {
+		*out++ = (Uint8)(0xc0 | (run - 1));
+	}
+	
+	memset(out, 0, 7);
+	out[7] = 1;
+	out += 8;
+	
+	len = (size_t)(out - data);
+	f = fopen(name, "wb");
+	ok = f && fwrite(data, 1, len, f) == len;
+	if (f && fclose(f) != 0) {
+		ok = false;
+	}
+	
+	free(data);
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	DanteImage image;
+	UDhandle pixmaps[BENCH_BATCH];
+	char names[BENCH_BATCH][32];
+	double start, elapsed;
+	unsigned long runs = 0;
+	UDint i, pending;
+	UDenum err;
+	
+	benchInit(&argc, &argv);
+	if (!benchWriteQOI("bench-large.qoi", BENCH_LARGE, 0)) {
+		fprintf(stderr, "%s: can't write bench-large.qoi\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < BENCH_BATCH; i++) {
+		sprintf(names[i], "bench-%d.qoi", (int)i);
+		if (!benchWriteQOI(names[i], BENCH_SMALL, (unsigned int)i + 1)) {
+			fprintf(stderr, "%s: can't write %s\n", argv[0], names[i]);
+			return EXIT_FAILURE;
+		}
+	}
+	
+	/* single image, decoded by the calling thread */
+	start = benchNow();
+	do {
+		err = danteDecodeImage("bench-large.qoi", &image, NULL);
+		if (err != UDESK_NO_ERROR) {
+			fprintf(stderr, "%s: decoding failed (0x%x)\n", argv[0], (unsigned int)err);
+			return EXIT_FAILURE;
+		}
+		
+		danteDiscardImage(&image);
+		runs++;
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME);
+	
+	benchReport("qoi 4096x4096 decode latency", elapsed * 1000.0 / runs, "ms");
+	
+	/* batch of asynchronous loads, completed as the event loop would */
+	udeskGenObjects(UDESK_HANDLE_PIXMAP, BENCH_BATCH, pixmaps);
+	runs = 0;
+	start = benchNow();
+	do {
+		for (i = 0; i < BENCH_BATCH; i++) {
+			udeskPixmapFileAsyncEXT(pixmaps[i], UDESK_PIXMAP_IMAGE, names[i], UDESK_PIXMAP_USAGE_STATIC);
+		}
+		do {
+			SDL_Delay(1);
+			danteHandleDecodeEvent();
+			udeskGetiv(UDESK_DECODE_PENDING_EXT, &pending);
+		} while (pending > 0);
+		
+		SDL_FlushEvent(dante_context->decode_event);
+		runs++;
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME);
+	
+	benchReport("qoi 512x512 batch throughput", runs * BENCH_BATCH / elapsed, "images/s");
+	benchReport("qoi 512x512 batch throughput", runs * BENCH_BATCH * (double)BENCH_SMALL * BENCH_SMALL / elapsed / 1e6, "Mpixels/s");
+	
+	udeskDeleteObjects(BENCH_BATCH, pixmaps);
+	remove("bench-large.qoi");
+	for (i = 0; i < BENCH_BATCH; i++) {
+		remove(names[i]);
+	}
+	
+	benchQuit();
+	return EXIT_SUCCESS;
+}
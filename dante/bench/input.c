@@ -0,0 +1,153 @@
+/* input.c: Input dispatch benchmark.
+ *
+ * Pushes synthetic keyboard, mouse button and motion events for a
+ * window into the SDL queue, as the video driver would, and reports
+ * the throughput of the event loop dispatching them to the window
+ * handlers, which query the key state snapshot.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Events pushed each round, well below the SDL queue capacity. */
+#define BENCH_EVENTS 4096
+/* Minimum duration of the measurement, in seconds. */
+#define BENCH_TIME 1.0
+
+/* Window handler, counting events and stopping the event loop once
+ * every pushed event was dispatched.
+ */
+static void benchInputHandler(UDhandle event);
+/* Fills 'ev' with the 'i'th synthetic event for the SDL window 'id'. */
+static void benchInputEvent(SDL_Event* ev, int i, Uint32 id);
+
+/* events dispatched, and expected by the end of the round. */
+static UDint bench_handled;
+static UDint bench_expected;
+/* key states read by the handler, so the query isn't optimized out. */
+static UDint bench_pressed;
+
+static void benchInputHandler(UDhandle event)
+{
+	(void)event;
+	
+	if (udeskGetKeyStateEXT(UDESK_CLICK_BUTTON0) || (udeskGetModifiersEXT() & UDESK_MODIFIER_SHIFT_EXT)) {
+		bench_pressed++;
+	}
+	if (++bench_handled == bench_expected) {
+		udeskMakeContextNone();
+	}
+}
+
+static void benchInputEvent(SDL_Event* ev, int i, Uint32 id)
+{
+	memset(ev, 0, sizeof(*ev));
+	switch (i % 6) {
+	case 0:
+	case 1:
+		ev->type = (i % 6 == 0)? SDL_KEYDOWN : SDL_KEYUP;
+		ev->key.windowID = id;
+		ev->key.state = (i % 6 == 0)? SDL_PRESSED : SDL_RELEASED;
+		ev->key.keysym.scancode = (SDL_Scancode)(SDL_SCANCODE_A + (i / 6) % 26);
+		ev->key.keysym.mod = KMOD_LSHIFT;
+		break;
+	
+	case 2:
+	case 3:
+		ev->type = (i % 6 == 2)? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+		ev->button.windowID = id;
+		ev->button.state = (i % 6 == 2)? SDL_PRESSED : SDL_RELEASED;
+		ev->button.button = SDL_BUTTON_LEFT;
+		ev->button.x = i % 640;
+		ev->button.y = i % 480;
+		break;
+	
+	default:
+		ev->type = SDL_MOUSEMOTION;
+		ev->motion.windowID = id;
+		ev->motion.x = i % 640;
+		ev->motion.y = (i / 640) % 480;
+		ev->motion.xrel = 1;
+		break;
+	}
+	
+	ev->common.timestamp = SDL_GetTicks();
+}
+
+int main(int argc, char* argv[])
+{
+	SDL_Event ev;
+	DanteObject* obj;
+	UDhandle win;
+	Uint32 id;
+	double start, elapsed;
+	unsigned long total = 0;
+	int i;
+	
+	benchInit(&argc, &argv);
+	udeskGenObjects(UDESK_HANDLE_WINDOW, 1, &win);
+	udeskSetWindowi(win, UDESK_WINDOW_MODE, UDESK_WINDOW_SHOW);
+	udeskRegisterHandler(win, UDESK_EVENT_KEYBOARD, benchInputHandler);
+	udeskRegisterHandler(win, UDESK_EVENT_PRESS, benchInputHandler);
+	udeskRegisterHandler(win, UDESK_EVENT_RELEASE, benchInputHandler);
+	udeskRegisterHandler(win, UDESK_EVENT_MOTION, benchInputHandler);
+	if (udeskGetError() != UDESK_NO_ERROR) {
+		fprintf(stderr, "%s: window creation failed\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	obj = danteRetrieveObject(win, UDESK_HANDLE_WINDOW);
+	id = SDL_GetWindowID(obj->d.win.swin);
+	
+	/* events of the window being shown aren't measured */
+	SDL_PumpEvents();
+	SDL_FlushEvent(SDL_WINDOWEVENT);
+	
+	start = benchNow();
+	do {
+		for (i = 0; i < BENCH_EVENTS; i++) {
+			benchInputEvent(&ev, i, id);
+			SDL_PushEvent(&ev);
+		}
+		
+		bench_handled = 0;
+		bench_expected = BENCH_EVENTS;
+		udeskMakeContextCurrent();
+		total += bench_handled;
+		elapsed = benchNow() - start;
+	} while (elapsed < BENCH_TIME);
+	
+	benchReport("input dispatch throughput", total / elapsed / 1e6, "Mevents/s");
+	benchReport("input dispatch latency", elapsed * 1e9 / total, "ns/event");
+	
+	udeskDeleteObjects(1, &win);
+	benchQuit();
+	return EXIT_SUCCESS;
+}
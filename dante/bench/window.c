@@ -0,0 +1,108 @@
+/* window.c: Window creation benchmark.
+ *
+ * Reports the time of creating and showing a window, with the cached
+ * renderer probe, without it, and taking windows from the window pool.
+ * Headless contexts use software renderers and never probe, run with
+ * DANTE_HEADLESS=0 on a display to measure the probe as well.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Minimum duration of each measurement, in seconds. */
+#define BENCH_TIME 1.0
+
+/* Returns the ms taken to create and show each window, taking them
+ * from a full window pool if 'pooled' is true, forgetting the cached
+ * renderer probe before each window if 'probe' is true.
+ */
+static double benchCreate(UDboolean pooled, UDboolean probe);
+
+static double benchCreate(UDboolean pooled, UDboolean probe)
+{
+	UDhandle wins[DANTE_WINDOW_POOL];
+	double elapsed = 0.0, start;
+	unsigned long total = 0;
+	int i;
+	
+	do {
+		if (pooled) {
+			/* refilled while idle by the event loop, not measured */
+			dante_context->pool_size = DANTE_WINDOW_POOL;
+			danteFillWindowPool(0);
+			if (dante_context->num_pooled < DANTE_WINDOW_POOL) {
+				fprintf(stderr, "window pool creation failed: %s\n", SDL_GetError());
+				exit(EXIT_FAILURE);
+			}
+		}
+		
+		udeskGenObjects(UDESK_HANDLE_WINDOW, DANTE_WINDOW_POOL, wins);
+		start = benchNow();
+		for (i = 0; i < DANTE_WINDOW_POOL; i++) {
+			if (probe) {
+				SDL_AtomicSet(&dante_context->probe, 0);
+			}
+			
+			udeskSetWindowi(wins[i], UDESK_WINDOW_MODE, UDESK_WINDOW_SHOW);
+		}
+		
+		elapsed += benchNow() - start;
+		total += DANTE_WINDOW_POOL;
+		if (udeskGetError() != UDESK_NO_ERROR) {
+			fprintf(stderr, "window creation failed: %s\n", SDL_GetError());
+			exit(EXIT_FAILURE);
+		}
+		
+		udeskDeleteObjects(DANTE_WINDOW_POOL, wins);
+		danteCollectObjects(0);
+		SDL_PumpEvents();
+		SDL_FlushEvent(SDL_WINDOWEVENT);
+	} while (elapsed < BENCH_TIME);
+	
+	dante_context->pool_size = 0;
+	return elapsed * 1000.0 / total;
+}
+
+int main(int argc, char* argv[])
+{
+	benchInit(&argc, &argv);
+	
+	/* the pool is only filled when measured */
+	danteDrainWindowPool();
+	dante_context->pool_size = 0;
+	
+	if (!dante_context->headless) {
+		benchReport("window create, uncached probe", benchCreate(false, true), "ms");
+	}
+	benchReport("window create", benchCreate(false, false), "ms");
+	benchReport("window create, pooled", benchCreate(true, false), "ms");
+	
+	benchQuit();
+	return EXIT_SUCCESS;
+}
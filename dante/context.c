@@ -35,11 +35,34 @@
 
 DanteContext* dante_context = NULL;
 
+/* Deferred destruction time budget for each event loop iteration,
+ * in milliseconds.
+ */
+#define DANTE_COLLECT_BUDGET 4
+/* Time the event loop waits for new events before using idle time
+ * to collect objects waiting for destruction, in milliseconds.
+ */
+#define DANTE_COLLECT_IDLE 10
+
+/* SDL video drivers whose windows and renderers may be created and
+ * used by a thread other than the one handling events, X11 displays
+ * are opened thread safe by SDL, KMSDRM has no event thread affinity.
+ */
+static const char* const dante_thread_drivers[] = {
+	"x11",
+	"kmsdrm"
+};
+
 /* Retrieves a value for the specified environment variable,
  * if the environment variable has an invalid value or can't be found,
  * the default value is returned.
  */
 static UDboolean danteGetEnvVariable(const char* name, UDboolean defval);
+/* Returns whether render queues may run on their own threads with
+ * the current SDL video driver, true for headless contexts and for
+ * the drivers listed in dante_thread_drivers.
+ */
+static UDboolean danteThreadedRendering(UDboolean headless);
 /* Walks the slice list finding the first empty slot, a new
  * slice is allocated into it, inizialized and returned.
  * No error is set on allocation failure (which can only happen
@@ -47,6 +70,31 @@ static UDboolean danteGetEnvVariable(const char* name, UDboolean defval);
  * silent memory allocation failures.
  */
 static DanteSlice* danteAllocSlice(void);
+/* Clears 'obj' and gives its memory slot back to the allocator. */
+static void danteFreeObject(DanteObject* obj);
+/* Retires 'obj' and queues it for deferred destruction, it returns
+ * false if the object couldn't be queued (out of memory), in which
+ * case the caller should free it immediately.
+ */
+static UDboolean danteDeferObject(DanteObject* obj);
+/* Submits an asynchronous flush of 'obj', falling back to a
+ * synchronous flush, it returns the fence of the submitted work,
+ * 'fence' if nothing was submitted.
+ */
+static Uint32 danteSubmitObject(DanteObject* obj, Uint32 fence, UDboolean notify);
+/* Submits a flush of every object, as danteSubmitObject() does, it
+ * returns the last submitted fence, 0 if none.
+ */
+static Uint32 danteSubmitObjects(UDboolean notify);
+/* Damages the whole area of every window. */
+static void danteInvalidateWindows(void);
+/* Returns the outermost event loop, starting from 'loop', having
+ * events left to dispatch, NULL if none has, batches of enclosing
+ * loops were removed from the queue first.
+ */
+static DanteEventLoop* danteEventSource(DanteEventLoop* loop);
+/* Puts 'num' 'events' back at the head of the SDL event queue. */
+static void danteRequeueEvents(SDL_Event* events, int num);
 
 static UDboolean danteGetEnvVariable(const char* name, UDboolean defval)
 {
@@ -159,6 +207,13 @@ DanteObject* DANTEAPIENTRY danteAllocObject(UDenum type)
 	obj->vt = NULL;
 	obj->dispatch = NULL;
 	obj->parent = NULL;
+	obj->area.x = 0;
+	obj->area.y = 0;
+	obj->area.w = 0;
+	obj->area.h = 0;
+	obj->slot = -1;
+	obj->range = -1;
+	obj->dirty = true;
 	memset(&obj->d, 0, sizeof(obj->d));
 	return obj;
 }
@@ -230,65 +285,188 @@ DanteObject* DANTEAPIENTRY danteRefObject(DanteObject* obj)
 	return obj;
 }
 
+static void danteFreeObject(DanteObject* obj)
+{
+	DanteSlice* slice = obj->slice;
+	
+	/* partially initialized objects may lack a virtual table */
+	if (obj->vt && obj->vt->clear) {
+		obj->vt->clear(obj);
+	}
+	
+	obj->type = UDESK_NONE;
+	if (slice) {
+		/* object belongs to slice managed memory */
+		obj->d.none.next = slice->first_free;
+		slice->first_free = obj;
+		slice->used--;
+		if (slice->used == 0) {
+			/* free the slice, give back memory to the OS */
+			slice->next_free->prev_free = slice->prev_free;
+			slice->prev_free->next_free = slice->next_free;
+			slice->next->prev = slice->prev;
+			slice->prev->next = slice->next;
+			free(slice);
+		}
+		
+	} else if (obj->handle > DANTE_EVENT_RING) {
+		/* object belongs to static fast cache */
+		obj->d.none.next = dante_context->cache_free;
+		dante_context->cache_free = obj;
+	}
+	/* else: event ring slot, it is reused in place */
+}
+
+static UDboolean danteDeferObject(DanteObject* obj)
+{
+	if (dante_context->num_doomed == dante_context->doomed_capacity) {
+		UDint capacity;
+		DanteObject** doomed;
+		
+		if (dante_context->doomed_first > 0) {
+			/* compact collected entries away */
+			dante_context->num_doomed -= dante_context->doomed_first;
+			memmove(dante_context->doomed, dante_context->doomed + dante_context->doomed_first,
+			        dante_context->num_doomed * sizeof(*doomed));
+			dante_context->doomed_first = 0;
+			
+		} else {
+			capacity = (dante_context->doomed_capacity > 0)? dante_context->doomed_capacity * 2 : 16;
+			doomed = (DanteObject**)realloc(dante_context->doomed, capacity * sizeof(*doomed));
+			if (!doomed) {
+				return false;
+			}
+			
+			dante_context->doomed = doomed;
+			dante_context->doomed_capacity = capacity;
+		}
+	}
+	
+	obj->vt->retire(obj);
+	/* invalidate the handle now, the slot stays allocated until
+	 * the object is collected
+	 */
+	obj->type = UDESK_NONE;
+	dante_context->doomed[dante_context->num_doomed++] = obj;
+	return true;
+}
+
 void DANTEAPIENTRY danteUnrefObject(DanteObject* obj)
 {
 	if (obj) {
 		obj->refs--;
 		if (obj->refs == 0) {
-			DanteSlice* slice = obj->slice;
-	
-			/* partially initialized objects may lack a virtual table */
-			if (obj->vt && obj->vt->clear) {
-				obj->vt->clear(obj);
+			if (dante_context->deferred && obj->vt && obj->vt->retire && danteDeferObject(obj)) {
+				return;
 			}
 			
-			obj->type = UDESK_NONE;
-			if (slice) {
-				/* object belongs to slice managed memory */
-				obj->d.none.next = slice->first_free;
-				slice->first_free = obj;
-				slice->used--;
-				if (slice->used == 0) {
-					/* free the slice, give back memory to the OS */
-					slice->next_free->prev_free = slice->prev_free;
-					slice->prev_free->next_free = slice->next_free;
-					slice->next->prev = slice->prev;
-					slice->prev->next = slice->next;
-					free(slice);
-				}
-				
-			} else {
-				/* object belongs to static fast cache */
-				obj->d.none.next = dante_context->cache_free;
-				dante_context->cache_free = obj;
-			}
+			danteFreeObject(obj);
+		}
+	}
+}
+
+UDboolean DANTEAPIENTRY danteCollectObjects(Uint32 budget)
+{
+	Uint32 start = SDL_GetTicks();
+	
+	while (dante_context->doomed_first < dante_context->num_doomed) {
+		danteFreeObject(dante_context->doomed[dante_context->doomed_first++]);
+		if (budget > 0 && SDL_GetTicks() - start >= budget) {
+			break;
+		}
+	}
+	
+	if (dante_context->doomed_first == dante_context->num_doomed) {
+		dante_context->doomed_first = 0;
+		dante_context->num_doomed = 0;
+		return false;
+	}
+	
+	return true;
+}
+
+static UDboolean danteThreadedRendering(UDboolean headless)
+{
+	const char* driver;
+	size_t i;
+	
+	if (headless) {
+		/* software renderers drawing to plain surfaces */
+		return true;
+	}
+	
+	driver = SDL_GetCurrentVideoDriver();
+	for (i = 0; driver && i < sizeof(dante_thread_drivers) / sizeof(dante_thread_drivers[0]); i++) {
+		if (strcmp(driver, dante_thread_drivers[i]) == 0) {
+			return true;
 		}
 	}
+	
+	return false;
 }
 
 UDenum UDESKAPIENTRY udeskCreateContext(int* argc, char** argv[])
 {
 	DanteContext* ctx;
+	UDboolean headless;
+	UDboolean threaded;
 	UDint i;
 	
 	DANTE_IGNORE_AND_RETVAL_IF(!argc || !argv || *argc <= 0 || !*argv[0], UDESK_INVALID_VALUE);
 	DANTE_IGNORE_AND_RETVAL_IF(dante_context, UDESK_INVALID_OPERATION);
 	
-	/* initialize SDL */
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_NOPARACHUTE) != 0) {
+	/* initialize SDL, headless contexts force the dummy video driver */
+	headless = danteGetEnvVariable(DANTE_ENV_HEADLESS, false);
+	if (headless) {
+		if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER | SDL_INIT_NOPARACHUTE) != 0) {
+			return UDESK_OPERATION_FAILED;
+		}
+		if (SDL_VideoInit("dummy") != 0) {
+			SDL_Quit();
+			return UDESK_OPERATION_FAILED;
+		}
+		
+	} else if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_NOPARACHUTE) != 0) {
 		return UDESK_OPERATION_FAILED;
 	}
 	
 	/* initialize context */
 	ctx = (DanteContext*)malloc(sizeof(*ctx));
 	if (!ctx) {
+		if (headless) {
+			SDL_VideoQuit();
+		}
+		
+		SDL_Quit();
 		return UDESK_OUT_OF_MEMORY;
 	}
 	
+	/* nothing may fail past this point, no need to unwind these */
+	danteInitConvert();
+	danteInitScale();
+	danteInitImage();
+	
 	memset(ctx, 0, sizeof(*ctx));
 	ctx->error = UDESK_NO_ERROR;
 	ctx->vsync = danteGetEnvVariable(DANTE_ENV_VSYNC, true);
 	ctx->accelerated = danteGetEnvVariable(DANTE_ENV_ACCELERATED, true);
+	ctx->deferred = danteGetEnvVariable(DANTE_ENV_DEFERRED, false);
+	ctx->headless = headless;
+	threaded = danteGetEnvVariable(DANTE_ENV_RENDER_THREAD, false) && danteThreadedRendering(headless);
+	for (i = 0; i < DANTE_RENDER_QUEUES; i++) {
+		danteQueueInit(&ctx->render[i], threaded);
+	}
+	ctx->flush_event = SDL_RegisterEvents(1);
+	ctx->decode_event = SDL_RegisterEvents(1);
+	if (danteGetEnvVariable(DANTE_ENV_POOL, false)) {
+		ctx->pool_size = DANTE_WINDOW_POOL;
+	}
+	ctx->textures.lru_prev = &ctx->textures;
+	ctx->textures.lru_next = &ctx->textures;
+	ctx->texture_budget = DANTE_TEXTURE_BUDGET;
+	ctx->scaled_lru.lru_prev = &ctx->scaled_lru;
+	ctx->scaled_lru.lru_next = &ctx->scaled_lru;
+	ctx->scaled_budget = DANTE_SCALED_BUDGET;
 	ctx->slice.base = UDESK_HANDLE_NONE;
 	ctx->slice.used = 0;
 	ctx->slice.next = &ctx->slice;
@@ -296,16 +474,21 @@ UDenum UDESKAPIENTRY udeskCreateContext(int* argc, char** argv[])
 	ctx->slice.next_free = &ctx->slice;
 	ctx->slice.prev_free = &ctx->slice;
 	
-	/* initialize the fast cache */
+	/* initialize the fast cache, event ring slots stay out of
+	 * the free list
+	 */
 	for (i = 0; i < DANTE_FAST_CACHESIZE; i++) {
 		ctx->cache[i].type = UDESK_NONE;
 		ctx->cache[i].handle = 1 + i;
 		ctx->cache[i].slice = NULL;
-		ctx->cache[i].d.none.next = ctx->cache_free;
-		ctx->cache_free = &ctx->cache[i];
+		if (i >= DANTE_EVENT_RING) {
+			ctx->cache[i].d.none.next = ctx->cache_free;
+			ctx->cache_free = &ctx->cache[i];
+		}
 	}
 	
 	dante_context = ctx;
+	danteFillWindowPool(0);
 	return UDESK_NO_ERROR;
 }
 
@@ -329,8 +512,6 @@ void UDESKAPIENTRY udeskGenObjects(UDenum type, UDint num, UDhandle* dst)
 			
 			switch (type) {
 			case UDESK_HANDLE_CONTAINER:
-			case UDESK_HANDLE_PIXMAP:
-			case UDESK_HANDLE_LAYER:
 			case UDESK_HANDLE_BAR:
 			case UDESK_HANDLE_MENU:
 			case UDESK_HANDLE_TIMER:
@@ -341,6 +522,14 @@ void UDESKAPIENTRY udeskGenObjects(UDenum type, UDint num, UDhandle* dst)
 				success = danteWindowInit(obj);
 				break;
 			
+			case UDESK_HANDLE_PIXMAP:
+				success = dantePixmapInit(obj);
+				break;
+			
+			case UDESK_HANDLE_LAYER:
+				success = danteLayerInit(obj);
+				break;
+			
 			case UDESK_HANDLE_EVENT:
 				success = danteEventInit(obj);
 				break;
@@ -401,6 +590,123 @@ void UDESKAPIENTRY udeskRegisterHandler(UDhandle handle, UDenum param, UDhandler
 	obj->vt->handler(obj, param, proc);
 }
 
+void UDESKAPIENTRY udeskGetiv(UDenum param, UDint* dst)
+{
+	SDL_DisplayMode mode;
+	
+	DANTE_IGNORE_IF(!dante_context);
+	DANTE_ERROR_IF(!dst, UDESK_INVALID_VALUE);
+	
+	switch (param) {
+	case UDESK_SCREEN_SIZE:
+		/* windows are drawn on the first display */
+		DANTE_ERROR_IF(SDL_GetDesktopDisplayMode(0, &mode) != 0, UDESK_OPERATION_FAILED);
+		
+		dst[0] = mode.w;
+		dst[1] = mode.h;
+		break;
+	
+	case UDESK_SCREENSAVER_ENABLE:
+		dst[0] = (SDL_IsScreenSaverEnabled())? 1 : 0;
+		break;
+	
+	case UDESK_TEXTURE_BUDGET_EXT:
+		dst[0] = (UDint)(dante_context->texture_budget / 1024);
+		break;
+	
+	case UDESK_TEXTURE_RESIDENT_EXT:
+		dst[0] = (UDint)(dante_context->texture_bytes / 1024);
+		break;
+	
+	case UDESK_TEXTURE_HITS_EXT:
+		dst[0] = (UDint)dante_context->texture_hits;
+		break;
+	
+	case UDESK_TEXTURE_MISSES_EXT:
+		dst[0] = (UDint)dante_context->texture_misses;
+		break;
+	
+	case UDESK_SCALED_BUDGET_EXT:
+		dst[0] = (UDint)(dante_context->scaled_budget / 1024);
+		break;
+	
+	case UDESK_SCALED_RESIDENT_EXT:
+		dst[0] = (UDint)(dante_context->scaled_bytes / 1024);
+		break;
+	
+	case UDESK_DECODE_PENDING_EXT:
+		dst[0] = dante_context->num_decodes;
+		break;
+	
+	case UDESK_DECODE_TIME_EXT:
+		dst[0] = (UDint)(dante_context->decode_time * 1000 / SDL_GetPerformanceFrequency());
+		break;
+	
+	case UDESK_DECODE_COUNT_EXT:
+		dst[0] = dante_context->decoded;
+		break;
+	
+	default:
+		dante_context->error = UDESK_INVALID_ENUM;
+		break;
+	}
+}
+
+void UDESKAPIENTRY udeskSetiv(UDenum param, const UDint* to)
+{
+	DANTE_IGNORE_IF(!dante_context);
+	DANTE_ERROR_IF(!to, UDESK_INVALID_VALUE);
+	
+	switch (param) {
+	case UDESK_SCREENSAVER_ENABLE:
+		if (to[0]) {
+			SDL_EnableScreenSaver();
+		} else {
+			SDL_DisableScreenSaver();
+		}
+		
+		break;
+	
+	case UDESK_TEXTURE_BUDGET_EXT:
+		DANTE_ERROR_IF(to[0] < 0 || (Uint32)to[0] > 0xffffffffu / 1024, UDESK_INVALID_VALUE);
+		/* textures are evicted before the next window is drawn */
+		dante_context->texture_budget = (Uint32)to[0] * 1024;
+		break;
+	
+	case UDESK_SCALED_BUDGET_EXT:
+		DANTE_ERROR_IF(to[0] < 0 || (Uint32)to[0] > 0xffffffffu / 1024, UDESK_INVALID_VALUE);
+		/* unused entries are evicted as soon as one is released */
+		dante_context->scaled_budget = (Uint32)to[0] * 1024;
+		break;
+	
+	case UDESK_TEXTURE_HITS_EXT:
+	case UDESK_TEXTURE_MISSES_EXT:
+		/* counters may only be reset */
+		DANTE_ERROR_IF(to[0] != 0, UDESK_INVALID_VALUE);
+		
+		if (param == UDESK_TEXTURE_HITS_EXT) {
+			dante_context->texture_hits = 0;
+		} else {
+			dante_context->texture_misses = 0;
+		}
+		
+		break;
+	
+	case UDESK_DECODE_TIME_EXT:
+	case UDESK_DECODE_COUNT_EXT:
+		/* reset together, so that their ratio stays meaningful */
+		DANTE_ERROR_IF(to[0] != 0, UDESK_INVALID_VALUE);
+		
+		dante_context->decode_time = 0;
+		dante_context->decoded = 0;
+		break;
+	
+	default:
+		dante_context->error = UDESK_INVALID_ENUM;
+		break;
+	}
+}
+
 void UDESKAPIENTRY udeskBegin(UDhandle handle, UDenum mode)
 {
 	DanteObject* obj;
@@ -441,49 +747,248 @@ void UDESKAPIENTRY udeskFlush(UDhandle handle)
 		}
 		
 	} else {
-		DanteSlice* slice;
-		DanteObject* obj;
-		UDint i;
-		
-		for (i = 0; i < DANTE_FAST_CACHESIZE; i++) {
-			obj = &dante_context->cache[i];
-			if (obj->type != UDESK_NONE && obj->vt->flush) {
-				obj->vt->flush(obj);
+		/* submit every window first, so that their render queues
+		 * present concurrently, then wait for the slowest one
+		 */
+		danteFenceWait(danteSubmitObjects(false));
+	}
+}
+
+static Uint32 danteSubmitObject(DanteObject* obj, Uint32 fence, UDboolean notify)
+{
+	if (obj->vt->submit) {
+		return obj->vt->submit(obj, notify);
+	}
+	
+	if (obj->vt->flush) {
+		obj->vt->flush(obj);
+	}
+	
+	return fence;
+}
+
+static Uint32 danteSubmitObjects(UDboolean notify)
+{
+	DanteSlice* slice;
+	DanteObject* obj;
+	Uint32 fence = 0;
+	UDint i;
+	
+	/* fences are ordered across queues, the last one covers
+	 * every frame submitted before it.
+	 */
+	for (i = 0; i < DANTE_FAST_CACHESIZE; i++) {
+		obj = &dante_context->cache[i];
+		if (obj->type != UDESK_NONE) {
+			fence = danteSubmitObject(obj, fence, notify);
+		}
+	}
+	for (slice = dante_context->slice.next; slice->base != UDESK_HANDLE_NONE; slice = slice->next) {
+		for (i = 0; i < DANTE_SLICE_CACHESIZE; i++) {
+			obj = &slice->data[i];
+			if (obj->type != UDESK_NONE) {
+				fence = danteSubmitObject(obj, fence, notify);
 			}
 		}
-		for (slice = dante_context->slice.next; slice->base != UDESK_HANDLE_NONE; slice = slice->next) {
-			for (i = 0; i < DANTE_SLICE_CACHESIZE; i++) {
-				obj = &slice->data[i];
-				if (obj->type != UDESK_NONE && obj->vt->flush) {
-					obj->vt->flush(obj);
-				}
+	}
+	
+	return fence;
+}
+
+UDint UDESKAPIENTRY udeskFlushAsyncEXT(UDhandle handle)
+{
+	Uint32 fence = 0;
+	
+	DANTE_IGNORE_AND_RETVAL_IF(!dante_context, 0);
+	
+	if (handle != UDESK_HANDLE_NONE) {
+		DanteObject* obj = danteGetObject(handle);
+		
+		DANTE_ERROR_AND_RETVAL_IF(!obj, UDESK_INVALID_VALUE, 0);
+		
+		fence = danteSubmitObject(obj, fence, true);
+		
+	} else {
+		fence = danteSubmitObjects(true);
+	}
+	
+	/* fences reached before returning are reported as complete */
+	if (danteFencePoll(fence)) {
+		fence = 0;
+	}
+	
+	return (UDint)fence;
+}
+
+UDboolean UDESKAPIENTRY udeskPollFenceEXT(UDint fence)
+{
+	DANTE_IGNORE_AND_RETVAL_IF(!dante_context, true);
+	
+	return danteFencePoll((Uint32)fence);
+}
+
+void UDESKAPIENTRY udeskWaitFenceEXT(UDint fence)
+{
+	DANTE_IGNORE_IF(!dante_context);
+	
+	danteFenceWait((Uint32)fence);
+}
+
+static void danteInvalidateWindows(void)
+{
+	DanteSlice* slice;
+	DanteObject* obj;
+	UDint i;
+	
+	for (i = 0; i < DANTE_FAST_CACHESIZE; i++) {
+		obj = &dante_context->cache[i];
+		if (obj->type == UDESK_HANDLE_WINDOW) {
+			danteInvalidateObject(obj);
+		}
+	}
+	for (slice = dante_context->slice.next; slice->base != UDESK_HANDLE_NONE; slice = slice->next) {
+		for (i = 0; i < DANTE_SLICE_CACHESIZE; i++) {
+			obj = &slice->data[i];
+			if (obj->type == UDESK_HANDLE_WINDOW) {
+				danteInvalidateObject(obj);
 			}
 		}
 	}
 }
 
+static DanteEventLoop* danteEventSource(DanteEventLoop* loop)
+{
+	DanteEventLoop* ret = NULL;
+	
+	for (; loop; loop = loop->outer) {
+		if (loop->next < loop->num) {
+			ret = loop;
+		}
+	}
+	
+	return ret;
+}
+
+static void danteRequeueEvents(SDL_Event* events, int num)
+{
+	SDL_Event* queued = NULL;
+	int count;
+	
+	/* SDL only appends events, those queued meanwhile are taken out
+	 * and appended again, if out of memory the order is lost instead
+	 */
+	count = SDL_PeepEvents(NULL, 0, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+	if (count > 0) {
+		queued = (SDL_Event*)malloc(count * sizeof(*queued));
+	}
+	if (queued) {
+		count = SDL_PeepEvents(queued, count, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+	}
+	
+	SDL_PeepEvents(events, num, SDL_ADDEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+	if (queued) {
+		if (count > 0) {
+			SDL_PeepEvents(queued, count, SDL_ADDEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+		}
+		
+		free(queued);
+	}
+}
+
 void UDESKAPIENTRY udeskMakeContextCurrent(void)
 {
-	SDL_Event ev;
+	DanteEventLoop loop;
+	DanteEventLoop* src;
+	SDL_Event* ev;
+	int num;
 	
 	DANTE_IGNORE_IF(!dante_context);
 	DANTE_ERROR_IF(dante_context->current, UDESK_INVALID_OPERATION);
 	
+	loop.next = 0;
+	loop.num = 0;
+	loop.outer = dante_context->loop;
+	dante_context->loop = &loop;
 	dante_context->current = true;
 	do {
-		if (SDL_WaitEvent(&ev)) {
-			switch (ev.type) {
+		/* once every batch is dispatched, wait for events and remove
+		 * a new batch from the queue, events are dispatched in place.
+		 * While objects wait for destruction, or the window pool
+		 * needs refilling, idle time is used to do so.
+		 */
+		if (!danteEventSource(&loop)) {
+			if (dante_context->num_doomed > 0 || dante_context->num_pooled < dante_context->pool_size) {
+				if (!SDL_WaitEventTimeout(NULL, DANTE_COLLECT_IDLE)) {
+					if (dante_context->num_doomed > 0) {
+						danteCollectObjects(DANTE_COLLECT_BUDGET);
+					} else {
+						danteFillWindowPool(1);
+					}
+					
+					continue;
+				}
+				
+			} else if (!SDL_WaitEvent(NULL)) {
+				continue;
+			}
+			
+			num = SDL_PeepEvents(loop.batch, DANTE_EVENT_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+			loop.next = 0;
+			loop.num = SDL_max(num, 0);
+		}
+		
+		while (dante_context->current && (src = danteEventSource(&loop)) != NULL) {
+			ev = &src->batch[src->next++];
+			switch (ev->type) {
 			/* window event */
 			case SDL_WINDOWEVENT:
-				danteHandleWindowEvent(&ev);
+				danteHandleWindowEvent(ev);
+				break;
+			
+			/* input events */
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+			case SDL_MOUSEBUTTONDOWN:
+			case SDL_MOUSEBUTTONUP:
+			case SDL_MOUSEMOTION:
+			case SDL_FINGERDOWN:
+			case SDL_FINGERUP:
+			case SDL_FINGERMOTION:
+				danteHandleInputEvent(ev);
+				break;
+			
+			/* render target contents lost, windows must be fully redrawn */
+			case SDL_RENDER_TARGETS_RESET:
+				danteInvalidateWindows();
 				break;
 			
 			default:
+				/* frame completion, pushed by the render queue */
+				if (ev->type == dante_context->flush_event) {
+					danteHandleFlushEvent(ev);
+				}
+				/* image decoded by a worker thread */
+				if (ev->type == dante_context->decode_event) {
+					danteHandleDecodeEvent();
+				}
+				
 				break;
 			}
 		}
 		
+		/* teardown postponed by the handlers above */
+		if (dante_context->num_doomed > 0) {
+			danteCollectObjects(DANTE_COLLECT_BUDGET);
+		}
+		
 	} while (dante_context->current);
+	
+	/* a stopped loop leaves its undispatched events to the next one */
+	if (loop.next < loop.num) {
+		danteRequeueEvents(loop.batch + loop.next, loop.num - loop.next);
+	}
+	
+	dante_context->loop = loop.outer;
 }
 
 void UDESKAPIENTRY udeskMakeContextNone(void)
@@ -501,6 +1006,11 @@ UDenum UDESKAPIENTRY udeskDestroyContext(void)
 	
 	DANTE_IGNORE_AND_RETVAL_IF(!dante_context, UDESK_INVALID_OPERATION);
 	
+	/* destroy immediately from now on */
+	dante_context->deferred = false;
+	danteCollectObjects(0);
+	danteDestroyAtlases();
+	
 	slice = dante_context->slice.next;
 	while (slice->base != UDESK_HANDLE_NONE) {
 		DanteSlice* next = slice->next;
@@ -525,7 +1035,24 @@ UDenum UDESKAPIENTRY udeskDestroyContext(void)
 		}
 	}
 	
+	danteCollectObjects(0);
+	free(dante_context->doomed);
+	danteDrainWindowPool();
+	danteWorkersDestroy();
+	danteDestroyDecodes();
+	if (dante_context->placeholder) {
+		danteReleasePixels(dante_context->placeholder);
+	}
+	for (i = 0; i < DANTE_RENDER_QUEUES; i++) {
+		danteQueueDestroy(&dante_context->render[i]);
+	}
+	if (dante_context->headless) {
+		/* video was initialized outside SDL_Init() */
+		SDL_VideoQuit();
+	}
+	
 	free(dante_context);
+	danteQuitImage();
 	SDL_Quit();
 	
 	dante_context = NULL;
@@ -0,0 +1,399 @@
+/* convert.c: Pixel format conversion.
+ *
+ * Converts application pixels to the pixmap storage format,
+ * premultiplied SDL_PIXELFORMAT_BGRA32, which is the native
+ * ARGB8888 format of most renderers on little endian machines.
+ * Kernels are vectorized with SSE2, AVX2 or NEON when available,
+ * the best one supported by the running CPU is selected once.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DANTE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(DANTE_HAVE_SSE2) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1700))
+#define DANTE_HAVE_AVX2
+#include <immintrin.h>
+#ifdef __GNUC__
+#define DANTE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DANTE_TARGET_AVX2
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DANTE_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+/* Rows converted by each task. */
+#define DANTE_CONVERT_STRIP 64
+/* Images with fewer pixels are converted by the calling thread alone. */
+#define DANTE_CONVERT_PARALLEL (512 * 512)
+/* Number of elements in a static array. */
+#define DANTE_ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+/* Conversion kernel, converts 'count' pixels from 'src' to 'dst'. */
+typedef void (*DanteConvertFunc)(Uint8* dst, const Uint8* src, int count);
+
+/* Conversion in progress, split in strips of rows. */
+typedef struct DanteConvert_s {
+	DanteConvertFunc convert;
+	SDL_Surface* dst;
+	const Uint8* src;
+	int pitch;
+	/* first and past the last destination rows converted. */
+	int first;
+	int last;
+	/* rows converted by each task. */
+	int strip;
+} DanteConvert;
+
+/* Kernels of a CPU feature level. */
+typedef struct DanteConvertLevel_s {
+	const char* name;
+	DanteConvertFunc rgba;
+	DanteConvertFunc rgb;
+	/* returns whether the CPU supports the level, NULL if always. */
+	SDL_bool (SDLCALL *supported)(void);
+} DanteConvertLevel;
+
+/* Returns 'c' * 'a' / 255, rounded to nearest, for 8 bit values. */
+static Uint8 danteMul255(Uint32 c, Uint32 a);
+/* Scalar kernels, converting RGBA pixels to premultiplied BGRA and
+ * RGB pixels to opaque BGRA, also used for the tail of vector kernels.
+ */
+static void danteConvertRGBA(Uint8* dst, const Uint8* src, int count);
+static void danteConvertRGB(Uint8* dst, const Uint8* src, int count);
+/* Parallel task, converting strip 'index' of the DanteConvert 'data'. */
+static void danteConvertStrip(void* data, UDint index);
+#ifdef DANTE_HAVE_SSE2
+/* Premultiplies four 16 bit per channel pixels in 'px', whose
+ * alpha is stored in every 4th lane.
+ */
+static __m128i dantePremultiplySSE2(__m128i px);
+/* SSE2 kernels, RGB pixels have no SSE2 kernel (byte shuffles
+ * require SSSE3).
+ */
+static void danteConvertRGBASSE2(Uint8* dst, const Uint8* src, int count);
+#endif
+#ifdef DANTE_HAVE_AVX2
+/* AVX2 equivalent of dantePremultiplySSE2(), for eight pixels. */
+static DANTE_TARGET_AVX2 __m256i dantePremultiplyAVX2(__m256i px);
+/* AVX2 kernels. */
+static DANTE_TARGET_AVX2 void danteConvertRGBAAVX2(Uint8* dst, const Uint8* src, int count);
+static DANTE_TARGET_AVX2 void danteConvertRGBAVX2(Uint8* dst, const Uint8* src, int count);
+#endif
+#ifdef DANTE_HAVE_NEON
+/* Returns 'c' * 'a' / 255 for sixteen 8 bit values. */
+static uint8x16_t danteMul255NEON(uint8x16_t c, uint8x16_t a);
+/* NEON kernels. */
+static void danteConvertRGBANEON(Uint8* dst, const Uint8* src, int count);
+static void danteConvertRGBNEON(Uint8* dst, const Uint8* src, int count);
+#endif
+
+/* Kernel levels, in order of preference, the scalar one first. */
+static const DanteConvertLevel dante_convert_levels[] = {
+	{ "scalar", danteConvertRGBA, danteConvertRGB, NULL },
+#ifdef DANTE_HAVE_SSE2
+	{ "sse2", danteConvertRGBASSE2, danteConvertRGB, SDL_HasSSE2 },
+#endif
+#ifdef DANTE_HAVE_AVX2
+	{ "avx2", danteConvertRGBAAVX2, danteConvertRGBAVX2, SDL_HasAVX2 },
+#endif
+#ifdef DANTE_HAVE_NEON
+	{ "neon", danteConvertRGBANEON, danteConvertRGBNEON, SDL_HasNEON },
+#endif
+};
+
+/* Kernels selected by danteInitConvert(). */
+static DanteConvertFunc dante_convert_rgba = danteConvertRGBA;
+static DanteConvertFunc dante_convert_rgb = danteConvertRGB;
+
+static Uint8 danteMul255(Uint32 c, Uint32 a)
+{
+	Uint32 t = c * a + 128;
+	
+	return (Uint8)((t + (t >> 8)) >> 8);
+}
+
+static void danteConvertRGBA(Uint8* dst, const Uint8* src, int count)
+{
+	int i;
+	
+	for (i = 0; i < count; i++) {
+		dst[0] = danteMul255(src[2], src[3]);
+		dst[1] = danteMul255(src[1], src[3]);
+		dst[2] = danteMul255(src[0], src[3]);
+		dst[3] = src[3];
+		src += 4;
+		dst += 4;
+	}
+}
+
+static void danteConvertRGB(Uint8* dst, const Uint8* src, int count)
+{
+	int i;
+	
+	for (i = 0; i < count; i++) {
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+		dst[3] = 0xff;
+		src += 3;
+		dst += 4;
+	}
+}
+
+#ifdef DANTE_HAVE_SSE2
+
+static __m128i dantePremultiplySSE2(__m128i px)
+{
+	const __m128i opaque = _mm_setr_epi16(0, 0, 0, 0xff, 0, 0, 0, 0xff);
+	const __m128i half = _mm_set1_epi16(128);
+	__m128i a;
+	__m128i t;
+	
+	/* broadcast alpha, leaving alpha itself multiplied by 255 */
+	a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_or_si128(a, opaque);
+	t = _mm_add_epi16(_mm_mullo_epi16(px, a), half);
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void danteConvertRGBASSE2(Uint8* dst, const Uint8* src, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v;
+	__m128i lo;
+	__m128i hi;
+	int i;
+	
+	for (i = 0; i + 4 <= count; i += 4) {
+		v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		
+		/* widen and swap R with B */
+		lo = _mm_unpacklo_epi8(v, zero);
+		hi = _mm_unpackhi_epi8(v, zero);
+		lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+		hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+		
+		lo = dantePremultiplySSE2(lo);
+		hi = dantePremultiplySSE2(hi);
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_packus_epi16(lo, hi));
+	}
+	
+	danteConvertRGBA(dst + i * 4, src + i * 4, count - i);
+}
+
+#endif /* DANTE_HAVE_SSE2 */
+
+#ifdef DANTE_HAVE_AVX2
+
+static DANTE_TARGET_AVX2 __m256i dantePremultiplyAVX2(__m256i px)
+{
+	const __m256i opaque = _mm256_setr_epi16(0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff);
+	const __m256i half = _mm256_set1_epi16(128);
+	__m256i a;
+	__m256i t;
+	
+	a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm256_or_si256(a, opaque);
+	t = _mm256_add_epi16(_mm256_mullo_epi16(px, a), half);
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+static DANTE_TARGET_AVX2 void danteConvertRGBAAVX2(Uint8* dst, const Uint8* src, int count)
+{
+	const __m256i swap = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+	);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i v;
+	__m256i lo;
+	__m256i hi;
+	int i;
+	
+	for (i = 0; i + 8 <= count; i += 8) {
+		v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		v = _mm256_shuffle_epi8(v, swap);
+		
+		/* unpack and pack work within 128 bit lanes, pixel order is kept */
+		lo = dantePremultiplyAVX2(_mm256_unpacklo_epi8(v, zero));
+		hi = dantePremultiplyAVX2(_mm256_unpackhi_epi8(v, zero));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_packus_epi16(lo, hi));
+	}
+	
+	danteConvertRGBA(dst + i * 4, src + i * 4, count - i);
+}
+
+static DANTE_TARGET_AVX2 void danteConvertRGBAVX2(Uint8* dst, const Uint8* src, int count)
+{
+	const __m256i expand = _mm256_setr_epi8(
+		2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+		2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+	);
+	const __m256i opaque = _mm256_set1_epi32((int)0xff000000u);
+	__m256i v;
+	int i;
+	
+	/* each lane loads 16 bytes for 4 pixels, the second lane
+	 * reads 4 bytes past the 8 pixels of each step
+	 */
+	for (i = 0; i + 10 <= count; i += 8) {
+		v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + i * 3)));
+		v = _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i*)(src + i * 3 + 12)), 1);
+		v = _mm256_or_si256(_mm256_shuffle_epi8(v, expand), opaque);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), v);
+	}
+	
+	danteConvertRGB(dst + i * 4, src + i * 3, count - i);
+}
+
+#endif /* DANTE_HAVE_AVX2 */
+
+#ifdef DANTE_HAVE_NEON
+
+static uint8x16_t danteMul255NEON(uint8x16_t c, uint8x16_t a)
+{
+	uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+	uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+	
+	/* (t + 128 + ((t + 128) >> 8)) >> 8, same as danteMul255() */
+	return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)), vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+static void danteConvertRGBANEON(Uint8* dst, const Uint8* src, int count)
+{
+	uint8x16x4_t px;
+	uint8x16x4_t out;
+	int i;
+	
+	for (i = 0; i + 16 <= count; i += 16) {
+		px = vld4q_u8(src + i * 4);
+		out.val[0] = danteMul255NEON(px.val[2], px.val[3]);
+		out.val[1] = danteMul255NEON(px.val[1], px.val[3]);
+		out.val[2] = danteMul255NEON(px.val[0], px.val[3]);
+		out.val[3] = px.val[3];
+		vst4q_u8(dst + i * 4, out);
+	}
+	
+	danteConvertRGBA(dst + i * 4, src + i * 4, count - i);
+}
+
+static void danteConvertRGBNEON(Uint8* dst, const Uint8* src, int count)
+{
+	uint8x16x3_t px;
+	uint8x16x4_t out;
+	int i;
+	
+	out.val[3] = vdupq_n_u8(0xff);
+	for (i = 0; i + 16 <= count; i += 16) {
+		px = vld3q_u8(src + i * 3);
+		out.val[0] = px.val[2];
+		out.val[1] = px.val[1];
+		out.val[2] = px.val[0];
+		vst4q_u8(dst + i * 4, out);
+	}
+	
+	danteConvertRGB(dst + i * 4, src + i * 3, count - i);
+}
+
+#endif /* DANTE_HAVE_NEON */
+
+void DANTEAPIENTRY danteInitConvert(void)
+{
+	UDint i = 0;
+	
+	while (danteSelectConvert(i + 1)) {
+		i++;
+	}
+	danteSelectConvert(i);
+}
+
+const char* DANTEAPIENTRY danteSelectConvert(UDint level)
+{
+	const DanteConvertLevel* sel;
+	
+	if (level >= DANTE_ARRAY_SIZE(dante_convert_levels)) {
+		return NULL;
+	}
+	
+	sel = &dante_convert_levels[level];
+	if (sel->supported && !sel->supported()) {
+		return NULL;
+	}
+	
+	dante_convert_rgba = sel->rgba;
+	dante_convert_rgb = sel->rgb;
+	return sel->name;
+}
+
+static void danteConvertStrip(void* data, UDint index)
+{
+	DanteConvert* conv = (DanteConvert*)data;
+	int first = conv->first + (int)index * conv->strip;
+	int last = SDL_min(first + conv->strip, conv->last);
+	const Uint8* row = conv->src + (size_t)(first - conv->first) * conv->pitch;
+	Uint8* out = (Uint8*)conv->dst->pixels + (size_t)first * conv->dst->pitch;
+	int y;
+	
+	for (y = first; y < last; y++) {
+		conv->convert(out, row, conv->dst->w);
+		row += conv->pitch;
+		out += conv->dst->pitch;
+	}
+}
+
+void DANTEAPIENTRY danteConvertPixels(SDL_Surface* dst, const void* src, int pitch, UDenum format)
+{
+	danteConvertBand(dst, 0, dst->h, src, pitch, format);
+}
+
+void DANTEAPIENTRY danteConvertBand(SDL_Surface* dst, int y, int rows, const void* src, int pitch, UDenum format)
+{
+	DanteConvert conv;
+	
+	conv.convert = (format == UDESK_RGBA) ? dante_convert_rgba : dante_convert_rgb;
+	conv.dst = dst;
+	conv.src = (const Uint8*)src;
+	conv.pitch = pitch;
+	conv.first = y;
+	conv.last = y + rows;
+	if (dst->w * rows < DANTE_CONVERT_PARALLEL) {
+		conv.strip = rows;
+		danteConvertStrip(&conv, 0);
+		return;
+	}
+	
+	/* rows are independent, large images are split across workers */
+	conv.strip = DANTE_CONVERT_STRIP;
+	danteRunTasks(danteConvertStrip, &conv, (rows + DANTE_CONVERT_STRIP - 1) / DANTE_CONVERT_STRIP);
+}
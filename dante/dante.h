@@ -34,6 +34,9 @@
 #ifndef DANTE_H_
 #define DANTE_H_
 #include <udesk/udesk.h>
+/* extension prototypes are implemented by dante */
+#define UDESK_EXT_PROTOTYPES
+#include <udesk/udeskext.h>
 #include <SDL.h>
 #include <limits.h>
 #include <stddef.h>
@@ -93,6 +96,12 @@ extern "C" {
 /* compatibility with udesk style declarations */
 #define DANTEAPIENTRY
 
+/* Headless environment variable, defines whether Dante should run
+ * without a display, windows live on the SDL dummy video driver and
+ * render into in-memory software surfaces, which overrides any vsync
+ * or acceleration setting.
+ */
+#define DANTE_ENV_HEADLESS "DANTE_HEADLESS"
 /* VSync environment variable name that defines whether Dante
  * should enable vsync (if possible).
  */
@@ -102,6 +111,28 @@ extern "C" {
  * (whenever possible).
  */
 #define DANTE_ENV_ACCELERATED "DANTE_ACCELERATED"
+/* Deferred destruction environment variable, defines whether Dante
+ * should postpone expensive object teardown (such as destroying
+ * windows and renderers) to the end of the event loop iteration
+ * or to idle time, instead of performing it inside udeskDeleteObjects().
+ */
+#define DANTE_ENV_DEFERRED "DANTE_DEFERRED_DESTROY"
+/* Render thread environment variable, defines whether Dante should
+ * hand recorded frames to dedicated threads owning the renderers,
+ * so that presenting never blocks event processing, windows are
+ * spread over DANTE_RENDER_QUEUES threads and present concurrently.
+ * Only honored by headless contexts and by the SDL video drivers
+ * whose windows may be owned by another thread (X11, KMSDRM), where
+ * render threads create and destroy the windows as well, other
+ * drivers run render jobs on submission.
+ */
+#define DANTE_ENV_RENDER_THREAD "DANTE_RENDER_THREAD"
+/* Window pool environment variable, defines whether Dante should
+ * keep DANTE_WINDOW_POOL hidden windows and their renderers created
+ * in advance, so that udeskGenObjects() hands them out immediately,
+ * the pool is refilled in idle time.
+ */
+#define DANTE_ENV_POOL "DANTE_WINDOW_POOL"
 
 /* environment variables are sorted by priority,
  * for example vsync has higher priority than acceleration.
@@ -132,11 +163,23 @@ typedef struct DanteVTable_s {
 	 * should be ignored for this object.
 	 */
 	void (*flush)(struct DanteObject_s* self);
+	/* implements the udeskFlushAsyncEXT() function, queues the flush
+	 * and returns its render queue fence, NULL if flush operations
+	 * are synchronous for this object.
+	 */
+	Uint32 (*submit)(struct DanteObject_s* self, UDboolean notify);
 	/* frees any resource specific memory allocated on object
 	 * initialization. NULL if no object specific memory is used
 	 * by this object.
 	 */
 	void (*clear)(struct DanteObject_s* self);
+	/* detaches the object from the interface and drops any reference
+	 * it holds, leaving only the expensive teardown to clear(),
+	 * which must tolerate a retired object.
+	 * Objects providing it have their clear() deferred when the
+	 * context uses deferred destruction, NULL if teardown is cheap.
+	 */
+	void (*retire)(struct DanteObject_s* self);
 } DanteVTable;
 
 /* Handler dispatcher identifier, used to cache an handler resolution result. */
@@ -167,6 +210,12 @@ typedef struct DanteEventDispatch_s {
 	DanteHandlerproc motion;
 	/* touchscreen motion/pressure event. */
 	DanteHandlerproc touch;
+	/* event triggered when an asynchronous flush completed. */
+	DanteHandlerproc flushed;
+	/* event triggered when an asynchronous image load completed. */
+	DanteHandlerproc loaded;
+	/* event triggered when a streamed image load decoded more rows. */
+	DanteHandlerproc progress;
 } DanteEventDispatch;
 
 /* Dispatch table events identifier, for cached handler resolution. */
@@ -179,6 +228,9 @@ typedef struct DanteEventDispatch_s {
 #define DANTE_BUTTON_DISPATCH_ID  offsetof(DanteEventDispatch, button)
 #define DANTE_MOTION_DISPATCH_ID  offsetof(DanteEventDispatch, motion)
 #define DANTE_TOUCH_DISPATCH_ID   offsetof(DanteEventDispatch, touch)
+#define DANTE_FLUSH_DISPATCH_ID   offsetof(DanteEventDispatch, flushed)
+#define DANTE_LOAD_DISPATCH_ID    offsetof(DanteEventDispatch, loaded)
+#define DANTE_PROGRESS_DISPATCH_ID offsetof(DanteEventDispatch, progress)
 
 /* Extracts an handler from a dispatch table and an handler identifier. */
 #define DANTE_DISPATCH_HANDLER(table, id) (*(DanteHandlerproc*)((unsigned char*)(table) + (id)))
@@ -191,18 +243,203 @@ typedef struct DanteNoneObject_s {
 	struct DanteObject_s* next;
 } DanteNoneObject;
 
+/* Spatial index entry, an object laid out inside a window. */
+typedef struct DanteGridEntry_s {
+	/* indexed object, NULL if this entry is free. */
+	struct DanteObject_s* obj;
+	/* indexed area, window relative. */
+	SDL_Rect area;
+	/* object depth in the window tree, the window child has depth 1,
+	 * for free entries it holds the next free entry index (or -1).
+	 */
+	UDint depth;
+	/* insertion serial, on equal depth the latest inserted object
+	 * is considered on top.
+	 */
+	Uint32 serial;
+} DanteGridEntry;
+
+/* Spatial index grid cell, lists the entries overlapping the cell. */
+typedef struct DanteGridCell_s {
+	/* entry indexes. */
+	UDint* items;
+	/* number of used items. */
+	UDint count;
+	/* allocated items. */
+	UDint capacity;
+} DanteGridCell;
+
+/* Per window spatial index, a uniform grid over the window area
+ * that resolves the object under a point without scanning every
+ * laid out object.
+ * Every laid out object is stored into an entry and referenced by
+ * each cell its area overlaps, the grid is rebuilt when the window
+ * is resized or when the number of entries grows significantly,
+ * otherwise layout changes update it incrementally.
+ */
+typedef struct DanteGrid_s {
+	/* entries buffer. */
+	DanteGridEntry* entries;
+	/* number of entries in the buffer (including free ones). */
+	UDint num_entries;
+	/* allocated entries. */
+	UDint capacity;
+	/* first free entry, -1 if none. */
+	UDint first_free;
+	/* number of indexed objects. */
+	UDint used;
+	/* number of indexed objects at the last rebuild. */
+	UDint used_at_build;
+	/* next insertion serial. */
+	Uint32 serial;
+	/* cells buffer, cols * rows wide. */
+	DanteGridCell* cells;
+	/* grid columns. */
+	UDint cols;
+	/* grid rows. */
+	UDint rows;
+	/* log2 of the cell edge, in pixels. */
+	UDint shift;
+	/* indexed area width, in pixels. */
+	UDint width;
+	/* indexed area height, in pixels. */
+	UDint height;
+} DanteGrid;
+
+/* Maximum number of disjoint rectangles in a damage region, further
+ * rectangles are merged into the ones growing the least.
+ */
+#define DANTE_DAMAGE_RECTS 8
+
+/* Damage region, the window area that needs to be redrawn, kept as
+ * a small set of disjoint rectangles, overlapping ones are merged.
+ */
+typedef struct DanteDamage_s {
+	/* damaged rectangles, window relative. */
+	SDL_Rect rects[DANTE_DAMAGE_RECTS];
+	/* number of used rectangles. */
+	UDint count;
+} DanteDamage;
+
+/* Rendering statistics of a window frame. */
+typedef struct DanteFrameStats_s {
+	/* issued draw calls. */
+	UDint calls;
+	/* pixels covered by the draw calls, after clipping. */
+	UDint pixels;
+	/* redrawn damage rectangles. */
+	UDint rects;
+} DanteFrameStats;
+
+/* Display list command opcodes. */
+enum {
+	/* fills 'dst' with 'color'. */
+	DANTE_CMD_FILL,
+	/* copies 'src' from 'tex' to 'dst'. */
+	DANTE_CMD_COPY
+};
+
+/* Display list command, a renderer call recorded by the draw pass,
+ * commands carry all of their state, so that any of them may be
+ * skipped on replay.
+ */
+typedef struct DanteDrawCmd_s {
+	/* command opcode, any of the DANTE_CMD_* constants. */
+	Uint8 op;
+	/* true if 'src' is valid, otherwise the whole texture is used. */
+	Uint8 has_src;
+	/* true if 'dst' is valid, otherwise the whole window is used. */
+	Uint8 has_dst;
+	/* DANTE_CMD_FILL color. */
+	SDL_Color color;
+	/* DANTE_CMD_COPY texture. */
+	SDL_Texture* tex;
+	/* DANTE_CMD_COPY source rectangle. */
+	SDL_Rect src;
+	/* destination rectangle, window relative. */
+	SDL_Rect dst;
+} DanteDrawCmd;
+
+/* Display list range, the commands recorded by an object and its
+ * descendants, ranges are stored in pre-order.
+ */
+typedef struct DanteDrawRange_s {
+	/* object which recorded the range, only used for identification. */
+	struct DanteObject_s* obj;
+	/* object area at recording time. */
+	SDL_Rect area;
+	/* first command of the range. */
+	UDint first;
+	/* number of commands, descendants included. */
+	UDint count;
+	/* depth of the object in the window tree, 0 for the window. */
+	UDint depth;
+} DanteDrawRange;
+
+/* Retained display list, the commands recorded by a window draw pass,
+ * replayed against the renderer for each damaged rectangle.
+ */
+typedef struct DanteDisplayList_s {
+	/* recorded commands. */
+	DanteDrawCmd* cmds;
+	/* number of recorded commands. */
+	UDint num_cmds;
+	/* allocated commands. */
+	UDint cmd_capacity;
+	/* object ranges, in pre-order. */
+	DanteDrawRange* ranges;
+	/* number of ranges. */
+	UDint num_ranges;
+	/* allocated ranges. */
+	UDint range_capacity;
+	/* true if an allocation failed while recording. */
+	UDboolean failed;
+} DanteDisplayList;
+
+struct DanteRenderQueue_s;
+
+/* Maximum tracked depth of the hovered objects path, deeper objects
+ * still receive input but no enter or leave events.
+ */
+#define DANTE_HOVER_DEPTH 32
+
 /* Window object type. */
 typedef struct DanteWindowObject_s {
-	/* actual SDL window handler. */
+	/* actual SDL window handler, NULL until the window is first shown. */
 	SDL_Window* swin;
 	/* SDL window renderer for 'sdl_rc'. */
 	SDL_Renderer* render;
+	/* texture tile size for 'render', DANTE_TEXTURE_TILE at most and
+	 * clamped to its maximum texture size.
+	 */
+	SDL_Point tile;
 	/* window icon, NULL if default icon is used. */
 	struct DanteObject_s* icon;
 	/* window child, NULL if window has no child. */
 	struct DanteObject_s* child;
 	/* whether the window is resizeable or not. */
 	UDboolean resizable;
+	/* whether the window is decorated or not. */
+	UDboolean decorated;
+	/* window position and size, the position is SDL_WINDOWPOS_UNDEFINED
+	 * if it was never set, applied to 'swin' once it is created, then
+	 * kept current by window events, so that queries never reach SDL.
+	 */
+	SDL_Rect geometry;
+	/* window title not applied to 'swin' yet, NULL for the default
+	 * title or once applied.
+	 */
+	char* title;
+	/* window mapping mode, requested or as last reported by SDL. */
+	UDint mode;
+	/* properties set since they were last applied to 'swin', as a
+	 * bitmask of the DANTE_WINDOW_SET_* values.
+	 */
+	Uint32 pending;
+	/* true while an UDESK_WINDOW_PROPERTIES_EXT build is active,
+	 * property changes are applied by udeskEnd().
+	 */
+	UDboolean building;
 	/* user defined enter event handler, might be NULL. */
 	UDhandlerproc enter;
 	/* user defined focus event handler, might be NULL. */
@@ -213,6 +450,67 @@ typedef struct DanteWindowObject_s {
 	UDhandlerproc resize;
 	/* user defined destroy event handler, might be NULL. */
 	UDhandlerproc destroy;
+	/* user defined keyboard event handler, might be NULL. */
+	UDhandlerproc keyboard;
+	/* user defined button press event handler, might be NULL. */
+	UDhandlerproc press;
+	/* user defined button release event handler, might be NULL. */
+	UDhandlerproc release;
+	/* user defined motion event handler, might be NULL. */
+	UDhandlerproc motion;
+	/* user defined touch event handler, might be NULL. */
+	UDhandlerproc touch;
+	/* user defined asynchronous flush completion handler, might be NULL. */
+	UDhandlerproc flushed;
+	/* spatial index of the objects laid out inside the window. */
+	DanteGrid grid;
+	/* objects currently under the cursor, from the window child down
+	 * to the deepest hovered object, each one holds a reference.
+	 */
+	struct DanteObject_s* hover[DANTE_HOVER_DEPTH];
+	/* number of objects in the hover path. */
+	UDint hover_depth;
+	/* headless rendering surface, the last presented frame is stored
+	 * here, NULL unless running headless.
+	 */
+	SDL_Surface* surface;
+	/* retained window contents, only the damaged region is redrawn
+	 * on it before presenting, NULL if not created yet or if the
+	 * renderer doesn't support render targets.
+	 */
+	SDL_Texture* canvas;
+	/* 'canvas' width, in pixels. */
+	int canvas_w;
+	/* 'canvas' height, in pixels. */
+	int canvas_h;
+	/* window region that needs to be redrawn on next frame. */
+	DanteDamage damage;
+	/* damage rectangle currently being redrawn, NULL outside the draw pass. */
+	const SDL_Rect* clip;
+	/* statistics of the last drawn frame. */
+	DanteFrameStats stats;
+	/* display lists, the one being replayed and the one being recorded,
+	 * clean object ranges are copied from the former to the latter.
+	 */
+	DanteDisplayList lists[2];
+	/* index of the display list being replayed in 'lists'. */
+	UDint front;
+	/* true if the list being replayed references evicted textures,
+	 * so that the next list is recorded without reusing it.
+	 */
+	UDboolean stale;
+	/* fences of the last frames replaying each display list, a list
+	 * is recorded again only once its frame completed.
+	 */
+	Uint32 fences[2];
+	/* render queue owning the window renderer, every renderer call
+	 * is issued through it.
+	 */
+	struct DanteRenderQueue_s* queue;
+	/* depth of the object being recorded. */
+	UDint depth;
+	/* color used by subsequently recorded fill commands. */
+	SDL_Color color;
 } DanteWindowObject;
 
 /* Event object type. */
@@ -231,10 +529,271 @@ typedef struct DanteEventObject_s {
 	struct DanteObject_s* from;
 	/* dante receiver object. */
 	struct DanteObject_s* to;
-	/* original SDL event. */
-	SDL_Event sev;
+	/* original SDL event, referenced in place by the event loop,
+	 * it is only valid while the event is being dispatched.
+	 * NULL for application generated events.
+	 */
+	const SDL_Event* sev;
 } DanteEventObject;
 
+/* Identity of an image file, unchanged files keep their identity,
+ * so that their mappings hold the same pixels.
+ */
+typedef struct DanteFileID_s {
+	Uint64 dev;
+	Uint64 ino;
+	Sint64 mtime;
+	/* file size, in bytes, 0 if the identity is unknown. */
+	Uint64 size;
+} DanteFileID;
+
+/* Reference counted pixel buffer, holding pixmap pixels.
+ * Shared buffers are listed in the context hash table by content,
+ * or by file identity if mapped from a file, so that identical pixels
+ * are stored once, and must not be modified, private ones belong to
+ * a single pixmap.
+ */
+typedef struct DantePixels_s {
+	/* pixels, in DANTE_PIXMAP_FORMAT format. */
+	SDL_Surface* surface;
+	/* number of pixmaps using the buffer. */
+	UDint refs;
+	/* true if the buffer is listed in the context hash table. */
+	UDboolean shared;
+	/* content hash, or file identity hash, for shared buffers. */
+	Uint32 hash;
+	/* next shared buffer in the same hash bucket. */
+	struct DantePixels_s* next;
+	/* mapped image file holding the pixels, if any. */
+	const void* mapping;
+	/* size of 'mapping', in bytes. */
+	size_t mapped;
+	/* identity of the file at 'mapping', for shared buffers. */
+	DanteFileID id;
+} DantePixels;
+
+/* Decoded image, not yet wrapped in a pixel buffer. */
+typedef struct DanteImage_s {
+	/* pixels, in DANTE_PIXMAP_FORMAT format. */
+	SDL_Surface* surface;
+	/* mapped image file holding the pixels, if any. */
+	const void* mapping;
+	/* size of 'mapping', in bytes. */
+	size_t mapped;
+	/* identity of the file at 'mapping', if any and known. */
+	DanteFileID id;
+	/* content hash of 'surface', computed by the decoding thread
+	 * unless the identity of its file is known.
+	 */
+	Uint32 hash;
+} DanteImage;
+
+/* Job run by a worker thread when no parallel task is pending. */
+typedef struct DanteBackgroundJob_s {
+	/* job procedure. */
+	void (*run)(struct DanteBackgroundJob_s* job);
+	/* next queued job. */
+	struct DanteBackgroundJob_s* next;
+} DanteBackgroundJob;
+
+/* Progress of a streamed image decode, rows are decoded top to
+ * bottom in bands, straight into the pixels of the pixmap.
+ */
+typedef struct DanteStream_s {
+	/* private buffer receiving the pixels, set by the worker thread
+	 * before the first band, NULL if the format can't be streamed.
+	 * The load holds a reference until completed.
+	 */
+	DantePixels* buffer;
+	/* rows decoded so far, published by the worker thread. */
+	SDL_atomic_t rows;
+	/* rows already uploaded, only used by the event loop. */
+	int shown;
+} DanteStream;
+
+/* Image file mapped in memory. */
+typedef struct DanteImageFile_s {
+	/* file contents. */
+	const Uint8* data;
+	/* file size, in bytes. */
+	size_t length;
+	/* file identity, if known. */
+	DanteFileID id;
+} DanteImageFile;
+
+/* Image file format decoder. */
+typedef struct DanteDecoder_s {
+	/* format name, as reported by udeskQueryFileFormatEXT(). */
+	const char* name;
+	/* returns true if 'file', named 'name', holds an image of this format. */
+	UDboolean (*sniff)(const DanteImageFile* file, const char* name);
+	/* decodes 'file' into 'dst', releasing 'file' with danteUnmapFile()
+	 * unless referenced by the image, in bands into 'stream' unless
+	 * NULL, if supported.
+	 */
+	UDenum (*decode)(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+} DanteDecoder;
+
+/* Asynchronous image file load, decoded by a worker thread and
+ * completed by the event loop.
+ */
+typedef struct DanteDecode_s {
+	/* background job, the first member. */
+	DanteBackgroundJob job;
+	/* pixmap waiting for the image, NULL if the load was cancelled. */
+	struct DanteObject_s* pixmap;
+	/* image file name, stored past the structure. */
+	const char* name;
+	/* decoded image and load error, set by the worker thread. */
+	DanteImage image;
+	UDenum error;
+	/* decode time, in performance counter units. */
+	Uint64 time;
+	/* SDL ticks of the decode completion. */
+	Uint32 stamp;
+	/* set by the worker thread once 'image' and 'error' are set. */
+	SDL_atomic_t done;
+	/* true if rows are shown as soon as they are decoded. */
+	UDboolean progressive;
+	/* band progress, for progressive loads. */
+	DanteStream stream;
+	/* next outstanding load. */
+	struct DanteDecode_s* next;
+} DanteDecode;
+
+/* Texture uploaded from pixmap or scaled pixels for a window renderer,
+ * entries are linked both to their owner and to the context LRU list,
+ * most recently used first.
+ */
+typedef struct DanteTexture_s {
+	/* uploaded texture, owned by the renderer of 'win'. */
+	SDL_Texture* tex;
+	/* pixels the texture was uploaded from. */
+	SDL_Surface* pixels;
+	/* tile of 'pixels' held by the texture. */
+	SDL_Rect area;
+	/* texture list of the owner of 'pixels'. */
+	struct DanteTexture_s** owner;
+	/* window whose renderer owns 'tex'. */
+	struct DanteObject_s* win;
+	/* texture size, in bytes. */
+	Uint32 bytes;
+	/* next texture, or tile, of the same pixmap. */
+	struct DanteTexture_s* next;
+	/* LRU list links. */
+	struct DanteTexture_s* lru_prev;
+	struct DanteTexture_s* lru_next;
+} DanteTexture;
+
+/* Pixmap object data type. */
+typedef struct DantePixmapObject_s {
+	/* pixel buffer, NULL if no image was specified yet. */
+	DantePixels* buffer;
+	/* surface of 'buffer', NULL if none. */
+	SDL_Surface* pixels;
+	/* pixmap target, UDESK_PIXMAP_IMAGE or UDESK_PIXMAP_ICON. */
+	UDenum target;
+	/* pixmap usage hint, any of the UDESK_PIXMAP_USAGE values. */
+	UDenum usage;
+	/* texture tiles uploaded from 'pixels', for each window renderer. */
+	DanteTexture* textures;
+	/* atlas holding a copy of 'pixels', NULL if not packed. */
+	struct DanteAtlas_s* atlas;
+	/* area of the atlas holding the copy. */
+	SDL_Rect atlas_rect;
+	/* next pixmap packed in the same atlas. */
+	struct DanteObject_s* atlas_next;
+	/* pending asynchronous load, NULL if none. */
+	DanteDecode* loading;
+	/* user defined asynchronous load completion handler, might be NULL. */
+	UDhandlerproc loaded;
+	/* user defined streamed load progress handler, might be NULL. */
+	UDhandlerproc progress;
+	/* layers referencing the pixmap, redrawn when its pixels change. */
+	struct DanteObject_s* layers;
+} DantePixmapObject;
+
+/* Maximum number of shelves of an atlas. */
+#define DANTE_ATLAS_SHELVES 64
+
+/* Atlas shelf, a row of pixmaps as tall as the shelf at most. */
+typedef struct DanteShelf_s {
+	/* shelf top and height. */
+	int y;
+	int h;
+	/* used shelf width. */
+	int x;
+} DanteShelf;
+
+/* Texture atlas, packing small pixmaps into the pixels of an
+ * internal pixmap, so that they share a single texture for each
+ * window renderer.
+ */
+typedef struct DanteAtlas_s {
+	/* internal pixmap holding the packed pixels, owned by the atlas,
+	 * allocated outside of the object slices, it has no handle.
+	 */
+	struct DanteObject_s* pixmap;
+	/* shelves, from top to bottom. */
+	DanteShelf shelves[DANTE_ATLAS_SHELVES];
+	UDint num_shelves;
+	/* atlas area given to pixmaps so far, including areas freed
+	 * by pixmaps removed since the atlas was last compacted.
+	 */
+	Uint32 allocated;
+	/* atlas area used by packed pixmaps. */
+	Uint32 used;
+	/* packed pixmaps. */
+	struct DanteObject_s* members;
+	/* next context atlas. */
+	struct DanteAtlas_s* next;
+} DanteAtlas;
+
+/* Scaled pixels, shared by every layer scaling the same pixel
+ * buffer to the same size with the same filter.
+ * Entries in use are only linked to the context hash table, unused
+ * ones are also linked to the context LRU list, most recently used
+ * first, and evicted beyond the budget.
+ */
+typedef struct DanteScaled_s {
+	/* scaled pixels, in DANTE_PIXMAP_FORMAT format. */
+	SDL_Surface* pixels;
+	/* source pixel buffer, NULL once it is freed or modified. */
+	DantePixels* source;
+	/* UDESK_LAYER_FILTER_HINT value used. */
+	UDenum filter;
+	/* size of 'pixels', in bytes. */
+	Uint32 bytes;
+	/* number of layers using the entry. */
+	UDint refs;
+	/* texture tiles uploaded from 'pixels', for each window renderer. */
+	DanteTexture* textures;
+	/* next entry in the same hash bucket. */
+	struct DanteScaled_s* next;
+	/* LRU list links, for unused entries. */
+	struct DanteScaled_s* lru_prev;
+	struct DanteScaled_s* lru_next;
+} DanteScaled;
+
+/* Layer object data type. */
+typedef struct DanteLayerObject_s {
+	/* referenced pixmap, NULL if none. */
+	struct DanteObject_s* pixmap;
+	/* scaled pixels in use, NULL if the layer isn't scaled or
+	 * wasn't scaled yet.
+	 */
+	DanteScaled* scaled;
+	/* requested size, 0 if the layer isn't scaled. */
+	UDint width;
+	UDint height;
+	/* true if the pixmap aspect ratio is kept while scaling. */
+	UDboolean keep_aspect;
+	/* UDESK_LAYER_FILTER_HINT value. */
+	UDenum filter;
+	/* next layer referencing the same pixmap. */
+	struct DanteObject_s* layer_next;
+} DanteLayerObject;
+
 /* Generic object type, it holds any information necessary to
  * identify and manage a generic object, as well as any object
  * specific data.
@@ -256,6 +815,22 @@ typedef struct DanteObject_s {
 	const DanteEventDispatch* dispatch;
 	/* object parent, NULL if this is a root object */
 	struct DanteObject_s* parent;
+	/* object area, relative to the window containing it, as assigned
+	 * by its parent layout, empty if the object isn't laid out.
+	 */
+	SDL_Rect area;
+	/* entry of this object inside the window spatial index,
+	 * -1 if the object isn't indexed.
+	 */
+	UDint slot;
+	/* range of this object inside the window display list, -1 if
+	 * the object wasn't recorded.
+	 */
+	UDint range;
+	/* true if the object (or any of its descendants) must record its
+	 * display list range again.
+	 */
+	UDboolean dirty;
 	/* object specific data. */
 	union {
 		/* If the object is free, this field is used to
@@ -267,6 +842,10 @@ typedef struct DanteObject_s {
 		DanteWindowObject win;
 		/* UDESK_HANDLE_EVENT event object data. */
 		DanteEventObject ev;
+		/* UDESK_HANDLE_PIXMAP pixmap object data. */
+		DantePixmapObject pix;
+		/* UDESK_HANDLE_LAYER layer object data. */
+		DanteLayerObject layer;
 		/* TODO implement other objects. */
 	} d;
 } DanteObject;
@@ -311,10 +890,177 @@ typedef struct DanteSlice_s {
  */
 #define DANTE_SLICE_SIZE (offsetof(DanteSlice, data[0]) + DANTE_SLICE_CACHESIZE * sizeof(DanteObject))
 
+/* First keycode used for keys that have no udesk keycode,
+ * such keys are reported as DANTE_KEYCODE_BASE + SDL scancode.
+ */
+#define DANTE_KEYCODE_BASE (UDESK_KEYCODE_F16 + 1)
+/* Number of keycodes tracked by the context key state. */
+#define DANTE_KEYCODE_COUNT (DANTE_KEYCODE_BASE + SDL_NUM_SCANCODES)
+/* Size of the key state bitset, in 32 bits words. */
+#define DANTE_KEYSTATE_WORDS ((DANTE_KEYCODE_COUNT + 31) / 32)
+
 /* Defines how many slots should be reserved for fast static
  * objects cache.
  */
 #define DANTE_FAST_CACHESIZE 128
+/* Number of fast cache slots reserved to the event ring, used for
+ * system generated events, must be lower than DANTE_FAST_CACHESIZE.
+ */
+#define DANTE_EVENT_RING 16
+/* Maximum number of SDL events drained from the queue on each
+ * event loop iteration.
+ */
+#define DANTE_EVENT_BATCH 64
+
+/* Number of render jobs a queue can hold, submitting further jobs
+ * waits for the oldest one to complete.
+ */
+#define DANTE_RENDER_JOBS 64
+/* Number of render queues, windows are spread over them so that
+ * their frames may be presented concurrently.
+ */
+#define DANTE_RENDER_QUEUES 4
+/* Number of windows kept by the window pool, when enabled. */
+#define DANTE_WINDOW_POOL 4
+/* Maximum number of registered image file decoders. */
+#define DANTE_MAX_DECODERS 32
+/* Largest texture tile side, pixels are uploaded in tiles so that
+ * huge images never need a texture past the renderer limits, nor
+ * upload areas never drawn.
+ */
+#define DANTE_TEXTURE_TILE 2048
+/* Default texture cache budget, in bytes. */
+#define DANTE_TEXTURE_BUDGET (64 * 1024 * 1024)
+/* Default budget for unused scaled pixels, in bytes. */
+#define DANTE_SCALED_BUDGET (16 * 1024 * 1024)
+/* Number of buckets of the shared pixel buffers hash table, a power of 2. */
+#define DANTE_PIXELS_BUCKETS 256
+/* Number of buckets of the scaled pixels hash table, a power of 2. */
+#define DANTE_SCALED_BUCKETS 64
+/* Atlas width and height. */
+#define DANTE_ATLAS_SIZE 1024
+/* Pixmaps whose width or height exceeds this aren't packed. */
+#define DANTE_ATLAS_MAX_PIXMAP 128
+/* Largest accepted image, layer or scaled pixels width or height. */
+#define DANTE_IMAGE_MAX 32768
+/* Pixmap pixel format, pixels are stored with premultiplied alpha. */
+#define DANTE_PIXMAP_FORMAT SDL_PIXELFORMAT_BGRA32
+
+struct DanteRenderJob_s;
+
+/* Render job procedure. */
+typedef void (*DanteJobproc)(struct DanteRenderJob_s* job);
+
+/* Render job, a unit of work run by a render queue. */
+typedef struct DanteRenderJob_s {
+	/* job procedure. */
+	DanteJobproc run;
+	/* object the job operates on. */
+	DanteObject* obj;
+	/* job specific argument. */
+	void* arg;
+	/* frame jobs, display list to replay. */
+	UDint list;
+	/* frame jobs, damage to replay, snapshotted at submission. */
+	DanteDamage damage;
+	/* frame jobs, SDL window identifier to notify on completion,
+	 * 0 if no completion event should be sent.
+	 */
+	Uint32 notify;
+	/* job fence, assigned on submission from the context sequence. */
+	Uint32 fence;
+} DanteRenderJob;
+
+/* Render queue, runs render jobs in submission order, either on
+ * a dedicated thread or immediately on submission.
+ * Each job is identified by a fence, a sequence number that may be
+ * waited for, fences are compared modulo 2^32.
+ */
+typedef struct DanteRenderQueue_s {
+	/* render thread, NULL if jobs run on submission. */
+	SDL_Thread* thread;
+	/* protects the fields below when a thread is running. */
+	SDL_mutex* lock;
+	/* signaled when jobs are submitted or the thread should quit. */
+	SDL_cond* wake;
+	/* signaled when a job completes. */
+	SDL_cond* done;
+	/* jobs ring, the n-th submitted job is stored at 'n % DANTE_RENDER_JOBS'. */
+	DanteRenderJob jobs[DANTE_RENDER_JOBS];
+	/* number of submitted jobs. */
+	Uint32 submitted;
+	/* number of completed jobs. */
+	Uint32 completed;
+	/* true if the thread should quit once every job completed. */
+	UDboolean quit;
+} DanteRenderQueue;
+
+/* Maximum number of threads running parallel tasks, besides
+ * the calling thread.
+ */
+#define DANTE_WORKER_THREADS 7
+
+/* Parallel task procedure, runs task 'index' of 'data'. */
+typedef void (*DanteTaskproc)(void* data, UDint index);
+
+/* Worker threads running the tasks of a danteRunTasks() call,
+ * started on first use.
+ */
+typedef struct DanteWorkers_s {
+	/* worker threads, 'num_threads' of them. */
+	SDL_Thread* threads[DANTE_WORKER_THREADS];
+	UDint num_threads;
+	/* true once starting threads was attempted. */
+	UDboolean started;
+	/* lock protecting the fields below. */
+	SDL_mutex* lock;
+	/* signaled when tasks are posted or on quit. */
+	SDL_cond* wake;
+	/* signaled when the last task completes. */
+	SDL_cond* done;
+	/* task procedure and data of the current call. */
+	DanteTaskproc run;
+	void* data;
+	/* next task to be taken, task count and completed tasks. */
+	UDint next;
+	UDint count;
+	UDint finished;
+	/* calls that started tasks so far, a new call only starts once
+	 * every task of the previous one completed.
+	 */
+	Uint32 generation;
+	/* background jobs, oldest first, taken once no task is left. */
+	DanteBackgroundJob* jobs;
+	DanteBackgroundJob* last_job;
+	/* true if threads should quit. */
+	UDboolean quit;
+} DanteWorkers;
+
+/* Window created in advance by the window pool, along with its
+ * renderer, owned by the 'queue' render queue.
+ */
+typedef struct DantePooledWindow_s {
+	SDL_Window* swin;
+	SDL_Renderer* render;
+	SDL_Point tile;
+	SDL_Surface* surface;
+	DanteRenderQueue* queue;
+} DantePooledWindow;
+
+/* Running event loop, events are removed from the SDL queue in
+ * batches and dispatched in place. Loops nested by handlers have
+ * their own batch, dispatching the events left in the enclosing
+ * batches first.
+ */
+typedef struct DanteEventLoop_s {
+	SDL_Event batch[DANTE_EVENT_BATCH];
+	/* next event to be dispatched. */
+	int next;
+	/* number of events in 'batch'. */
+	int num;
+	/* enclosing event loop, NULL if this is the outermost one. */
+	struct DanteEventLoop_s* outer;
+} DanteEventLoop;
 
 /* DanteContext defines the context type. According to udesk,
  * this type manages every object allocated with udeskGenObjects(),
@@ -337,20 +1083,126 @@ typedef struct DanteContext_s {
 	 * true.
 	 */
 	UDboolean accelerated;
+	/* true if expensive object teardown should be deferred, on context
+	 * creation this field is set accordingly to the DANTE_ENV_DEFERRED
+	 * environment variable, by default it is false.
+	 */
+	UDboolean deferred;
+	/* true if running without a display, on context creation this field
+	 * is set accordingly to the DANTE_ENV_HEADLESS environment variable,
+	 * by default it is false.
+	 */
+	UDboolean headless;
+	/* render queues, on context creation each one is given a thread
+	 * accordingly to the DANTE_ENV_RENDER_THREAD environment variable,
+	 * if the video driver allows it, by default jobs run on submission.
+	 */
+	DanteRenderQueue render[DANTE_RENDER_QUEUES];
+	/* render queue to be assigned to the next window. */
+	UDint next_queue;
+	/* last fence handed out by any render queue, fences are
+	 * ordered across queues.
+	 */
+	Uint32 fence;
+	/* renderer driver index and flags found by the first successful
+	 * renderer creation, packed by danteCreateWindowRenderer(),
+	 * 0 until then, render threads may update it concurrently.
+	 */
+	SDL_atomic_t probe;
+	/* texture cache LRU list sentinel, textures are evicted from
+	 * its tail.
+	 */
+	DanteTexture textures;
+	/* texture cache budget, in bytes, textures beyond it are evicted
+	 * before the next window is drawn.
+	 */
+	Uint32 texture_budget;
+	/* bytes of textures currently resident. */
+	Uint32 texture_bytes;
+	/* texture cache lookups satisfied without uploading. */
+	Uint32 texture_hits;
+	/* texture cache lookups that needed uploading. */
+	Uint32 texture_misses;
+	/* threads running parallel tasks, like image scaling. */
+	DanteWorkers workers;
+	/* shared pixel buffers, by content. */
+	DantePixels* buffers[DANTE_PIXELS_BUCKETS];
+	/* scaled pixels shared by layers, by source and size. */
+	DanteScaled* scaled[DANTE_SCALED_BUCKETS];
+	/* unused scaled pixels LRU list sentinel. */
+	DanteScaled scaled_lru;
+	/* budget for unused scaled pixels, in bytes. */
+	Uint32 scaled_budget;
+	/* bytes of every scaled pixels entry, used or not. */
+	Uint32 scaled_bytes;
+	/* atlases packing small pixmaps. */
+	DanteAtlas* atlases;
+	/* windows created in advance, the last ones are handed out first. */
+	DantePooledWindow pool[DANTE_WINDOW_POOL];
+	/* number of windows in 'pool'. */
+	UDint num_pooled;
+	/* number of windows 'pool' is refilled to, 0 if the pool is
+	 * disabled, on context creation this field is set accordingly
+	 * to the DANTE_ENV_POOL environment variable, by default it is
+	 * disabled.
+	 */
+	UDint pool_size;
+	/* SDL event type pushed by frame jobs on completion, as
+	 * allocated by SDL_RegisterEvents(), (Uint32)-1 if unavailable.
+	 */
+	Uint32 flush_event;
+	/* SDL event type pushed by worker threads once an asynchronous
+	 * image load is decoded, (Uint32)-1 if unavailable.
+	 */
+	Uint32 decode_event;
+	/* outstanding asynchronous image loads, most recent first. */
+	DanteDecode* decodes;
+	/* number of 'decodes', decoded or not. */
+	UDint num_decodes;
+	/* time spent decoding completed loads, in performance counter units. */
+	Uint64 decode_time;
+	/* number of completed loads. */
+	UDint decoded;
+	/* pixels drawn by layers in place of loading pixmaps, NULL
+	 * until first needed.
+	 */
+	DantePixels* placeholder;
+	/* objects waiting for their deferred clear(), already invalidated,
+	 * they keep their memory slot until collected.
+	 */
+	DanteObject** doomed;
+	/* first object in 'doomed' not yet collected. */
+	UDint doomed_first;
+	/* number of objects in 'doomed'. */
+	UDint num_doomed;
+	/* allocated 'doomed' entries. */
+	UDint doomed_capacity;
 	/* currently handled event, NULL if no udesk
 	 * event is being handled.
 	 */
 	DanteObject* ev;
+	/* active modifiers, as UDESK_MODIFIER_*_EXT bits. */
+	UDint modifiers;
+	/* key and button state snapshot, indexed by udesk keycode,
+	 * a set bit means the key or button is currently down.
+	 */
+	Uint32 keys[DANTE_KEYSTATE_WORDS];
 	/* Free static object cache list, if empty even frequently generated
 	 * object will fall back to slice memory.
 	 */
 	DanteObject* cache_free;
+	/* next event ring slot to be used. */
+	UDint ring_next;
+	/* innermost running event loop, NULL if none. */
+	DanteEventLoop* loop;
 	/* slices managed by this context. */
 	DanteSlice slice;
 	/* This is the fast static cache buffer used for frequently
 	 * generated and deleted objects, such as events.
 	 * Handles are managed in the following way:
 	 * 
+	 * [1, DANTE_EVENT_RING] = event ring, system events only, never
+	 *                         in the free list
 	 * [1, DANTE_FAST_CACHESIZE] = static objects, have NULL slice field
 	 * [DANTE_FAST_CACHESIZE, ...] = slice memory allocation.
 	 */
@@ -436,15 +1288,50 @@ DANTEAPI DanteObject* DANTEAPIENTRY danteRefObject(DanteObject* obj);
  */
 DANTEAPI void DANTEAPIENTRY danteUnrefObject(DanteObject* obj);
 
+/* Runs the deferred teardown of the objects queued for destruction,
+ * stopping once 'budget' milliseconds have elapsed, at least one
+ * object is collected on each call. If 'budget' is 0, every queued
+ * object is collected.
+ * It returns true if queued objects remain.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteCollectObjects(Uint32 budget);
+
+/* Handles a frame completion event pushed by a render queue,
+ * sending an UDESK_EVENT_FLUSH_EXT event to its window.
+ */
+DANTEAPI void DANTEAPIENTRY danteHandleFlushEvent(const SDL_Event* ev);
+/* Completes every decoded asynchronous image load, on a decode
+ * completion event, sending an UDESK_EVENT_LOAD_EXT event to each
+ * pixmap still waiting for its image. Rows decoded meanwhile by
+ * progressive loads are uploaded, sending UDESK_EVENT_PROGRESS_EXT.
+ */
+DANTEAPI void DANTEAPIENTRY danteHandleDecodeEvent(void);
 /* Handles the specified SDL window event.
  * The SDL 'ev' type must be SDL_WINDOWEVENT, if 'ev' is NULL effects are
  * undefined.
  */
 DANTEAPI void DANTEAPIENTRY danteHandleWindowEvent(const SDL_Event* ev);
+/* Handles the specified SDL keyboard, mouse button, mouse motion or
+ * touch event, updating the context input state and dispatching it
+ * to the window it belongs to. Other SDL event types are ignored.
+ */
+DANTEAPI void DANTEAPIENTRY danteHandleInputEvent(const SDL_Event* ev);
+/* Translates a SDL scancode to the udesk keycode reported to
+ * the application.
+ */
+DANTEAPI UDint DANTEAPIENTRY danteTranslateScancode(SDL_Scancode code);
+/* Translates a SDL mouse button index to an udesk button code,
+ * UDESK_KEYCODE_NONE is returned for buttons without a udesk code.
+ */
+DANTEAPI UDint DANTEAPIENTRY danteTranslateButton(Uint8 button);
+/* Translates a SDL modifier mask to UDESK_MODIFIER_*_EXT bits. */
+DANTEAPI UDint DANTEAPIENTRY danteTranslateModifiers(Uint16 mod);
 /* Generates a dante event from an existing SDL event of the udesk type 'type'.
  * The SDL event must not be NULL and the type must be correct, such
  * requirements must be met by the caller.
- * SDL event data is copied into the new event.
+ * SDL event data is referenced, not copied, the SDL event must outlive
+ * the generated event, the event itself is taken from the context
+ * event ring whenever possible.
  * The newly allocated event becomes the current context event, subsequent
  * current event related functions will implicitly reference it, if
  * the event allocation failed, the current event is set to NULL and
@@ -463,6 +1350,194 @@ DANTEAPI void DANTEAPIENTRY dantePropagateEvent(DanteDispatchID id, DanteObject*
  * context event to NULL.
  */
 DANTEAPI void DANTEAPIENTRY danteFinishEvent(void);
+/* Initializes an UDESK_HANDLE_PIXMAP object and
+ * registers its virtual table.
+ * It returns true on success, false otherwise,
+ * a context error is set appropriately on failure.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY dantePixmapInit(DanteObject* obj);
+/* Records a copy of the 'src' area of the pixmap 'pixmap' into the
+ * display list of the window 'win', scaled to 'dst', nothing is drawn
+ * if the pixmap has no pixels.
+ * A context error is set if its textures can't be uploaded.
+ * Only call while recording the display list of 'win'.
+ */
+DANTEAPI void DANTEAPIENTRY dantePixmapCopy(DanteObject* pixmap, DanteObject* win, const SDL_Rect* src, const SDL_Rect* dst);
+/* Records a copy of the 'src' area of 'pixels' into the display list
+ * of the window 'win', scaled to 'dst', one texture tile at a time.
+ * Tiles are linked to the 'owner' texture list, those not under 'src'
+ * aren't uploaded.
+ * Only the first 'rows' rows of 'pixels' are read, the others are left
+ * transparent, to be uploaded with dantePixmapUpdate().
+ * A context error is set if a tile can't be uploaded.
+ * Only call while recording the display list of 'win'.
+ */
+DANTEAPI void DANTEAPIENTRY danteDrawTiles(DanteObject* win, DanteTexture** owner, SDL_Surface* pixels, int rows, const SDL_Rect* src, const SDL_Rect* dst);
+/* Evicts every texture linked to the 'owner' texture list. */
+DANTEAPI void DANTEAPIENTRY danteEvictTextures(DanteTexture** owner);
+/* Records a copy of the pixmap 'pixmap' into the display list of the
+ * window 'win', at the top left corner of 'area' and cropped to it,
+ * as dantePixmapCopy() does.
+ * Only call while recording the display list of 'win'.
+ */
+DANTEAPI void DANTEAPIENTRY dantePixmapDraw(DanteObject* pixmap, DanteObject* win, const SDL_Rect* area);
+/* Replaces the pixels of the pixmap 'obj' with 'surface', evicting
+ * every texture uploaded from the previous ones, 'obj' takes
+ * ownership of 'surface'.
+ * If 'share' is true, the pixels are shared with any pixmap holding
+ * identical ones, the pixmap is left with no pixels and false is
+ * returned if out of memory.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY dantePixmapReplace(DanteObject* obj, SDL_Surface* surface, UDboolean share);
+/* Replaces the pixels of the pixmap 'obj' with 'buffer', like
+ * dantePixmapReplace(), 'obj' takes over the reference of the caller.
+ */
+DANTEAPI void DANTEAPIENTRY dantePixmapAttach(DanteObject* obj, DantePixels* buffer);
+/* Redraws every layer referencing the pixmap 'obj'. */
+DANTEAPI void DANTEAPIENTRY danteInvalidateLayers(DanteObject* obj);
+/* Returns the pixels of the pixmap 'obj' for modification, copying
+ * them first if other pixmaps or loads use them or if they are mapped
+ * from a file, NULL if it has no pixels or if out of memory.
+ * Call dantePixmapUpdate() once done.
+ */
+DANTEAPI SDL_Surface* DANTEAPIENTRY dantePixmapWritable(DanteObject* obj);
+/* Wraps 'surface' in a pixel buffer, taking ownership of it.
+ * If 'share' is true, an existing shared buffer holding the same
+ * pixels is referenced instead, and 'surface' is freed.
+ * It returns NULL if out of memory, 'surface' is freed anyway.
+ */
+DANTEAPI DantePixels* DANTEAPIENTRY danteSharePixels(SDL_Surface* surface, UDboolean share);
+/* Like danteSharePixels() with 'share' set, given the content hash
+ * 'hash' of 'surface', as computed by danteHashPixels().
+ */
+DANTEAPI DantePixels* DANTEAPIENTRY danteShareHashed(SDL_Surface* surface, Uint32 hash);
+/* Like danteShareHashed(), for the 'surface' pixels held by the
+ * 'mapped' bytes 'mapping' of the file identified by 'id', buffers are
+ * matched by file identity instead of content.
+ * The buffer takes over 'mapping', which is released if an existing
+ * buffer is referenced instead, or on failure.
+ */
+DANTEAPI DantePixels* DANTEAPIENTRY danteShareMapped(SDL_Surface* surface, const void* mapping, size_t mapped, const DanteFileID* id);
+/* Returns the content hash of 'surface' pixels, it is thread safe. */
+DANTEAPI Uint32 DANTEAPIENTRY danteHashPixels(const SDL_Surface* surface);
+/* Drops a reference to 'buffer', freeing it once unused. */
+DANTEAPI void DANTEAPIENTRY danteReleasePixels(DantePixels* buffer);
+/* Loads the image file 'name' into a shared pixel buffer, stored in
+ * 'dst', the pixels may reference the file mapping directly.
+ * It returns UDESK_OPERATION_FAILED if the file can't be read or has
+ * an unsupported format, UDESK_OUT_OF_MEMORY if out of memory.
+ */
+DANTEAPI UDenum DANTEAPIENTRY danteLoadImage(const char* name, DantePixels** dst);
+/* Decodes the image file 'name' into 'dst', like danteLoadImage(),
+ * without sharing the pixels, it may be called by any thread.
+ * If 'stream' isn't NULL, formats decoded natively are decoded in
+ * bands into 'stream', which then owns the pixels of 'dst'.
+ */
+DANTEAPI UDenum DANTEAPIENTRY danteDecodeImage(const char* name, DanteImage* dst, DanteStream* stream);
+/* Wraps the decoded 'image' into a shared pixel buffer, stored in
+ * 'dst', looked up by the 'image' hash, which must be set first.
+ * 'image' is consumed in any case.
+ * It returns UDESK_OUT_OF_MEMORY if out of memory.
+ */
+DANTEAPI UDenum DANTEAPIENTRY danteShareImage(DanteImage* image, DantePixels** dst);
+/* Frees a decoded image not wrapped in a pixel buffer. */
+DANTEAPI void DANTEAPIENTRY danteDiscardImage(DanteImage* image);
+/* Queues the asynchronous load of the image file 'name' into the
+ * pixmap 'obj', which is left with no pixels until completion, or
+ * until the first band is decoded if 'progressive' is true.
+ * It returns false if out of memory.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteLoadImageAsync(DanteObject* obj, const char* name, UDboolean progressive);
+/* Frees every outstanding asynchronous load, worker threads must be
+ * stopped already.
+ */
+DANTEAPI void DANTEAPIENTRY danteDestroyDecodes(void);
+/* Releases an image file mapping, as stored in a pixel buffer. */
+DANTEAPI void DANTEAPIENTRY danteUnmapFile(const void* data, size_t length);
+/* Initializes and releases the external image decoders, if any,
+ * initialization registers the built in ones anew.
+ */
+DANTEAPI void DANTEAPIENTRY danteInitImage(void);
+DANTEAPI void DANTEAPIENTRY danteQuitImage(void);
+/* Registers the image file format 'decoder', which must stay valid
+ * until the context is destroyed, its format is sniffed before those
+ * registered earlier, so it can take over any of them.
+ * Only call while no load is pending, it returns false if
+ * DANTE_MAX_DECODERS decoders are registered already.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteRegisterDecoder(const DanteDecoder* decoder);
+/* Returns the number of image file formats recognized by
+ * danteDecodeImage().
+ */
+DANTEAPI UDint DANTEAPIENTRY danteNumDecoders(void);
+/* Uploads the 'rect' area of the pixels of 'obj' to every texture
+ * cached for it, after they were modified in place.
+ */
+DANTEAPI void DANTEAPIENTRY dantePixmapUpdate(DanteObject* obj, const SDL_Rect* rect);
+/* Packs the pixmap 'obj' into an atlas, if small enough and its usage
+ * hint is for menus, small toolbars or small icons.
+ * Failing to pack is not an error, the pixmap is drawn from its own
+ * textures instead.
+ */
+DANTEAPI void DANTEAPIENTRY danteAtlasAdd(DanteObject* obj);
+/* Removes the pixmap 'obj' from its atlas, freeing the atlas if it
+ * is left empty.
+ */
+DANTEAPI void DANTEAPIENTRY danteAtlasRemove(DanteObject* obj);
+/* Frees every atlas, the pixmaps they packed aren't packed anymore. */
+DANTEAPI void DANTEAPIENTRY danteDestroyAtlases(void);
+/* Evicts the least recently used textures until the texture cache
+ * fits its budget, windows referencing them are marked stale.
+ * Only call while no display list is being recorded.
+ */
+DANTEAPI void DANTEAPIENTRY danteTrimTextures(void);
+/* Forgets every texture uploaded for the window 'win', without
+ * destroying them, call before its renderer is destroyed.
+ */
+DANTEAPI void DANTEAPIENTRY danteReleaseTextures(DanteObject* win);
+/* Selects the fastest pixel conversion routines supported by the CPU. */
+DANTEAPI void DANTEAPIENTRY danteInitConvert(void);
+/* Selects the conversion routines of the CPU feature 'level', 0 being
+ * the scalar ones and higher levels vectorized ones in order of
+ * preference, returns the level name, or NULL if the level doesn't
+ * exist or isn't supported by the CPU, leaving the selection unchanged.
+ */
+DANTEAPI const char* DANTEAPIENTRY danteSelectConvert(UDint level);
+/* Fills the DANTE_PIXMAP_FORMAT surface 'dst' converting pixels from 'src',
+ * whose rows are 'pitch' bytes apart, 'format' is either UDESK_RGBA
+ * or UDESK_RGB_EXT.
+ */
+DANTEAPI void DANTEAPIENTRY danteConvertPixels(SDL_Surface* dst, const void* src, int pitch, UDenum format);
+/* Converts 'rows' rows of the DANTE_PIXMAP_FORMAT surface 'dst',
+ * starting from row 'y', like danteConvertPixels(), 'src' points to
+ * the first converted row.
+ */
+DANTEAPI void DANTEAPIENTRY danteConvertBand(SDL_Surface* dst, int y, int rows, const void* src, int pitch, UDenum format);
+/* Selects the fastest scaling routines supported by the CPU. */
+DANTEAPI void DANTEAPIENTRY danteInitScale(void);
+/* Scales the DANTE_PIXMAP_FORMAT surface 'src' to fill 'dst', of the
+ * same format, 'filter' is an UDESK_LAYER_FILTER_HINT value.
+ * It returns false if out of memory.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteScaleSurface(SDL_Surface* dst, const SDL_Surface* src, UDenum filter);
+
+/* Initializes an UDESK_HANDLE_LAYER object and
+ * registers its virtual table.
+ * It returns true on success, false otherwise,
+ * a context error is set appropriately on failure.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteLayerInit(DanteObject* obj);
+/* Returns the pixels of the layer 'obj', scaled as requested, scaling
+ * them again if its pixmap changed, NULL if it has no pixels or on
+ * failure. Placeholder pixels are returned while the pixmap is loading,
+ * streamed rows are never read until the load completes.
+ */
+DANTEAPI SDL_Surface* DANTEAPIENTRY danteLayerPixels(DanteObject* obj);
+/* Forgets every scaled pixels entry computed from 'source', unused
+ * ones are freed, the others once no layer uses them.
+ */
+DANTEAPI void DANTEAPIENTRY danteForgetScaled(DantePixels* source);
+
 /* Initializes an UDESK_HANDLE_EVENT object and
  * registers its virtual table.
  * It returns true on success, false otherwise,
@@ -470,6 +1545,139 @@ DANTEAPI void DANTEAPIENTRY danteFinishEvent(void);
  */
 DANTEAPI UDboolean DANTEAPIENTRY danteEventInit(DanteObject* obj);
 
+/* Initializes an empty spatial index covering a 'width' x 'height' area. */
+DANTEAPI void DANTEAPIENTRY danteGridInit(DanteGrid* grid, UDint width, UDint height);
+/* Frees any memory allocated by the spatial index 'grid'. */
+DANTEAPI void DANTEAPIENTRY danteGridClear(DanteGrid* grid);
+/* Changes the area covered by the spatial index, rebuilding it. */
+DANTEAPI void DANTEAPIENTRY danteGridResize(DanteGrid* grid, UDint width, UDint height);
+/* Inserts or updates the object 'obj' into 'grid', with the area
+ * stored into the object, returns false on out of memory condition,
+ * leaving the object unindexed.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteGridUpdate(DanteGrid* grid, DanteObject* obj);
+/* Removes the object 'obj' from 'grid', if 'obj' isn't indexed this
+ * function has no effect.
+ */
+DANTEAPI void DANTEAPIENTRY danteGridRemove(DanteGrid* grid, DanteObject* obj);
+/* Removes every object inside 'grid' having 'root' as ancestor,
+ * 'root' itself included.
+ */
+DANTEAPI void DANTEAPIENTRY danteGridRemoveTree(DanteGrid* grid, DanteObject* root);
+/* Returns the topmost deepest object whose area contains the
+ * point 'x', 'y', NULL if no such object exists.
+ */
+DANTEAPI DanteObject* DANTEAPIENTRY danteGridPick(const DanteGrid* grid, UDint x, UDint y);
+
+/* Adds the rectangle 'rect' to the damage region 'dmg', clipped to
+ * a 'w' x 'h' area.
+ */
+DANTEAPI void DANTEAPIENTRY danteDamageAdd(DanteDamage* dmg, const SDL_Rect* rect, int w, int h);
+/* Damages the areas of the window 'obj' where its last recorded
+ * display list copies the 'rect' area of 'tex', a 'w' x 'h' texture
+ * updated in place, so that its contents are presented again without
+ * recording the list again.
+ */
+DANTEAPI void DANTEAPIENTRY danteDamageTexture(DanteObject* obj, SDL_Texture* tex, const SDL_Rect* rect, int w, int h);
+/* Returns true if 'rect' intersects the damage region 'dmg'. */
+DANTEAPI UDboolean DANTEAPIENTRY danteDamageIntersects(const DanteDamage* dmg, const SDL_Rect* rect);
+/* Marks the area of 'obj' as damaged in the window containing it,
+ * the whole window is damaged if 'obj' is a window, 'obj' and its
+ * ancestors must record their display list ranges again.
+ */
+DANTEAPI void DANTEAPIENTRY danteInvalidateObject(DanteObject* obj);
+/* Frees any memory allocated by the display list 'list'. */
+DANTEAPI void DANTEAPIENTRY danteListClear(DanteDisplayList* list);
+/* Starts recording the display list of the window 'obj', the window
+ * itself opens the root range.
+ */
+DANTEAPI void DANTEAPIENTRY danteListBegin(DanteObject* obj);
+/* Records the range of 'child' into the display list of the window
+ * 'obj', clean objects copy their previous range, dirty ones receive
+ * the current draw event, containers must call this function to draw
+ * their children.
+ */
+DANTEAPI void DANTEAPIENTRY danteDrawObject(DanteObject* obj, DanteObject* child);
+/* Ends recording the display list of the window 'obj', which replaces
+ * the previous one, on out of memory condition both are discarded and
+ * the window stays dirty.
+ * It returns false on out of memory condition.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteListEnd(DanteObject* obj);
+/* Submits a frame for the window 'obj' to its render queue, the
+ * last recorded display list is replayed over the window damage,
+ * which is cleared, then presented, if 'notify' is true a completion
+ * event is pushed once presented.
+ * It returns the frame fence.
+ */
+DANTEAPI Uint32 DANTEAPIENTRY danteRenderFrame(DanteObject* obj, UDboolean notify);
+/* Reads the 'rect' area of the last frame presented by the window
+ * 'obj' into 'dst', as tightly packed SDL_PIXELFORMAT_RGBA32 rows,
+ * waiting for any pending frame.
+ * It returns false if the window has no readable frame.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteRenderReadPixels(DanteObject* obj, const SDL_Rect* rect, void* dst);
+/* Sets the color of the fill commands subsequently recorded into
+ * the display list of the window 'obj'.
+ */
+DANTEAPI void DANTEAPIENTRY danteRenderSetColor(DanteObject* obj, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+/* Records a fill of 'rect' (NULL for the whole window) into the
+ * display list of the window 'obj'.
+ */
+DANTEAPI void DANTEAPIENTRY danteRenderFillRect(DanteObject* obj, const SDL_Rect* rect);
+/* Records a copy of the 'src' area from 'tex' to the 'dst' area of
+ * the window 'obj' (NULL for the whole texture or window) into its
+ * display list.
+ */
+DANTEAPI void DANTEAPIENTRY danteRenderCopy(DanteObject* obj, SDL_Texture* tex, const SDL_Rect* src, const SDL_Rect* dst);
+
+/* Initializes the render queue 'queue', if 'threaded' is true a
+ * render thread is started, falling back to running jobs on
+ * submission if it can't be started.
+ */
+DANTEAPI void DANTEAPIENTRY danteQueueInit(DanteRenderQueue* queue, UDboolean threaded);
+/* Waits for every job of 'queue' and stops its thread. */
+DANTEAPI void DANTEAPIENTRY danteQueueDestroy(DanteRenderQueue* queue);
+/* Returns the job slot to be filled for the next submission to
+ * 'queue', waiting for room if the queue is full.
+ */
+DANTEAPI DanteRenderJob* DANTEAPIENTRY danteQueueAcquire(DanteRenderQueue* queue);
+/* Submits the job returned by the last danteQueueAcquire() call,
+ * it returns the job fence.
+ */
+DANTEAPI Uint32 DANTEAPIENTRY danteQueueSubmit(DanteRenderQueue* queue);
+/* Returns true if every job of 'queue' up to fence 'fence' completed. */
+DANTEAPI UDboolean DANTEAPIENTRY danteQueuePoll(DanteRenderQueue* queue, Uint32 fence);
+/* Waits for every job of 'queue' up to fence 'fence' to complete. */
+DANTEAPI void DANTEAPIENTRY danteQueueWait(DanteRenderQueue* queue, Uint32 fence);
+/* Returns true if every job of every context render queue up to
+ * fence 'fence' completed.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteFencePoll(Uint32 fence);
+/* Waits for every job of every context render queue up to fence
+ * 'fence' to complete, queues run concurrently, so this takes as
+ * long as the slowest of them.
+ */
+DANTEAPI void DANTEAPIENTRY danteFenceWait(Uint32 fence);
+/* Runs 'run' on 'obj' through 'queue' and waits for it to complete,
+ * after every previously submitted job.
+ */
+DANTEAPI void DANTEAPIENTRY danteQueueCall(DanteRenderQueue* queue, DanteJobproc run, DanteObject* obj, void* arg);
+/* Runs 'count' tasks of 'run' on 'data', spread over the context
+ * worker threads and the calling thread, and waits for them.
+ * Tasks must be independent, workers are started on first use.
+ * Any thread may call it, background jobs included, tasks posted
+ * while those of another thread run are run by the calling thread.
+ */
+DANTEAPI void DANTEAPIENTRY danteRunTasks(DanteTaskproc run, void* data, UDint count);
+/* Queues 'job' to be run by a worker thread, once no parallel task
+ * is pending, the job is run immediately if no worker is available.
+ * Jobs left queued when workers are stopped are never run.
+ */
+DANTEAPI void DANTEAPIENTRY danteRunBackground(DanteBackgroundJob* job);
+/* Stops the context worker threads. */
+DANTEAPI void DANTEAPIENTRY danteWorkersDestroy(void);
+
 /* Initializes an UDESK_HANDLE_WINDOW object and
  * registers its virtual table.
  * It returns true on success, false otherwise,
@@ -481,6 +1689,31 @@ DANTEAPI UDboolean DANTEAPIENTRY danteWindowInit(DanteObject* obj);
  * if it doesn't have a dante object attached to it.
  */
 DANTEAPI DanteObject* DANTEAPIENTRY danteGetObjectFromWindowID(Uint32 id);
+/* Returns the window object containing 'obj' (or 'obj' itself if it
+ * is a window), NULL if 'obj' isn't attached to any window.
+ */
+DANTEAPI DanteObject* DANTEAPIENTRY danteGetObjectWindow(DanteObject* obj);
+/* Assigns the window relative area 'area' to 'obj', updating the
+ * spatial index of the window containing it, parent layouts must
+ * call this function whenever a child area changes.
+ * It returns false on out of memory condition.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteLayoutObject(DanteObject* obj, const SDL_Rect* area);
+/* Updates the position and mapping mode cached by the window 'obj'
+ * according to the SDL window event 'wev'.
+ */
+DANTEAPI void DANTEAPIENTRY danteWindowUpdateState(DanteObject* obj, const SDL_WindowEvent* wev);
+/* Notifies the window 'obj' that its size changed to 'w' x 'h',
+ * the window layout and spatial index are updated accordingly.
+ */
+DANTEAPI void DANTEAPIENTRY danteWindowResize(DanteObject* obj, int w, int h);
+/* Creates at most 'budget' windows for the window pool (0 fills it
+ * entirely), it returns true if the pool still isn't full.
+ * If a window can't be created the pool is shrunk to its current size.
+ */
+DANTEAPI UDboolean DANTEAPIENTRY danteFillWindowPool(UDint budget);
+/* Destroys every window left in the window pool. */
+DANTEAPI void DANTEAPIENTRY danteDrainWindowPool(void);
 
 #ifdef __cplusplus
 }
@@ -32,9 +32,14 @@
 
 /* Extracts an udesk timestamp from an SDL event, since SDL
  * doesn't provide a timestamp into the common event structure,
- * this is done with a switch.
+ * this is done with a switch. A NULL event has a zero timestamp.
  */
 static UDint danteGetEventTimestamp(const SDL_Event* ev);
+/* Retrieves the window relative pointer position of an input event,
+ * in pixels, returning false if the event carries no position
+ * (or if 'ev' is NULL).
+ */
+static UDboolean danteGetEventPosition(const SDL_Event* ev, UDfloat* x, UDfloat* y);
 /* Event virtual table handlers. */
 static void danteEventBegin(DanteObject* self, UDenum type);
 static void danteEventEnd(DanteObject* obj);
@@ -45,6 +50,11 @@ static UDint danteGetEventTimestamp(const SDL_Event* ev)
 {
 	Uint32 stamp;
 	
+	if (!ev) {
+		/* application generated event */
+		return 0;
+	}
+	
 	switch (ev->type) {
 	case SDL_QUIT:
 		stamp = ev->quit.timestamp;
@@ -150,6 +160,55 @@ static UDint danteGetEventTimestamp(const SDL_Event* ev)
 	return (UDint)stamp;
 }
 
+static UDboolean danteGetEventPosition(const SDL_Event* ev, UDfloat* x, UDfloat* y)
+{
+	SDL_Window* win;
+	int w;
+	int h;
+	
+	if (!ev) {
+		return false;
+	}
+	
+	switch (ev->type) {
+	case SDL_MOUSEMOTION:
+		*x = (UDfloat)ev->motion.x;
+		*y = (UDfloat)ev->motion.y;
+		return true;
+	
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		*x = (UDfloat)ev->button.x;
+		*y = (UDfloat)ev->button.y;
+		return true;
+	
+	case SDL_FINGERDOWN:
+	case SDL_FINGERUP:
+	case SDL_FINGERMOTION:
+		/* SDL reports normalized touch coordinates */
+		w = 0;
+		h = 0;
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+		win = SDL_GetWindowFromID(ev->tfinger.windowID);
+		if (!win) {
+			win = SDL_GetMouseFocus();
+		}
+#else
+		win = SDL_GetMouseFocus();
+#endif
+		if (win) {
+			SDL_GetWindowSize(win, &w, &h);
+		}
+		
+		*x = ev->tfinger.x * w;
+		*y = ev->tfinger.y * h;
+		return true;
+	
+	default:
+		return false;
+	}
+}
+
 static void danteEventBegin(DanteObject* self, UDenum type)
 {
 	/* TODO stub */
@@ -165,9 +224,20 @@ static void danteEventFlush(DanteObject* obj)
 	/* TODO stub, should send the event here */
 }
 
+/* Event virtual table, shared by every event object. */
+static const DanteVTable dante_event_vt = {
+	NULL,
+	danteEventBegin,
+	danteEventEnd,
+	danteEventFlush,
+	NULL, /* synchronous flush */
+	danteEventClear,
+	NULL /* cheap teardown */
+};
+
 static void danteEventClear(DanteObject* self)
 {
-	if (self->handle == dante_context->ev->handle) {
+	if (self == dante_context->ev) {
 		/* a handler is deleting the current event,
 		 * mark the event handling as complete.
 		 */
@@ -178,16 +248,46 @@ static void danteEventClear(DanteObject* self)
 void DANTEAPIENTRY danteGenerateFrom(const SDL_Event* sev, UDenum type)
 { 
 	DanteObject* obj;
+	UDint i;
+	
+	/* take the next free event ring slot, slots are released as soon
+	 * as the event is finished, so the first one is almost always free.
+	 */
+	obj = NULL;
+	for (i = 0; i < DANTE_EVENT_RING; i++) {
+		DanteObject* slot = &dante_context->cache[dante_context->ring_next];
+		
+		dante_context->ring_next = (dante_context->ring_next + 1) % DANTE_EVENT_RING;
+		if (slot->type == UDESK_NONE) {
+			/* initialize common fields, no need to clear object data */
+			slot->type = UDESK_HANDLE_EVENT;
+			slot->refs = 1;
+			slot->dispatch = NULL;
+			slot->parent = NULL;
+			slot->slot = -1;
+			slot->range = -1;
+			obj = slot;
+			break;
+		}
+	}
+	
+	if (!obj) {
+		/* ring exhausted by nested events, fall back to regular allocation */
+		obj = danteAllocObject(UDESK_HANDLE_EVENT);
+	}
 	
-	obj = danteAllocObject(UDESK_HANDLE_EVENT);
 	if (obj) {
 		DanteEventObject* ev = &obj->d.ev;
 		
+		obj->vt = &dante_event_vt;
 		ev->type = type;
+		ev->propagates = true;
 		ev->building = false;
 		ev->valid = true;
 		ev->sent = true;
-		ev->sev = *sev;
+		ev->from = NULL;
+		ev->to = NULL;
+		ev->sev = sev;
 	}
 	
 	dante_context->ev = obj;
@@ -232,6 +332,7 @@ void DANTEAPIENTRY danteHandleWindowEvent(const SDL_Event* ev)
 		return;
 	}
 	
+	danteWindowUpdateState(to, wev);
 	switch (wev->event) {
 	case SDL_WINDOWEVENT_FOCUS_GAINED:
 	case SDL_WINDOWEVENT_FOCUS_LOST:
@@ -254,6 +355,11 @@ void DANTEAPIENTRY danteHandleWindowEvent(const SDL_Event* ev)
 		dantePropagateEvent(DANTE_DESTROY_DISPATCH_ID, NULL, to);
 		break;
 	
+	case SDL_WINDOWEVENT_SIZE_CHANGED:
+		/* relayout only, SDL reports a separate event for redrawing */
+		danteWindowResize(to, wev->data1, wev->data2);
+		return;
+	
 	case SDL_WINDOWEVENT_SHOWN:
 	case SDL_WINDOWEVENT_MAXIMIZED:
 	case SDL_WINDOWEVENT_RESIZED:
@@ -271,17 +377,24 @@ void DANTEAPIENTRY danteHandleWindowEvent(const SDL_Event* ev)
 	danteFinishEvent();
 }
 
+void DANTEAPIENTRY danteHandleFlushEvent(const SDL_Event* ev)
+{
+	DanteObject* to;
+	
+	to = danteGetObjectFromWindowID(ev->user.windowID);
+	if (!to) {
+		/* window destroyed while the frame was in flight, discard */
+		return;
+	}
+	
+	danteGenerateFrom(ev, UDESK_EVENT_FLUSH_EXT);
+	dantePropagateEvent(DANTE_FLUSH_DISPATCH_ID, NULL, to);
+	danteFinishEvent();
+}
+
 UDboolean DANTEAPIENTRY danteEventInit(DanteObject* obj)
 {
-	static const DanteVTable ev_table = {
-		NULL,
-		danteEventBegin,
-		danteEventEnd,
-		danteEventFlush,
-		danteEventClear
-	};
-	
-	obj->vt = &ev_table;
+	obj->vt = &dante_event_vt;
 	return true;
 }
 
@@ -289,6 +402,8 @@ void UDESKAPIENTRY udeskGetEventiv(UDhandle event, UDenum param, UDint* dst)
 {
 	DanteObject* obj;
 	DanteEventObject* ev;
+	UDfloat x;
+	UDfloat y;
 	
 	obj = danteRetrieveObject(event, UDESK_HANDLE_EVENT);
 	if (!obj) {
@@ -297,6 +412,7 @@ void UDESKAPIENTRY udeskGetEventiv(UDhandle event, UDenum param, UDint* dst)
 	
 	ev = &obj->d.ev;
 	DANTE_ERROR_IF(!ev->valid, UDESK_INVALID_OPERATION);
+	DANTE_ERROR_IF(!dst, UDESK_INVALID_VALUE);
 	
 	switch (param) {
 	case UDESK_EVENT_TYPE:
@@ -304,7 +420,65 @@ void UDESKAPIENTRY udeskGetEventiv(UDhandle event, UDenum param, UDint* dst)
 		break;
 	
 	case UDESK_EVENT_TIMESTAMP:
-		dst[0] = danteGetEventTimestamp(&ev->sev);
+		dst[0] = danteGetEventTimestamp(ev->sev);
+		break;
+	
+	case UDESK_EVENT_POSITION:
+		DANTE_ERROR_IF(!danteGetEventPosition(ev->sev, &x, &y), UDESK_INVALID_ENUM);
+		dst[0] = (UDint)x;
+		dst[1] = (UDint)y;
+		break;
+	
+	case UDESK_EVENT_KEYCODE_EXT:
+		if (!ev->sev) {
+			dante_context->error = UDESK_INVALID_ENUM;
+		} else if (ev->sev->type == SDL_KEYDOWN || ev->sev->type == SDL_KEYUP) {
+			dst[0] = danteTranslateScancode(ev->sev->key.keysym.scancode);
+		} else if (ev->sev->type == SDL_MOUSEBUTTONDOWN || ev->sev->type == SDL_MOUSEBUTTONUP) {
+			dst[0] = danteTranslateButton(ev->sev->button.button);
+		} else {
+			dante_context->error = UDESK_INVALID_ENUM;
+		}
+		
+		break;
+	
+	case UDESK_EVENT_KEY_STATE_EXT:
+		if (!ev->sev) {
+			dante_context->error = UDESK_INVALID_ENUM;
+		} else if (ev->sev->type == SDL_KEYDOWN || ev->sev->type == SDL_KEYUP) {
+			dst[0] = (ev->sev->key.state == SDL_PRESSED)? UDESK_EVENT_PRESS : UDESK_EVENT_RELEASE;
+		} else if (ev->sev->type == SDL_MOUSEBUTTONDOWN || ev->sev->type == SDL_MOUSEBUTTONUP) {
+			dst[0] = (ev->sev->button.state == SDL_PRESSED)? UDESK_EVENT_PRESS : UDESK_EVENT_RELEASE;
+		} else {
+			dante_context->error = UDESK_INVALID_ENUM;
+		}
+		
+		break;
+	
+	case UDESK_EVENT_MODIFIERS_EXT:
+		if (ev->sev && (ev->sev->type == SDL_KEYDOWN || ev->sev->type == SDL_KEYUP)) {
+			dst[0] = danteTranslateModifiers(ev->sev->key.keysym.mod);
+		} else {
+			/* events are dispatched synchronously, the context
+			 * snapshot matches the state at generation time.
+			 */
+			dst[0] = dante_context->modifiers;
+		}
+		
+		break;
+	
+	case UDESK_EVENT_FENCE_EXT:
+		if (ev->sev && ev->sev->type == dante_context->flush_event) {
+			dst[0] = ev->sev->user.code;
+		} else {
+			dst[0] = 0;
+		}
+		
+		break;
+	
+	case UDESK_EVENT_ERROR_EXT:
+		DANTE_ERROR_IF(ev->type != UDESK_EVENT_LOAD_EXT || !ev->sev, UDESK_INVALID_ENUM);
+		dst[0] = ev->sev->user.code;
 		break;
 	
 	default:
@@ -313,6 +487,36 @@ void UDESKAPIENTRY udeskGetEventiv(UDhandle event, UDenum param, UDint* dst)
 	}
 }
 
+void UDESKAPIENTRY udeskGetEventfv(UDhandle event, UDenum param, UDfloat* dst)
+{
+	DanteObject* obj;
+	DanteEventObject* ev;
+	
+	obj = danteRetrieveObject(event, UDESK_HANDLE_EVENT);
+	if (!obj) {
+		return;
+	}
+	
+	ev = &obj->d.ev;
+	DANTE_ERROR_IF(!ev->valid, UDESK_INVALID_OPERATION);
+	DANTE_ERROR_IF(!dst, UDESK_INVALID_VALUE);
+	
+	switch (param) {
+	case UDESK_EVENT_POSITION:
+		DANTE_ERROR_IF(!danteGetEventPosition(ev->sev, &dst[0], &dst[1]), UDESK_INVALID_ENUM);
+		break;
+	
+	case UDESK_EVENT_PRESSURE_EXT:
+		DANTE_ERROR_IF(ev->type != UDESK_EVENT_TOUCH || !ev->sev, UDESK_INVALID_ENUM);
+		dst[0] = ev->sev->tfinger.pressure;
+		break;
+	
+	default:
+		dante_context->error = UDESK_INVALID_ENUM;
+		break;
+	}
+}
+
 UDhandle UDESKAPIENTRY udeskGetEventHandle(UDhandle event, UDenum param)
 {
 	DanteObject* obj;
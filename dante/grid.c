@@ -0,0 +1,398 @@
+/* grid.c: Window spatial index.
+ *
+ * Implements the uniform grid used by windows to resolve the object
+ * under the cursor without walking the whole object tree.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <stdlib.h>
+
+/* Smallest grid cell edge, as a power of two (16 pixels). */
+#define DANTE_GRID_MIN_SHIFT 4
+/* Largest grid cell edge, as a power of two (512 pixels). */
+#define DANTE_GRID_MAX_SHIFT 9
+/* Average number of objects the grid tries to keep in each cell. */
+#define DANTE_GRID_CELL_LOAD 4
+
+/* Appends entry 'idx' to 'cell', returns false on out of memory. */
+static UDboolean danteGridCellAdd(DanteGridCell* cell, UDint idx);
+/* Removes entry 'idx' from 'cell', if present. */
+static void danteGridCellRemove(DanteGridCell* cell, UDint idx);
+/* Computes the cells range overlapped by 'area', returns false if
+ * 'area' lies outside the grid or is empty.
+ */
+static UDboolean danteGridRange(const DanteGrid* grid, const SDL_Rect* area, UDint* x0, UDint* y0, UDint* x1, UDint* y1);
+/* Links entry 'idx' into every cell it overlaps, on out of memory
+ * the cells are dropped and the grid falls back to a linear scan
+ * until the next rebuild.
+ */
+static void danteGridLink(DanteGrid* grid, UDint idx);
+/* Unlinks entry 'idx' from every cell it overlaps. */
+static void danteGridUnlink(DanteGrid* grid, UDint idx);
+/* Frees the cells buffer. */
+static void danteGridFreeCells(DanteGrid* grid);
+/* Rebuilds the cells buffer, choosing a cell size suitable for the
+ * current number of indexed objects.
+ */
+static void danteGridBuild(DanteGrid* grid);
+/* Returns the depth of 'obj' inside its window tree. */
+static UDint danteGridDepth(const DanteObject* obj);
+/* Returns true if entry 'a' lies on top of entry 'b'. */
+static UDboolean danteGridAbove(const DanteGridEntry* a, const DanteGridEntry* b);
+
+static UDboolean danteGridCellAdd(DanteGridCell* cell, UDint idx)
+{
+	if (cell->count == cell->capacity) {
+		UDint capacity = (cell->capacity > 0)? cell->capacity * 2 : 4;
+		UDint* items = (UDint*)realloc(cell->items, capacity * sizeof(*items));
+		
+		if (!items) {
+			return false;
+		}
+		
+		cell->items = items;
+		cell->capacity = capacity;
+	}
+	
+	cell->items[cell->count++] = idx;
+	return true;
+}
+
+static void danteGridCellRemove(DanteGridCell* cell, UDint idx)
+{
+	UDint i;
+	
+	for (i = 0; i < cell->count; i++) {
+		if (cell->items[i] == idx) {
+			/* order is irrelevant, serials resolve overlaps */
+			cell->items[i] = cell->items[--cell->count];
+			return;
+		}
+	}
+}
+
+static UDboolean danteGridRange(const DanteGrid* grid, const SDL_Rect* area, UDint* x0, UDint* y0, UDint* x1, UDint* y1)
+{
+	int left = area->x;
+	int top = area->y;
+	int right = area->x + area->w - 1;
+	int bottom = area->y + area->h - 1;
+	
+	if (area->w <= 0 || area->h <= 0 || right < 0 || bottom < 0 ||
+	    left >= grid->width || top >= grid->height) {
+		return false;
+	}
+	
+	if (left < 0) {
+		left = 0;
+	}
+	if (top < 0) {
+		top = 0;
+	}
+	if (right >= grid->width) {
+		right = grid->width - 1;
+	}
+	if (bottom >= grid->height) {
+		bottom = grid->height - 1;
+	}
+	
+	*x0 = left >> grid->shift;
+	*y0 = top >> grid->shift;
+	*x1 = right >> grid->shift;
+	*y1 = bottom >> grid->shift;
+	return true;
+}
+
+static void danteGridLink(DanteGrid* grid, UDint idx)
+{
+	UDint x0, y0, x1, y1;
+	UDint x, y;
+	
+	if (!grid->cells || !danteGridRange(grid, &grid->entries[idx].area, &x0, &y0, &x1, &y1)) {
+		return;
+	}
+	
+	for (y = y0; y <= y1; y++) {
+		for (x = x0; x <= x1; x++) {
+			if (!danteGridCellAdd(&grid->cells[y * grid->cols + x], idx)) {
+				danteGridFreeCells(grid);
+				return;
+			}
+		}
+	}
+}
+
+static void danteGridUnlink(DanteGrid* grid, UDint idx)
+{
+	UDint x0, y0, x1, y1;
+	UDint x, y;
+	
+	if (!grid->cells || !danteGridRange(grid, &grid->entries[idx].area, &x0, &y0, &x1, &y1)) {
+		return;
+	}
+	
+	for (y = y0; y <= y1; y++) {
+		for (x = x0; x <= x1; x++) {
+			danteGridCellRemove(&grid->cells[y * grid->cols + x], idx);
+		}
+	}
+}
+
+static void danteGridFreeCells(DanteGrid* grid)
+{
+	UDint i;
+	
+	if (grid->cells) {
+		for (i = 0; i < grid->cols * grid->rows; i++) {
+			free(grid->cells[i].items);
+		}
+		
+		free(grid->cells);
+		grid->cells = NULL;
+	}
+}
+
+static void danteGridBuild(DanteGrid* grid)
+{
+	Uint64 area;
+	UDint shift;
+	UDint i;
+	
+	danteGridFreeCells(grid);
+	grid->used_at_build = grid->used;
+	if (grid->width <= 0 || grid->height <= 0 || grid->used == 0) {
+		return;
+	}
+	
+	/* grow cells until each one would hold DANTE_GRID_CELL_LOAD
+	 * objects, assuming an even distribution.
+	 */
+	area = (Uint64)grid->width * (Uint64)grid->height * DANTE_GRID_CELL_LOAD;
+	shift = DANTE_GRID_MIN_SHIFT;
+	while (shift < DANTE_GRID_MAX_SHIFT && ((Uint64)1 << (2 * shift)) * (Uint64)grid->used < area) {
+		shift++;
+	}
+	
+	grid->shift = shift;
+	grid->cols = ((grid->width - 1) >> shift) + 1;
+	grid->rows = ((grid->height - 1) >> shift) + 1;
+	grid->cells = (DanteGridCell*)calloc((size_t)grid->cols * grid->rows, sizeof(*grid->cells));
+	if (!grid->cells) {
+		/* fall back to a linear scan */
+		return;
+	}
+	
+	for (i = 0; i < grid->num_entries && grid->cells; i++) {
+		if (grid->entries[i].obj) {
+			danteGridLink(grid, i);
+		}
+	}
+}
+
+static UDint danteGridDepth(const DanteObject* obj)
+{
+	UDint depth = 0;
+	
+	while (obj && obj->type != UDESK_HANDLE_WINDOW) {
+		depth++;
+		obj = obj->parent;
+	}
+	
+	return depth;
+}
+
+static UDboolean danteGridAbove(const DanteGridEntry* a, const DanteGridEntry* b)
+{
+	if (a->depth != b->depth) {
+		return (a->depth > b->depth);
+	}
+	
+	return (a->serial > b->serial);
+}
+
+void DANTEAPIENTRY danteGridInit(DanteGrid* grid, UDint width, UDint height)
+{
+	grid->entries = NULL;
+	grid->num_entries = 0;
+	grid->capacity = 0;
+	grid->first_free = -1;
+	grid->used = 0;
+	grid->used_at_build = 0;
+	grid->serial = 0;
+	grid->cells = NULL;
+	grid->cols = 0;
+	grid->rows = 0;
+	grid->shift = DANTE_GRID_MIN_SHIFT;
+	grid->width = width;
+	grid->height = height;
+}
+
+void DANTEAPIENTRY danteGridClear(DanteGrid* grid)
+{
+	UDint i;
+	
+	for (i = 0; i < grid->num_entries; i++) {
+		if (grid->entries[i].obj) {
+			grid->entries[i].obj->slot = -1;
+		}
+	}
+	
+	danteGridFreeCells(grid);
+	free(grid->entries);
+	danteGridInit(grid, grid->width, grid->height);
+}
+
+void DANTEAPIENTRY danteGridResize(DanteGrid* grid, UDint width, UDint height)
+{
+	if (grid->width != width || grid->height != height) {
+		grid->width = width;
+		grid->height = height;
+		danteGridBuild(grid);
+	}
+}
+
+UDboolean DANTEAPIENTRY danteGridUpdate(DanteGrid* grid, DanteObject* obj)
+{
+	DanteGridEntry* entry;
+	UDint idx = obj->slot;
+	
+	if (idx >= 0) {
+		/* already indexed, relink with the new area */
+		danteGridUnlink(grid, idx);
+		grid->entries[idx].area = obj->area;
+		danteGridLink(grid, idx);
+		return true;
+	}
+	
+	if (grid->first_free >= 0) {
+		idx = grid->first_free;
+		grid->first_free = grid->entries[idx].depth;
+		
+	} else {
+		if (grid->num_entries == grid->capacity) {
+			UDint capacity = (grid->capacity > 0)? grid->capacity * 2 : 16;
+			DanteGridEntry* entries = (DanteGridEntry*)realloc(grid->entries, capacity * sizeof(*entries));
+			
+			if (!entries) {
+				return false;
+			}
+			
+			grid->entries = entries;
+			grid->capacity = capacity;
+		}
+		
+		idx = grid->num_entries++;
+	}
+	
+	entry = &grid->entries[idx];
+	entry->obj = obj;
+	entry->area = obj->area;
+	entry->depth = danteGridDepth(obj);
+	entry->serial = grid->serial++;
+	obj->slot = idx;
+	grid->used++;
+	
+	if (!grid->cells || grid->used > 2 * grid->used_at_build) {
+		/* cells too crowded for the current cell size */
+		danteGridBuild(grid);
+	} else {
+		danteGridLink(grid, idx);
+	}
+	
+	return true;
+}
+
+void DANTEAPIENTRY danteGridRemove(DanteGrid* grid, DanteObject* obj)
+{
+	UDint idx = obj->slot;
+	
+	if (idx < 0) {
+		return;
+	}
+	
+	danteGridUnlink(grid, idx);
+	grid->entries[idx].obj = NULL;
+	grid->entries[idx].depth = grid->first_free;
+	grid->first_free = idx;
+	grid->used--;
+	obj->slot = -1;
+}
+
+void DANTEAPIENTRY danteGridRemoveTree(DanteGrid* grid, DanteObject* root)
+{
+	UDint i;
+	
+	for (i = 0; i < grid->num_entries; i++) {
+		DanteObject* obj = grid->entries[i].obj;
+		DanteObject* it;
+		
+		for (it = obj; it; it = it->parent) {
+			if (it == root) {
+				danteGridRemove(grid, obj);
+				break;
+			}
+		}
+	}
+}
+
+DanteObject* DANTEAPIENTRY danteGridPick(const DanteGrid* grid, UDint x, UDint y)
+{
+	const DanteGridEntry* best = NULL;
+	const UDint* items;
+	UDint count;
+	UDint i;
+	
+	if (x < 0 || y < 0 || x >= grid->width || y >= grid->height) {
+		return NULL;
+	}
+	
+	if (grid->cells) {
+		const DanteGridCell* cell = &grid->cells[(y >> grid->shift) * grid->cols + (x >> grid->shift)];
+		
+		items = cell->items;
+		count = cell->count;
+	} else {
+		/* no cells available, scan every entry */
+		items = NULL;
+		count = grid->num_entries;
+	}
+	
+	for (i = 0; i < count; i++) {
+		const DanteGridEntry* entry = &grid->entries[(items)? items[i] : i];
+		const SDL_Rect* area = &entry->area;
+		
+		if (entry->obj &&
+		    x >= area->x && x < area->x + area->w &&
+		    y >= area->y && y < area->y + area->h &&
+		    (!best || danteGridAbove(entry, best))) {
+			best = entry;
+		}
+	}
+	
+	return (best)? best->obj : NULL;
+}
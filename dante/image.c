@@ -0,0 +1,1254 @@
+/* image.c: Image file loading.
+ *
+ * Image files are mapped in memory rather than read. Uncompressed
+ * top-down BGRA images without translucent pixels, as found in BMP
+ * and TGA files, are already in pixmap format and are referenced in
+ * place, so that textures are uploaded straight from the page cache,
+ * and shared by file identity rather than content, so that the same
+ * unchanged file loaded again is stored once without hashing it.
+ * PPM and PAM images, bottom-up ones and BMP and TGA images not
+ * qualifying otherwise, are converted from the mapping, other BMP
+ * images are decoded by SDL.
+ * Formats are recognized from the file contents by the registered
+ * decoders, QOI images are decoded natively, PNG, JPEG and WebP images
+ * by SDL_image, when built with DANTE_HAVE_SDL_IMAGE.
+ * Images may also be decoded by worker threads, pixmaps are completed
+ * and notified by the event loop once their image is decoded.
+ * Progressive loads decode natively supported formats in bands of
+ * rows, straight into the pixmap pixels, the event loop uploads each
+ * band as soon as it is decoded. Only a band of temporary pixels is
+ * allocated and the file pages decoded already are released, so that
+ * the working set doesn't grow with the image beyond its pixels.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DANTE_HAVE_MMAP
+#endif
+
+#include "dante.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef DANTE_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef DANTE_HAVE_SDL_IMAGE
+#include <SDL_image.h>
+#endif
+
+/* Rows converted by each task. */
+#define DANTE_IMAGE_STRIP 64
+/* Images with fewer pixels are converted by the calling thread alone. */
+#define DANTE_IMAGE_PARALLEL (512 * 512)
+/* Rows decoded by each band of a progressive load. */
+#define DANTE_STREAM_BAND 256
+/* Progressive loads of images with more pixels decode them into a
+ * temporary file, so that rows already shown leave memory.
+ */
+#define DANTE_STREAM_FILE (2048 * 2048)
+
+/* BGR or BGRA pixels conversion in progress, split in strips of rows. */
+typedef struct DanteSwizzle_s {
+	/* source of the first row, 'pitch' is negative for bottom-up rows. */
+	const Uint8* data;
+	int pitch;
+	int bpp;
+	UDboolean alpha;
+	/* RGBA pixels, tightly packed. */
+	Uint8* rgba;
+	int w;
+	int h;
+	/* rows converted by each task. */
+	int strip;
+} DanteSwizzle;
+
+/* Maps the file 'name' into 'file', it returns false on failure. */
+static UDboolean danteMapFile(const char* name, DanteImageFile* file);
+/* Read little endian integers at 'p'. */
+static Uint32 danteLE16(const Uint8* p);
+static Uint32 danteLE32(const Uint8* p);
+/* Skips whitespace and comments of a Netpbm header at 'p'. */
+static const Uint8* danteNetpbmSkip(const Uint8* p, const Uint8* end);
+/* Reads a Netpbm header integer at 'p', skipping whitespace and
+ * comments, it returns the position past it, NULL on failure.
+ */
+static const Uint8* danteNetpbmInt(const Uint8* p, const Uint8* end, int* value);
+/* Returns true if every pixel of the BGRA rows at 'data' is opaque. */
+static UDboolean danteOpaque(const Uint8* data, int w, int h, int pitch);
+/* Converts BGR or BGRA pixels of 'file' to a pixmap surface, 'alpha'
+ * is false if the alpha byte of BGRA pixels is unused, 'flip' is true
+ * for bottom-up rows, it returns NULL if out of memory.
+ */
+static SDL_Surface* danteConvertBGR(const DanteImageFile* file, const Uint8* data, int w, int h, int bpp, int pitch, UDboolean flip, UDboolean alpha, DanteStream* stream);
+/* Converts the RGB or RGBA pixels of 'file' at 'data' to 'surface'. */
+static void danteConvertFile(const DanteImageFile* file, SDL_Surface* surface, const Uint8* data, int pitch, UDenum format, DanteStream* stream);
+/* Creates a 'w' x 'h' pixmap surface, wrapped in the buffer of
+ * 'stream' unless NULL, it returns NULL if out of memory.
+ */
+static SDL_Surface* danteStreamSurface(int w, int h, DanteStream* stream);
+/* Maps 'size' zeroed bytes of an unlinked temporary file, it returns
+ * NULL on failure.
+ */
+static void* danteMapScratch(size_t size);
+/* Drops the pages of the file backed 'buffer' holding the rows from
+ * 'first' to 'last' from memory, they are read back if ever needed.
+ */
+static void danteReleaseRows(const DantePixels* buffer, int first, int last);
+/* Publishes the first 'rows' rows decoded into 'stream', if not NULL,
+ * and releases the pages of 'file' holding the bytes from 'first' to
+ * 'last', which were just decoded, like any preceding them, or any
+ * following them if 'flip' is true.
+ */
+static void danteStreamBand(DanteStream* stream, const DanteImageFile* file, int rows, const Uint8* first, const Uint8* last, UDboolean flip);
+/* Pushes a decode event, if available. */
+static void danteDecodeNotify(void);
+/* Parallel task, converting strip 'index' of the DanteSwizzle 'data'
+ * to RGBA pixels.
+ */
+static void danteSwizzleStrip(void* data, UDint index);
+/* Decodes BGR or BGRA pixels of 'file', referencing them in place if
+ * they are top-down opaque BGRA, converting them otherwise.
+ * 'file' is released, unless referenced by the image.
+ */
+static UDenum danteDecodeBGR(DanteImageFile* file, const Uint8* data, int w, int h, int bpp, int pitch, UDboolean flip, UDboolean alpha, DanteImage* dst, DanteStream* stream);
+/* Format decoders, 'file' holds a file of the given format and is
+ * released, unless referenced by the resulting image. Images decoded
+ * by SDL aren't decoded in bands.
+ */
+static UDenum danteDecodeNetpbm(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+static UDenum danteDecodePAM(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+static UDenum danteDecodeBMP(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+static UDenum danteDecodeTGA(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+static UDenum danteDecodeQOI(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+#ifdef DANTE_HAVE_SDL_IMAGE
+static UDenum danteDecodeSDLImage(DanteImageFile* file, DanteImage* dst, DanteStream* stream);
+#endif
+/* Format sniffers, TGA files have no signature, they are recognized
+ * by their extension and a plausible uncompressed header.
+ */
+static UDboolean danteIsBMP(const DanteImageFile* file, const char* name);
+static UDboolean danteIsPPM(const DanteImageFile* file, const char* name);
+static UDboolean danteIsPAM(const DanteImageFile* file, const char* name);
+static UDboolean danteIsQOI(const DanteImageFile* file, const char* name);
+#ifdef DANTE_HAVE_SDL_IMAGE
+static UDboolean danteIsPNG(const DanteImageFile* file, const char* name);
+static UDboolean danteIsJPEG(const DanteImageFile* file, const char* name);
+static UDboolean danteIsWebP(const DanteImageFile* file, const char* name);
+#endif
+static UDboolean danteIsTGA(const DanteImageFile* file, const char* name);
+/* Read a big endian integer at 'p'. */
+static Uint32 danteBE32(const Uint8* p);
+/* Converts the RGBA32 'loaded' surface, decoded by SDL, into 'dst',
+ * it frees 'loaded' and releases 'file', 'loaded' may be NULL if
+ * decoding failed.
+ */
+static UDenum danteDecodeSurface(DanteImageFile* file, SDL_Surface* loaded, DanteImage* dst);
+/* Stores the converted 'surface' into 'dst', it releases 'file'. */
+static UDenum danteImageConverted(DanteImageFile* file, SDL_Surface* surface, DanteImage* dst);
+/* Computes the content hash of 'image', unless mapped from a file of
+ * known identity, which is looked up instead.
+ */
+static void danteHashImage(DanteImage* image);
+/* Background job decoding a DanteDecode, run by worker threads. */
+static void danteDecodeJob(DanteBackgroundJob* job);
+/* Uploads the rows of the progressive load 'decode' decoded since
+ * the last call, attaching its pixels to the pixmap first, it returns
+ * true if any row was uploaded.
+ */
+static UDboolean danteStreamShow(DanteDecode* decode);
+
+/* Image file decoders built in, registered in this order, formats
+ * with the weakest signatures come first, so that they are sniffed last.
+ */
+static const DanteDecoder dante_builtin_decoders[] = {
+	{ "TGA", danteIsTGA, danteDecodeTGA },
+#ifdef DANTE_HAVE_SDL_IMAGE
+	{ "WebP", danteIsWebP, danteDecodeSDLImage },
+	{ "JPEG", danteIsJPEG, danteDecodeSDLImage },
+	{ "PNG", danteIsPNG, danteDecodeSDLImage },
+#endif
+	{ "QOI", danteIsQOI, danteDecodeQOI },
+	{ "PAM", danteIsPAM, danteDecodePAM },
+	{ "PPM", danteIsPPM, danteDecodeNetpbm },
+	{ "BMP", danteIsBMP, danteDecodeBMP }
+};
+
+/* Registered image file decoders, sniffed from the last registered,
+ * reset by danteInitImage().
+ */
+static const DanteDecoder* dante_decoders[DANTE_MAX_DECODERS];
+static UDint dante_num_decoders = 0;
+
+/* Number of elements in a static array. */
+#define DANTE_ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+static UDboolean danteMapFile(const char* name, DanteImageFile* file)
+{
+#ifdef DANTE_HAVE_MMAP
+	struct stat st;
+	void* addr;
+	int fd;
+	
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+	
+	/* the mapping outlives the descriptor */
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+	
+	file->data = (const Uint8*)addr;
+	file->length = (size_t)st.st_size;
+	file->id.dev = (Uint64)st.st_dev;
+	file->id.ino = (Uint64)st.st_ino;
+	file->id.mtime = (Sint64)st.st_mtime;
+	file->id.size = (Uint64)st.st_size;
+	return true;
+#else
+	SDL_RWops* rw = SDL_RWFromFile(name, "rb");
+	Sint64 size;
+	void* data;
+	
+	if (!rw) {
+		return false;
+	}
+	
+	/* no mapping available, read the whole file instead */
+	size = SDL_RWsize(rw);
+	data = (size > 0)? malloc((size_t)size) : NULL;
+	if (!data || SDL_RWread(rw, data, 1, (size_t)size) != (size_t)size) {
+		free(data);
+		SDL_RWclose(rw);
+		return false;
+	}
+	
+	SDL_RWclose(rw);
+	file->data = (const Uint8*)data;
+	file->length = (size_t)size;
+	memset(&file->id, 0, sizeof(file->id));
+	return true;
+#endif
+}
+
+void DANTEAPIENTRY danteUnmapFile(const void* data, size_t length)
+{
+#ifdef DANTE_HAVE_MMAP
+	munmap((void*)data, length);
+#else
+	free((void*)data);
+#endif
+}
+
+static Uint32 danteLE16(const Uint8* p)
+{
+	return (Uint32)p[0] | ((Uint32)p[1] << 8);
+}
+
+static Uint32 danteLE32(const Uint8* p)
+{
+	return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+static Uint32 danteBE32(const Uint8* p)
+{
+	return ((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) | ((Uint32)p[2] << 8) | (Uint32)p[3];
+}
+
+static const Uint8* danteNetpbmSkip(const Uint8* p, const Uint8* end)
+{
+	for (;;) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+			p++;
+		}
+		if (p == end || *p != '#') {
+			break;
+		}
+		while (p < end && *p != '\n') {
+			p++;
+		}
+	}
+	
+	return p;
+}
+
+static const Uint8* danteNetpbmInt(const Uint8* p, const Uint8* end, int* value)
+{
+	p = danteNetpbmSkip(p, end);
+	if (p == end || *p < '0' || *p > '9') {
+		return NULL;
+	}
+	
+	*value = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		*value = *value * 10 + (*p++ - '0');
+		if (*value > DANTE_IMAGE_MAX) {
+			return NULL;
+		}
+	}
+	
+	return p;
+}
+
+static UDboolean danteOpaque(const Uint8* data, int w, int h, int pitch)
+{
+	int x, y;
+	
+	for (y = 0; y < h; y++) {
+		const Uint8* row = data + y * pitch;
+		
+		for (x = 0; x < w; x++) {
+			if (row[x * 4 + 3] != 0xff) {
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+static void danteSwizzleStrip(void* data, UDint index)
+{
+	DanteSwizzle* sw = (DanteSwizzle*)data;
+	int first = (int)index * sw->strip;
+	int last = SDL_min(first + sw->strip, sw->h);
+	int x, y;
+	
+	for (y = first; y < last; y++) {
+		const Uint8* src = sw->data + (ptrdiff_t)y * sw->pitch;
+		Uint8* dst = sw->rgba + (size_t)y * sw->w * 4;
+		
+		for (x = 0; x < sw->w; x++) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+			dst[3] = (sw->alpha)? src[3] : 0xff;
+			src += sw->bpp;
+			dst += 4;
+		}
+	}
+}
+
+static SDL_Surface* danteStreamSurface(int w, int h, DanteStream* stream)
+{
+	SDL_Surface* surface;
+	size_t size = (size_t)w * h * 4;
+	void* mapping = NULL;
+	
+	if (stream && (size_t)w * h > DANTE_STREAM_FILE) {
+		/* the heap is used instead on failure */
+		mapping = danteMapScratch(size);
+	}
+	if (mapping) {
+		surface = SDL_CreateRGBSurfaceWithFormatFrom(mapping, w, h, 32, w * 4, DANTE_PIXMAP_FORMAT);
+	} else {
+		surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, DANTE_PIXMAP_FORMAT);
+	}
+	if (surface && stream) {
+		/* private buffers don't touch the context, undecoded rows
+		 * stay transparent
+		 */
+		stream->buffer = danteSharePixels(surface, false);
+		if (!stream->buffer) {
+			surface = NULL;
+		} else if (mapping) {
+			stream->buffer->mapping = mapping;
+			stream->buffer->mapped = size;
+			return surface;
+		}
+	}
+	if (!surface && mapping) {
+		danteUnmapFile(mapping, size);
+	}
+	
+	return surface;
+}
+
+static void* danteMapScratch(size_t size)
+{
+#ifdef DANTE_HAVE_MMAP
+	const char* dir = SDL_getenv("TMPDIR");
+	char name[1024];
+	void* addr;
+	int fd;
+	
+	if (!dir || !*dir) {
+		dir = "/tmp";
+	}
+	if (SDL_snprintf(name, sizeof(name), "%s/danteXXXXXX", dir) >= (int)sizeof(name)) {
+		return NULL;
+	}
+	
+	fd = mkstemp(name);
+	if (fd < 0) {
+		return NULL;
+	}
+	
+	/* the file goes away along with the mapping */
+	unlink(name);
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		return NULL;
+	}
+	
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return (addr != MAP_FAILED)? addr : NULL;
+#else
+	return NULL;
+#endif
+}
+
+static void danteReleaseRows(const DantePixels* buffer, int first, int last)
+{
+#ifdef DANTE_HAVE_MMAP
+	size_t page;
+	size_t start;
+	size_t end;
+	
+	if (!buffer->mapping) {
+		return;
+	}
+	
+	/* pages shared with rows not shown yet stay, shared mappings
+	 * keep the dropped contents in the file
+	 */
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	start = ((size_t)first * buffer->surface->pitch + page - 1) & ~(page - 1);
+	end = (size_t)last * buffer->surface->pitch;
+	if (last < buffer->surface->h) {
+		end &= ~(page - 1);
+	}
+	if (start < end) {
+		madvise((Uint8*)buffer->mapping + start, end - start, MADV_DONTNEED);
+	}
+#endif
+}
+
+static void danteStreamBand(DanteStream* stream, const DanteImageFile* file, int rows, const Uint8* first, const Uint8* last, UDboolean flip)
+{
+#ifdef DANTE_HAVE_MMAP
+	size_t page;
+	size_t start;
+	size_t end;
+#endif
+	
+	if (!stream) {
+		return;
+	}
+	
+	SDL_AtomicSet(&stream->rows, rows);
+	danteDecodeNotify();
+#ifdef DANTE_HAVE_MMAP
+	/* decoded pages of the mapping are dropped, they are read
+	 * again from the page cache if ever needed
+	 */
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	start = (size_t)(first - file->data);
+	end = SDL_min((size_t)(last - file->data), file->length);
+	if (flip) {
+		start = (start + page - 1) & ~(page - 1);
+		end = (end + page - 1) & ~(page - 1);
+	} else {
+		start &= ~(page - 1);
+		end &= ~(page - 1);
+	}
+	if (start < end) {
+		madvise((void*)(file->data + start), end - start, MADV_DONTNEED);
+	}
+#endif
+}
+
+static SDL_Surface* danteConvertBGR(const DanteImageFile* file, const Uint8* data, int w, int h, int bpp, int pitch, UDboolean flip, UDboolean alpha, DanteStream* stream)
+{
+	DanteSwizzle sw;
+	SDL_Surface* surface;
+	const Uint8* first;
+	int band = (stream)? SDL_min(DANTE_STREAM_BAND, h) : h;
+	int rows;
+	int y;
+	
+	/* a band of RGBA pixels at most, whole images unless streaming */
+	sw.rgba = (Uint8*)malloc((size_t)w * band * 4);
+	if (!sw.rgba) {
+		return NULL;
+	}
+	
+	surface = danteStreamSurface(w, h, stream);
+	if (!surface) {
+		free(sw.rgba);
+		return NULL;
+	}
+	
+	sw.pitch = (flip)? -pitch : pitch;
+	sw.bpp = bpp;
+	sw.alpha = alpha;
+	sw.w = w;
+	for (y = 0; y < h; y += rows) {
+		rows = SDL_min(band, h - y);
+		first = data + (size_t)((flip)? h - y - rows : y) * pitch;
+		sw.data = (flip)? first + (size_t)(rows - 1) * pitch : first;
+		sw.h = rows;
+		if (w * rows < DANTE_IMAGE_PARALLEL) {
+			sw.strip = rows;
+			danteSwizzleStrip(&sw, 0);
+		} else {
+			/* rows are independent, large images are split across workers */
+			sw.strip = DANTE_IMAGE_STRIP;
+			danteRunTasks(danteSwizzleStrip, &sw, (rows + DANTE_IMAGE_STRIP - 1) / DANTE_IMAGE_STRIP);
+		}
+		
+		/* premultiplied by the pixel conversion kernels */
+		danteConvertBand(surface, y, rows, sw.rgba, w * 4, UDESK_RGBA);
+		danteStreamBand(stream, file, y + rows, first, first + (size_t)rows * pitch, flip);
+	}
+	
+	free(sw.rgba);
+	return surface;
+}
+
+static void danteConvertFile(const DanteImageFile* file, SDL_Surface* surface, const Uint8* data, int pitch, UDenum format, DanteStream* stream)
+{
+	int band = (stream)? DANTE_STREAM_BAND : surface->h;
+	int rows;
+	int y;
+	
+	for (y = 0; y < surface->h; y += rows) {
+		rows = SDL_min(band, surface->h - y);
+		danteConvertBand(surface, y, rows, data + (size_t)y * pitch, pitch, format);
+		danteStreamBand(stream, file, y + rows, data + (size_t)y * pitch, data + (size_t)(y + rows) * pitch, false);
+	}
+}
+
+static UDenum danteImageConverted(DanteImageFile* file, SDL_Surface* surface, DanteImage* dst)
+{
+	danteUnmapFile(file->data, file->length);
+	if (!surface) {
+		return UDESK_OUT_OF_MEMORY;
+	}
+	
+	dst->surface = surface;
+	dst->mapping = NULL;
+	dst->mapped = 0;
+	memset(&dst->id, 0, sizeof(dst->id));
+	return UDESK_NO_ERROR;
+}
+
+static UDenum danteDecodeBGR(DanteImageFile* file, const Uint8* data, int w, int h, int bpp, int pitch, UDboolean flip, UDboolean alpha, DanteImage* dst, DanteStream* stream)
+{
+	SDL_Surface* surface;
+	
+	if (data < file->data || (size_t)(data - file->data) + (size_t)(h - 1) * pitch + (size_t)w * bpp > file->length) {
+		danteUnmapFile(file->data, file->length);
+		return UDESK_OPERATION_FAILED;
+	}
+	
+	/* straight and premultiplied alpha only match on opaque pixels,
+	 * checking them pages the whole file in, once per load, streams
+	 * show rows before reading the whole file instead
+	 */
+	if (stream || bpp != 4 || flip || ((data - file->data) & 3) != 0 || !danteOpaque(data, w, h, pitch)) {
+		return danteImageConverted(file, danteConvertBGR(file, data, w, h, bpp, pitch, flip, alpha, stream), dst);
+	}
+	
+	surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)data, w, h, 32, pitch, DANTE_PIXMAP_FORMAT);
+	if (!surface) {
+		return danteImageConverted(file, NULL, dst);
+	}
+	
+	dst->surface = surface;
+	dst->mapping = file->data;
+	dst->mapped = file->length;
+	dst->id = file->id;
+	return UDESK_NO_ERROR;
+}
+
+static UDenum danteDecodeNetpbm(DanteImageFile* file, DanteImage* dst, DanteStream* stream)
+{
+	const Uint8* end = file->data + file->length;
+	const Uint8* p;
+	SDL_Surface* surface;
+	int w, h, maxval;
+	
+	p = danteNetpbmInt(file->data + 2, end, &w);
+	p = (p)? danteNetpbmInt(p, end, &h) : NULL;
+	p = (p)? danteNetpbmInt(p, end, &maxval) : NULL;
+	
+	/* a single whitespace separates the header from the pixels */
+	if (!p || p == end || w < 1 || h < 1 || maxval != 255 || (size_t)(end - p - 1) < (size_t)w * h * 3) {
+		danteUnmapFile(file->data, file->length);
+		return UDESK_OPERATION_FAILED;
+	}
+	
+	surface = danteStreamSurface(w, h, stream);
+	if (surface) {
+		danteConvertFile(file, surface, p + 1, w * 3, UDESK_RGB_EXT, stream);
+	}
+	
+	return danteImageConverted(file, surface, dst);
+}
+
+static UDenum danteDecodePAM(DanteImageFile* file, DanteImage* dst, DanteStream* stream)
+{
+	const Uint8* end = file->data + file->length;
+	const Uint8* p = file->data + 2;
+	SDL_Surface* surface;
+	int w = 0, h = 0, depth = 0, maxval = 0;
+	
+	for (;;) {
+		p = danteNetpbmSkip(p, end);
+		if (end - p >= 6 && memcmp(p, "ENDHDR", 6) == 0) {
+			for (p += 6; p < end && *p != '\n'; p++);
+			
+			p = (p < end)? p + 1 : NULL;
+			break;
+		}
+		
+		if (end - p >= 5 && memcmp(p, "WIDTH", 5) == 0) {
+			p = danteNetpbmInt(p + 5, end, &w);
+		} else if (end - p >= 6 && memcmp(p, "HEIGHT", 6) == 0) {
+			p = danteNetpbmInt(p + 6, end, &h);
+		} else if (end - p >= 5 && memcmp(p, "DEPTH", 5) == 0) {
+			p = danteNetpbmInt(p + 5, end, &depth);
+		} else if (end - p >= 6 && memcmp(p, "MAXVAL", 6) == 0) {
+			p = danteNetpbmInt(p + 6, end, &maxval);
+		} else if (end - p >= 8 && memcmp(p, "TUPLTYPE", 8) == 0) {
+			/* implied by DEPTH for the supported images */
+			for (; p < end && *p != '\n'; p++);
+		} else {
+			p = NULL;
+		}
+		if (!p) {
+			break;
+		}
+	}
+	
+	if (!p || w < 1 || h < 1 || (depth != 3 && depth != 4) || maxval != 255 || (size_t)(end - p) < (size_t)w * h * depth) {
+		danteUnmapFile(file->data, file->length);
+		return UDESK_OPERATION_FAILED;
+	}
+	
+	surface = danteStreamSurface(w, h, stream);
+	if (surface) {
+		danteConvertFile(file, surface, p, w * depth, (depth == 4)? UDESK_RGBA : UDESK_RGB_EXT, stream);
+	}
+	
+	return danteImageConverted(file, surface, dst);
+}
+
+static UDenum danteDecodeBMP(DanteImageFile* file, DanteImage* dst, DanteStream* stream)
+{
+	const Uint8* data = file->data;
+	Uint32 offset, header, compression, bpp;
+	Sint32 w, h;
+	UDboolean alpha;
+	
+	if (file->length >= 54) {
+		offset = danteLE32(data + 10);
+		header = danteLE32(data + 14);
+		w = (Sint32)danteLE32(data + 18);
+		h = (Sint32)danteLE32(data + 22);
+		bpp = danteLE16(data + 28);
+		compression = danteLE32(data + 30);
+		
+		if (header >= 40 && w >= 1 && w <= DANTE_IMAGE_MAX && h != 0 && h >= -DANTE_IMAGE_MAX && h <= DANTE_IMAGE_MAX && offset < file->length) {
+			if (compression == 0 && (bpp == 24 || bpp == 32)) {
+				/* the fourth byte of 32 bits pixels is unused */
+				return danteDecodeBGR(file, data + offset, w, (h < 0)? -h : h, bpp / 8, (w * (bpp / 8) + 3) & ~3, h > 0, false, dst, stream);
+			}
+			if ((compression == 3 || compression == 6) && bpp == 32 && file->length >= 70 &&
+			    danteLE32(data + 54) == 0x00ff0000 && danteLE32(data + 58) == 0x0000ff00 && danteLE32(data + 62) == 0x000000ff) {
+				alpha = (header >= 56 || compression == 6) && danteLE32(data + 66) == 0xff000000;
+				return danteDecodeBGR(file, data + offset, w, (h < 0)? -h : h, 4, w * 4, h > 0, alpha, dst, stream);
+			}
+		}
+	}
+	
+	/* palettes, RLE and unusual masks are decoded by SDL */
+	return danteDecodeSurface(file, SDL_LoadBMP_RW(SDL_RWFromConstMem(file->data, (int)file->length), 1), dst);
+}
+
+static UDenum danteDecodeSurface(DanteImageFile* file, SDL_Surface* loaded, DanteImage* dst)
+{
+	SDL_Surface* rgba;
+	SDL_Surface* surface = NULL;
+	
+	if (!loaded) {
+		danteUnmapFile(file->data, file->length);
+		return UDESK_OPERATION_FAILED;
+	}
+	
+	rgba = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(loaded);
+	if (rgba) {
+		surface = SDL_CreateRGBSurfaceWithFormat(0, rgba->w, rgba->h, 32, DANTE_PIXMAP_FORMAT);
+		if (surface) {
+			danteConvertPixels(surface, rgba->pixels, rgba->pitch, UDESK_RGBA);
+		}
+		
+		SDL_FreeSurface(rgba);
+	}
+	
+	return danteImageConverted(file, surface, dst);
+}
+
+static UDboolean danteIsBMP(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 2 && file->data[0] == 'B' && file->data[1] == 'M';
+}
+
+static UDboolean danteIsPPM(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 2 && file->data[0] == 'P' && file->data[1] == '6';
+}
+
+static UDboolean danteIsPAM(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 2 && file->data[0] == 'P' && file->data[1] == '7';
+}
+
+static UDboolean danteIsQOI(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 14 && memcmp(file->data, "qoif", 4) == 0;
+}
+
+#ifdef DANTE_HAVE_SDL_IMAGE
+
+static UDboolean danteIsPNG(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 8 && memcmp(file->data, "\x89PNG\r\n\x1a\n", 8) == 0;
+}
+
+static UDboolean danteIsJPEG(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 3 && file->data[0] == 0xff && file->data[1] == 0xd8 && file->data[2] == 0xff;
+}
+
+static UDboolean danteIsWebP(const DanteImageFile* file, const char* name)
+{
+	return file->length >= 12 && memcmp(file->data, "RIFF", 4) == 0 && memcmp(file->data + 8, "WEBP", 4) == 0;
+}
+
+#endif /* DANTE_HAVE_SDL_IMAGE */
+
+static UDboolean danteIsTGA(const DanteImageFile* file, const char* name)
+{
+	const Uint8* data = file->data;
+	size_t len = SDL_strlen(name);
+	Uint32 w, h;
+	
+	if (file->length < 18 || len < 4 || SDL_strcasecmp(name + len - 4, ".tga") != 0) {
+		return false;
+	}
+	
+	/* uncompressed true color, stored left to right */
+	w = danteLE16(data + 12);
+	h = danteLE16(data + 14);
+	return data[1] == 0 && data[2] == 2 && (data[16] == 24 || data[16] == 32) &&
+	       (data[17] & 0x10) == 0 && w >= 1 && h >= 1;
+}
+
+static UDenum danteDecodeTGA(DanteImageFile* file, DanteImage* dst, DanteStream* stream)
+{
+	const Uint8* data = file->data;
+	int w = (int)danteLE16(data + 12);
+	int h = (int)danteLE16(data + 14);
+	int bpp = data[16] / 8;
+	
+	/* pixels follow the image ID, bottom-up unless flagged otherwise */
+	return danteDecodeBGR(file, data + 18 + data[0], w, h, bpp, w * bpp, (data[17] & 0x20) == 0, bpp == 4 && (data[17] & 0x0f) == 8, dst, stream);
+}
+
+static UDenum danteDecodeQOI(DanteImageFile* file, DanteImage* dst, DanteStream* stream)
+{
+	const Uint8* data = file->data;
+	size_t end = file->length - 8;
+	size_t p = 14;
+	size_t start;
+	Uint8 index[64 * 4];
+	Uint8 px[4];
+	Uint8* rgba;
+	Uint8* out;
+	SDL_Surface* surface;
+	Uint32 w, h, i, n;
+	Uint32 y, rows, band;
+	int run = 0;
+	int dg;
+	Uint8 b1, b2;
+	
+	w = danteBE32(data + 4);
+	h = danteBE32(data + 8);
+	if (file->length < 22 || w < 1 || h < 1 || w > DANTE_IMAGE_MAX || h > DANTE_IMAGE_MAX) {
+		danteUnmapFile(file->data, file->length);
+		return UDESK_OPERATION_FAILED;
+	}
+	
+	/* a band of RGBA pixels at most, whole images unless streaming */
+	band = (stream)? SDL_min((Uint32)DANTE_STREAM_BAND, h) : h;
+	rgba = (Uint8*)malloc((size_t)w * band * 4);
+	if (!rgba) {
+		return danteImageConverted(file, NULL, dst);
+	}
+	
+	surface = danteStreamSurface((int)w, (int)h, stream);
+	if (!surface) {
+		free(rgba);
+		return danteImageConverted(file, NULL, dst);
+	}
+	
+	/* chunks depend on previous pixels, decoding is sequential */
+	memset(index, 0, sizeof(index));
+	px[0] = px[1] = px[2] = 0;
+	px[3] = 0xff;
+	for (y = 0; y < h; y += rows) {
+		rows = SDL_min(band, h - y);
+		start = p;
+		out = rgba;
+		for (n = w * rows; n > 0; n--) {
+			if (run > 0) {
+				run--;
+			} else if (p < end) {
+				b1 = data[p++];
+				if (b1 == 0xfe && p + 3 <= end) {
+					px[0] = data[p];
+					px[1] = data[p + 1];
+					px[2] = data[p + 2];
+					p += 3;
+				} else if (b1 == 0xff && p + 4 <= end) {
+					memcpy(px, data + p, 4);
+					p += 4;
+				} else if ((b1 & 0xc0) == 0x00) {
+					memcpy(px, index + b1 * 4, 4);
+				} else if ((b1 & 0xc0) == 0x40) {
+					px[0] += ((b1 >> 4) & 0x03) - 2;
+					px[1] += ((b1 >> 2) & 0x03) - 2;
+					px[2] += (b1 & 0x03) - 2;
+				} else if ((b1 & 0xc0) == 0x80 && p < end) {
+					b2 = data[p++];
+					dg = (b1 & 0x3f) - 32;
+					px[0] += dg - 8 + ((b2 >> 4) & 0x0f);
+					px[1] += dg;
+					px[2] += dg - 8 + (b2 & 0x0f);
+				} else if ((b1 & 0xc0) == 0xc0 && b1 < 0xfe) {
+					run = b1 & 0x3f;
+				} else {
+					/* truncated chunk */
+					p = end;
+				}
+				
+				i = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+				memcpy(index + i * 4, px, 4);
+			}
+			
+			/* pixels past a truncated stream repeat the last one */
+			memcpy(out, px, 4);
+			out += 4;
+		}
+		
+		/* premultiplied by the pixel conversion kernels */
+		danteConvertBand(surface, (int)y, (int)rows, rgba, (int)w * 4, UDESK_RGBA);
+		danteStreamBand(stream, file, (int)(y + rows), data + start, data + p, false);
+	}
+	
+	free(rgba);
+	return danteImageConverted(file, surface, dst);
+}
+
+#ifdef DANTE_HAVE_SDL_IMAGE
+
+static UDenum danteDecodeSDLImage(DanteImageFile* file, DanteImage* dst, DanteStream* stream)
+{
+	return danteDecodeSurface(file, IMG_Load_RW(SDL_RWFromConstMem(file->data, (int)file->length), 1), dst);
+}
+
+#endif /* DANTE_HAVE_SDL_IMAGE */
+
+UDenum DANTEAPIENTRY danteDecodeImage(const char* name, DanteImage* dst, DanteStream* stream)
+{
+	DanteImageFile file;
+	UDint i;
+	
+	if (!danteMapFile(name, &file)) {
+		return UDESK_OPERATION_FAILED;
+	}
+	
+	for (i = dante_num_decoders; i-- > 0;) {
+		if (dante_decoders[i]->sniff(&file, name)) {
+			return dante_decoders[i]->decode(&file, dst, stream);
+		}
+	}
+	
+	danteUnmapFile(file.data, file.length);
+	return UDESK_OPERATION_FAILED;
+}
+
+UDenum DANTEAPIENTRY danteShareImage(DanteImage* image, DantePixels** dst)
+{
+	if (image->mapping && image->id.size != 0) {
+		/* the same file mapped again holds the same pixels */
+		*dst = danteShareMapped(image->surface, image->mapping, image->mapped, &image->id);
+		return (*dst)? UDESK_NO_ERROR : UDESK_OUT_OF_MEMORY;
+	}
+	
+	*dst = danteShareHashed(image->surface, image->hash);
+	if (!*dst || (*dst)->refs > 1) {
+		/* out of memory, or identical pixels were loaded already */
+		if (image->mapping) {
+			danteUnmapFile(image->mapping, image->mapped);
+		}
+		
+		return (*dst)? UDESK_NO_ERROR : UDESK_OUT_OF_MEMORY;
+	}
+	
+	(*dst)->mapping = image->mapping;
+	(*dst)->mapped = image->mapped;
+	return UDESK_NO_ERROR;
+}
+
+void DANTEAPIENTRY danteDiscardImage(DanteImage* image)
+{
+	SDL_FreeSurface(image->surface);
+	if (image->mapping) {
+		danteUnmapFile(image->mapping, image->mapped);
+	}
+}
+
+static void danteHashImage(DanteImage* image)
+{
+	image->hash = 0;
+	if (!image->mapping || image->id.size == 0) {
+		image->hash = danteHashPixels(image->surface);
+	}
+}
+
+UDenum DANTEAPIENTRY danteLoadImage(const char* name, DantePixels** dst)
+{
+	DanteImage image;
+	UDenum err;
+	
+	err = danteDecodeImage(name, &image, NULL);
+	if (err != UDESK_NO_ERROR) {
+		return err;
+	}
+	
+	danteHashImage(&image);
+	return danteShareImage(&image, dst);
+}
+
+static void danteDecodeNotify(void)
+{
+	SDL_Event ev;
+	
+	/* SDL_PushEvent() is thread safe, every decoded load is
+	 * completed by the first event handled
+	 */
+	if (dante_context->decode_event != (Uint32)-1) {
+		memset(&ev, 0, sizeof(ev));
+		ev.type = dante_context->decode_event;
+		SDL_PushEvent(&ev);
+	}
+}
+
+static void danteDecodeJob(DanteBackgroundJob* job)
+{
+	DanteDecode* decode = (DanteDecode*)job;
+	Uint64 start;
+	
+	start = SDL_GetPerformanceCounter();
+	decode->error = danteDecodeImage(decode->name, &decode->image, (decode->progressive)? &decode->stream : NULL);
+	if (decode->error == UDESK_NO_ERROR && !decode->stream.buffer) {
+		/* the event loop only looks the pixels up */
+		danteHashImage(&decode->image);
+	}
+	
+	decode->time = SDL_GetPerformanceCounter() - start;
+	decode->stamp = SDL_GetTicks();
+	SDL_AtomicSet(&decode->done, 1);
+	danteDecodeNotify();
+}
+
+UDboolean DANTEAPIENTRY danteLoadImageAsync(DanteObject* obj, const char* name, UDboolean progressive)
+{
+	DanteDecode* decode;
+	size_t len = strlen(name);
+	
+	decode = (DanteDecode*)malloc(sizeof(*decode) + len + 1);
+	if (!decode) {
+		return false;
+	}
+	
+	memcpy(decode + 1, name, len + 1);
+	decode->job.run = danteDecodeJob;
+	decode->pixmap = obj;
+	decode->name = (const char*)(decode + 1);
+	SDL_AtomicSet(&decode->done, 0);
+	decode->progressive = progressive;
+	decode->stream.buffer = NULL;
+	SDL_AtomicSet(&decode->stream.rows, 0);
+	decode->stream.shown = 0;
+	decode->next = dante_context->decodes;
+	dante_context->decodes = decode;
+	dante_context->num_decodes++;
+	
+	dantePixmapAttach(obj, NULL);
+	obj->d.pix.loading = decode;
+	if (dante_context->decode_event == (Uint32)-1) {
+		/* no completion event, load on submission instead */
+		danteDecodeJob(&decode->job);
+		danteHandleDecodeEvent();
+		return true;
+	}
+	
+	danteRunBackground(&decode->job);
+	return true;
+}
+
+static UDboolean danteStreamShow(DanteDecode* decode)
+{
+	DanteStream* stream = &decode->stream;
+	DanteObject* obj = decode->pixmap;
+	DanteTexture* entry;
+	SDL_Surface* pixels;
+	SDL_Rect rect;
+	SDL_Rect part;
+	int rows;
+	
+	/* the buffer is set before any row is published */
+	rows = SDL_AtomicGet(&stream->rows);
+	if (rows <= stream->shown) {
+		return false;
+	}
+	
+	pixels = stream->buffer->surface;
+	if (obj->d.pix.buffer != stream->buffer) {
+		/* the pixmap takes a reference of its own, the load stays
+		 * pending, textures created meanwhile only upload the rows
+		 * shown so far, and layers draw them unscaled
+		 */
+		stream->buffer->refs++;
+		dantePixmapAttach(obj, stream->buffer);
+		obj->d.pix.loading = decode;
+		decode->pixmap = obj;
+	}
+	
+	rect.x = 0;
+	rect.y = stream->shown;
+	rect.w = pixels->w;
+	rect.h = rows - stream->shown;
+	stream->shown = rows;
+	dantePixmapUpdate(obj, &rect);
+	danteReleaseRows(stream->buffer, rect.y, rows);
+	for (entry = obj->d.pix.textures; entry; entry = entry->next) {
+		if (SDL_IntersectRect(&rect, &entry->area, &part)) {
+			part.x -= entry->area.x;
+			part.y -= entry->area.y;
+			danteDamageTexture(entry->win, entry->tex, &part, entry->area.w, entry->area.h);
+		}
+	}
+	
+	return true;
+}
+
+void DANTEAPIENTRY danteHandleDecodeEvent(void)
+{
+	DanteDecode* done = NULL;
+	DanteDecode* decode;
+	DanteDecode** link;
+	DantePixels* buffer;
+	DanteObject* obj;
+	SDL_Event sev;
+	
+	/* progressive loads are freed below only, handlers may cancel
+	 * them or queue new ones meanwhile
+	 */
+	for (decode = dante_context->decodes; decode; decode = decode->next) {
+		if (!decode->pixmap || !decode->progressive || SDL_AtomicGet(&decode->done) || !danteStreamShow(decode)) {
+			continue;
+		}
+		
+		memset(&sev, 0, sizeof(sev));
+		sev.type = dante_context->decode_event;
+		sev.user.timestamp = SDL_GetTicks();
+		
+		danteGenerateFrom(&sev, UDESK_EVENT_PROGRESS_EXT);
+		dantePropagateEvent(DANTE_PROGRESS_DISPATCH_ID, NULL, decode->pixmap);
+		danteFinishEvent();
+	}
+	
+	/* detach decoded loads first, handlers may queue new ones */
+	link = &dante_context->decodes;
+	while ((decode = *link) != NULL) {
+		if (!SDL_AtomicGet(&decode->done)) {
+			link = &decode->next;
+			continue;
+		}
+		
+		*link = decode->next;
+		decode->next = done;
+		done = decode;
+		dante_context->num_decodes--;
+		dante_context->decode_time += decode->time;
+		dante_context->decoded++;
+	}
+	
+	while (done) {
+		decode = done;
+		done = decode->next;
+		obj = decode->pixmap;
+		buffer = decode->stream.buffer;
+		if (!obj) {
+			/* cancelled meanwhile */
+			if (buffer) {
+				danteReleasePixels(buffer);
+			} else if (decode->error == UDESK_NO_ERROR) {
+				danteDiscardImage(&decode->image);
+			}
+			
+			free(decode);
+			continue;
+		}
+		
+		if (buffer) {
+			/* the image owns no pixels, the stream buffer does */
+			if (decode->error == UDESK_NO_ERROR) {
+				danteStreamShow(decode);
+			}
+			
+			obj->d.pix.loading = NULL;
+			if (decode->error != UDESK_NO_ERROR && obj->d.pix.buffer == buffer) {
+				dantePixmapAttach(obj, NULL);
+			}
+			
+			/* layers may scale the complete pixels now */
+			danteInvalidateLayers(obj);
+			
+			danteReleasePixels(buffer);
+		} else {
+			obj->d.pix.loading = NULL;
+			if (decode->error == UDESK_NO_ERROR) {
+				decode->error = danteShareImage(&decode->image, &buffer);
+				if (decode->error == UDESK_NO_ERROR) {
+					dantePixmapAttach(obj, buffer);
+				}
+			}
+		}
+		if (decode->error == UDESK_NO_ERROR) {
+			danteAtlasAdd(obj);
+		}
+		
+		/* the error is reported as the event code */
+		memset(&sev, 0, sizeof(sev));
+		sev.type = dante_context->decode_event;
+		sev.user.timestamp = decode->stamp;
+		sev.user.code = (Sint32)decode->error;
+		free(decode);
+		
+		danteGenerateFrom(&sev, UDESK_EVENT_LOAD_EXT);
+		dantePropagateEvent(DANTE_LOAD_DISPATCH_ID, NULL, obj);
+		danteFinishEvent();
+	}
+}
+
+void DANTEAPIENTRY danteDestroyDecodes(void)
+{
+	DanteDecode* decode;
+	
+	while (dante_context->decodes) {
+		decode = dante_context->decodes;
+		dante_context->decodes = decode->next;
+		if (decode->stream.buffer) {
+			danteReleasePixels(decode->stream.buffer);
+		} else if (SDL_AtomicGet(&decode->done) && decode->error == UDESK_NO_ERROR) {
+			danteDiscardImage(&decode->image);
+		}
+		if (decode->pixmap) {
+			decode->pixmap->d.pix.loading = NULL;
+		}
+		
+		free(decode);
+	}
+	
+	dante_context->num_decodes = 0;
+}
+
+void DANTEAPIENTRY danteInitImage(void)
+{
+	size_t i;
+	
+#ifdef DANTE_HAVE_SDL_IMAGE
+	/* loaders are initialized lazily otherwise, not thread safe */
+	IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG | IMG_INIT_WEBP);
+#endif
+	
+	/* decoders registered for an earlier context are forgotten */
+	dante_num_decoders = 0;
+	for (i = 0; i < DANTE_ARRAY_SIZE(dante_builtin_decoders); i++) {
+		danteRegisterDecoder(&dante_builtin_decoders[i]);
+	}
+}
+
+UDboolean DANTEAPIENTRY danteRegisterDecoder(const DanteDecoder* decoder)
+{
+	if (dante_num_decoders == DANTE_MAX_DECODERS) {
+		return false;
+	}
+	
+	dante_decoders[dante_num_decoders++] = decoder;
+	return true;
+}
+
+void DANTEAPIENTRY danteQuitImage(void)
+{
+#ifdef DANTE_HAVE_SDL_IMAGE
+	IMG_Quit();
+#endif
+}
+
+UDint DANTEAPIENTRY danteNumDecoders(void)
+{
+	return dante_num_decoders;
+}
+
+const char* UDESKAPIENTRY udeskQueryFileFormatEXT(UDint index)
+{
+	if (index < 0 || index >= dante_num_decoders) {
+		return NULL;
+	}
+	
+	/* strongest signatures first, as sniffed */
+	return dante_decoders[dante_num_decoders - 1 - index]->name;
+}
@@ -0,0 +1,196 @@
+/* input.c: Keyboard, mouse and touch input handling.
+ *
+ * Translates SDL input events to udesk events, keeping track of
+ * the key and button state for the current context.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+
+/* Sets or clears the key state bit for keycode 'code', out of range
+ * keycodes are silently ignored.
+ */
+static void danteSetKeyState(UDint code, UDboolean down);
+/* Returns the dante window object that should receive a touch event,
+ * NULL if none could be found.
+ */
+static DanteObject* danteGetTouchWindow(const SDL_TouchFingerEvent* ev);
+
+static void danteSetKeyState(UDint code, UDboolean down)
+{
+	Uint32 bit;
+	
+	if (code <= UDESK_KEYCODE_NONE || code >= DANTE_KEYCODE_COUNT) {
+		return;
+	}
+	
+	bit = (Uint32)1 << (code & 31);
+	if (down) {
+		dante_context->keys[code >> 5] |= bit;
+	} else {
+		dante_context->keys[code >> 5] &= ~bit;
+	}
+}
+
+static DanteObject* danteGetTouchWindow(const SDL_TouchFingerEvent* ev)
+{
+	SDL_Window* win;
+	
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	if (ev->windowID != 0) {
+		return danteGetObjectFromWindowID(ev->windowID);
+	}
+#endif
+	/* touch devices not bound to a window (or older SDL), deliver to
+	 * the window having mouse focus.
+	 */
+	win = SDL_GetMouseFocus();
+	if (!win) {
+		return NULL;
+	}
+	
+	return danteGetObjectFromWindowID(SDL_GetWindowID(win));
+}
+
+UDint DANTEAPIENTRY danteTranslateScancode(SDL_Scancode code)
+{
+	if (code >= SDL_SCANCODE_F1 && code <= SDL_SCANCODE_F12) {
+		return UDESK_KEYCODE_F1 + (code - SDL_SCANCODE_F1);
+	}
+	if (code >= SDL_SCANCODE_F13 && code <= SDL_SCANCODE_F16) {
+		return UDESK_KEYCODE_F13 + (code - SDL_SCANCODE_F13);
+	}
+	
+	return DANTE_KEYCODE_BASE + (UDint)code;
+}
+
+UDint DANTEAPIENTRY danteTranslateButton(Uint8 button)
+{
+	/* SDL buttons start from 1 (SDL_BUTTON_LEFT), udesk ones from
+	 * UDESK_CLICK_BUTTON0, left, middle and right buttons share
+	 * the same ordering.
+	 */
+	if (button < 1 || button > UDESK_CLICK_BUTTON31 - UDESK_CLICK_BUTTON0 + 1) {
+		return UDESK_KEYCODE_NONE;
+	}
+	
+	return UDESK_CLICK_BUTTON0 + (button - 1);
+}
+
+UDint DANTEAPIENTRY danteTranslateModifiers(Uint16 mod)
+{
+	UDint ret = 0;
+	
+	if (mod & KMOD_SHIFT) {
+		ret |= UDESK_MODIFIER_SHIFT_EXT;
+	}
+	if (mod & KMOD_CTRL) {
+		ret |= UDESK_MODIFIER_CTRL_EXT;
+	}
+	if (mod & KMOD_ALT) {
+		ret |= UDESK_MODIFIER_ALT_EXT;
+	}
+	if (mod & KMOD_GUI) {
+		ret |= UDESK_MODIFIER_SUPER_EXT;
+	}
+	if (mod & KMOD_CAPS) {
+		ret |= UDESK_MODIFIER_CAPS_EXT;
+	}
+	if (mod & KMOD_NUM) {
+		ret |= UDESK_MODIFIER_NUM_EXT;
+	}
+	
+	return ret;
+}
+
+void DANTEAPIENTRY danteHandleInputEvent(const SDL_Event* ev)
+{
+	DanteObject* to;
+	DanteDispatchID id;
+	UDenum type;
+	
+	switch (ev->type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		danteSetKeyState(danteTranslateScancode(ev->key.keysym.scancode), ev->key.state == SDL_PRESSED);
+		dante_context->modifiers = danteTranslateModifiers(ev->key.keysym.mod);
+		to = danteGetObjectFromWindowID(ev->key.windowID);
+		id = DANTE_KEY_DISPATCH_ID;
+		type = UDESK_EVENT_KEYBOARD;
+		break;
+	
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		danteSetKeyState(danteTranslateButton(ev->button.button), ev->button.state == SDL_PRESSED);
+		to = danteGetObjectFromWindowID(ev->button.windowID);
+		id = DANTE_BUTTON_DISPATCH_ID;
+		type = (ev->type == SDL_MOUSEBUTTONDOWN)? UDESK_EVENT_PRESS : UDESK_EVENT_RELEASE;
+		break;
+	
+	case SDL_MOUSEMOTION:
+		to = danteGetObjectFromWindowID(ev->motion.windowID);
+		id = DANTE_MOTION_DISPATCH_ID;
+		type = UDESK_EVENT_MOTION;
+		break;
+	
+	case SDL_FINGERDOWN:
+	case SDL_FINGERUP:
+	case SDL_FINGERMOTION:
+		to = danteGetTouchWindow(&ev->tfinger);
+		id = DANTE_TOUCH_DISPATCH_ID;
+		type = UDESK_EVENT_TOUCH;
+		break;
+	
+	default:
+		/* not an input event */
+		return;
+	}
+	
+	if (!to) {
+		/* input for an unknown window, state is updated anyway */
+		return;
+	}
+	
+	danteGenerateFrom(ev, type);
+	dantePropagateEvent(id, NULL, to);
+	danteFinishEvent();
+}
+
+UDboolean UDESKAPIENTRY udeskGetKeyStateEXT(UDint keycode)
+{
+	DANTE_IGNORE_AND_RETVAL_IF(!dante_context, false);
+	DANTE_ERROR_AND_RETVAL_IF(keycode <= UDESK_KEYCODE_NONE || keycode >= DANTE_KEYCODE_COUNT, UDESK_INVALID_VALUE, false);
+	
+	return DANTE_BOOL(dante_context->keys[keycode >> 5] & ((Uint32)1 << (keycode & 31)));
+}
+
+UDint UDESKAPIENTRY udeskGetModifiersEXT(void)
+{
+	DANTE_IGNORE_AND_RETVAL_IF(!dante_context, 0);
+	
+	return dante_context->modifiers;
+}
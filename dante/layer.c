@@ -0,0 +1,517 @@
+/* layer.c: Layer objects and scaled pixels cache.
+ *
+ * Layers reference a pixmap and keep its pixels scaled to the
+ * requested size, scaled pixels are computed again whenever the
+ * pixmap pixels are replaced.
+ * Scaled pixels are shared between layers through a context wide
+ * hash table keyed by source pixel buffer, size and filter, so that
+ * pixmaps sharing their pixels share scaled pixels as well, entries
+ * no layer uses are kept up to a budget.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <stdlib.h>
+
+/* Layer virtual table handlers. */
+static void danteLayerClear(DanteObject* obj);
+/* Layer event handlers. */
+static void danteLayerDrawHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+/* Releases the scaled pixels of 'layer', if any. */
+static void danteLayerDiscard(DanteLayerObject* layer);
+/* Returns the hash bucket of the given scaled pixels key. */
+static DanteScaled** danteScaledBucket(const DantePixels* source, int w, int h, UDenum filter);
+/* Removes 'entry' from the LRU list. */
+static void danteScaledUnlink(DanteScaled* entry);
+/* Removes 'entry' from the hash table and frees it, 'entry' must
+ * not be linked to the LRU list.
+ */
+static void danteScaledFree(DanteScaled* entry);
+/* Returns the 'source' pixels scaled to 'w' x 'h' with 'filter',
+ * sharing them if already computed, NULL if out of memory.
+ */
+static DanteScaled* danteScaledAcquire(DantePixels* source, int w, int h, UDenum filter);
+/* Stops using 'entry', keeping it for reuse within the budget. */
+static void danteScaledRelease(DanteScaled* entry);
+/* Computes the scaled size of 'layer' for 'src' pixels. */
+static void danteLayerSize(const DanteLayerObject* layer, const SDL_Surface* src, int* w, int* h);
+/* Returns the placeholder pixels drawn by 'layer' while its pixmap
+ * is loading, stretched to the requested size, NULL if out of memory.
+ */
+static SDL_Surface* danteLayerPlaceholder(DanteLayerObject* layer);
+
+static DanteScaled** danteScaledBucket(const DantePixels* source, int w, int h, UDenum filter)
+{
+	/* buffers are unique by address, their pixels may be private */
+	Uint32 hash = (Uint32)((size_t)source / sizeof(*source));
+	
+	hash = hash * 31 + (Uint32)w;
+	hash = hash * 31 + (Uint32)h;
+	hash = hash * 31 + (Uint32)filter;
+	return &dante_context->scaled[(hash ^ (hash >> 16)) & (DANTE_SCALED_BUCKETS - 1)];
+}
+
+static void danteScaledUnlink(DanteScaled* entry)
+{
+	entry->lru_prev->lru_next = entry->lru_next;
+	entry->lru_next->lru_prev = entry->lru_prev;
+	entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void danteScaledFree(DanteScaled* entry)
+{
+	DanteScaled** link;
+	
+	if (entry->source) {
+		link = danteScaledBucket(entry->source, entry->pixels->w, entry->pixels->h, entry->filter);
+		for (; *link != entry; link = &(*link)->next);
+		
+		*link = entry->next;
+	}
+	
+	danteEvictTextures(&entry->textures);
+	dante_context->scaled_bytes -= entry->bytes;
+	SDL_FreeSurface(entry->pixels);
+	free(entry);
+}
+
+static DanteScaled* danteScaledAcquire(DantePixels* source, int w, int h, UDenum filter)
+{
+	DanteScaled** bucket = danteScaledBucket(source, w, h, filter);
+	DanteScaled* entry;
+	
+	for (entry = *bucket; entry; entry = entry->next) {
+		if (entry->source == source && entry->pixels->w == w && entry->pixels->h == h && entry->filter == filter) {
+			if (entry->refs++ == 0) {
+				danteScaledUnlink(entry);
+			}
+			
+			return entry;
+		}
+	}
+	
+	entry = (DanteScaled*)malloc(sizeof(*entry));
+	if (!entry) {
+		return NULL;
+	}
+	
+	entry->pixels = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, DANTE_PIXMAP_FORMAT);
+	if (!entry->pixels || !danteScaleSurface(entry->pixels, source->surface, filter)) {
+		if (entry->pixels) {
+			SDL_FreeSurface(entry->pixels);
+		}
+		
+		free(entry);
+		return NULL;
+	}
+	
+	entry->source = source;
+	entry->filter = filter;
+	entry->bytes = (Uint32)w * (Uint32)h * 4;
+	entry->refs = 1;
+	entry->textures = NULL;
+	entry->lru_prev = entry->lru_next = NULL;
+	entry->next = *bucket;
+	*bucket = entry;
+	dante_context->scaled_bytes += entry->bytes;
+	return entry;
+}
+
+static void danteScaledRelease(DanteScaled* entry)
+{
+	DanteScaled* head = &dante_context->scaled_lru;
+	
+	if (--entry->refs > 0) {
+		return;
+	}
+	if (!entry->source) {
+		/* source pixels are gone, nobody may find it again */
+		danteScaledFree(entry);
+		return;
+	}
+	
+	entry->lru_prev = head;
+	entry->lru_next = head->lru_next;
+	head->lru_next->lru_prev = entry;
+	head->lru_next = entry;
+	
+	/* used entries count towards the resident size, never evict them */
+	while (dante_context->scaled_bytes > dante_context->scaled_budget && head->lru_prev != head) {
+		entry = head->lru_prev;
+		danteScaledUnlink(entry);
+		danteScaledFree(entry);
+	}
+}
+
+static void danteLayerDiscard(DanteLayerObject* layer)
+{
+	if (layer->scaled) {
+		danteScaledRelease(layer->scaled);
+		layer->scaled = NULL;
+	}
+}
+
+static void danteLayerClear(DanteObject* obj)
+{
+	DanteLayerObject* layer = &obj->d.layer;
+	DanteObject** link;
+	
+	danteLayerDiscard(layer);
+	if (layer->pixmap) {
+		for (link = &layer->pixmap->d.pix.layers; *link != obj; link = &(*link)->d.layer.layer_next);
+		
+		*link = layer->layer_next;
+		layer->layer_next = NULL;
+		danteUnrefObject(layer->pixmap);
+		layer->pixmap = NULL;
+	}
+}
+
+static void danteLayerDrawHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DanteLayerObject* layer = &obj->d.layer;
+	DanteObject* win = danteGetObjectWindow(obj);
+	SDL_Surface* pixels;
+	DanteTexture** textures;
+	SDL_Rect src;
+	SDL_Rect dst;
+	int w, h;
+	
+	if (layer->pixmap && layer->pixmap->d.pix.loading && layer->pixmap->d.pix.pixels) {
+		/* rows are still being decoded, the pixmap textures only hold
+		 * the shown ones, the renderer scales them until the load completes
+		 */
+		pixels = layer->pixmap->d.pix.pixels;
+		textures = NULL;
+		w = pixels->w;
+		h = pixels->h;
+		if (layer->width != 0) {
+			danteLayerSize(layer, pixels, &w, &h);
+		}
+	} else {
+		pixels = danteLayerPixels(obj);
+		if (!pixels) {
+			return;
+		}
+		if (!layer->scaled) {
+			/* pixmap pixels, possibly packed in an atlas */
+			dantePixmapDraw(layer->pixmap, win, &obj->area);
+			return;
+		}
+		
+		/* scaled pixels are shared, and so are their textures */
+		textures = &layer->scaled->textures;
+		w = pixels->w;
+		h = pixels->h;
+		if (layer->width == 0) {
+			/* placeholder of an unscaled layer, stretched over it */
+			w = obj->area.w;
+			h = obj->area.h;
+		}
+	}
+	if (w < 1 || h < 1) {
+		return;
+	}
+	
+	/* top left aligned, cropped to the layer area */
+	dst.x = obj->area.x;
+	dst.y = obj->area.y;
+	dst.w = SDL_min(w, obj->area.w);
+	dst.h = SDL_min(h, obj->area.h);
+	src.x = 0;
+	src.y = 0;
+	src.w = (int)((long)pixels->w * dst.w / w);
+	src.h = (int)((long)pixels->h * dst.h / h);
+	if (textures) {
+		danteDrawTiles(win, textures, pixels, pixels->h, &src, &dst);
+	} else {
+		dantePixmapCopy(layer->pixmap, win, &src, &dst);
+	}
+}
+
+static void danteLayerSize(const DanteLayerObject* layer, const SDL_Surface* src, int* w, int* h)
+{
+	*w = layer->width;
+	*h = layer->height;
+	if (!layer->keep_aspect) {
+		return;
+	}
+	
+	/* fit inside the requested size */
+	if ((double)src->w * layer->height > (double)src->h * layer->width) {
+		*h = (int)((double)src->h * layer->width / src->w + 0.5);
+	} else {
+		*w = (int)((double)src->w * layer->height / src->h + 0.5);
+	}
+	if (*w < 1) {
+		*w = 1;
+	}
+	if (*h < 1) {
+		*h = 1;
+	}
+}
+
+UDboolean DANTEAPIENTRY danteLayerInit(DanteObject* obj)
+{
+	static const DanteVTable layer_table = {
+		NULL, /* no handlers */
+		NULL, /* no begin */
+		NULL, /* no end */
+		NULL, /* nothing to flush */
+		NULL, /* nothing to submit */
+		danteLayerClear,
+		NULL /* cheap teardown */
+	};
+	static const DanteEventDispatch dispatch_table = {
+		NULL, /* enter */
+		NULL, /* leave */
+		NULL, /* focus */
+		danteLayerDrawHandler,
+		NULL, /* destroy */
+		NULL, /* key */
+		NULL, /* button */
+		NULL, /* motion */
+		NULL, /* touch */
+		NULL, /* flushed */
+		NULL, /* loaded */
+		NULL /* progress */
+	};
+	
+	DanteLayerObject* layer = &obj->d.layer;
+	
+	layer->pixmap = NULL;
+	layer->scaled = NULL;
+	layer->width = 0;
+	layer->height = 0;
+	layer->keep_aspect = false;
+	layer->filter = UDESK_FASTEST;
+	layer->layer_next = NULL;
+	obj->vt = &layer_table;
+	obj->dispatch = &dispatch_table;
+	return true;
+}
+
+static SDL_Surface* danteLayerPlaceholder(DanteLayerObject* layer)
+{
+	DantePixels* source = dante_context->placeholder;
+	SDL_Surface* surface;
+	Uint8* p;
+	int w, h;
+	
+	if (!source) {
+		surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, DANTE_PIXMAP_FORMAT);
+		if (!surface) {
+			return NULL;
+		}
+		
+		/* translucent gray, premultiplied */
+		p = (Uint8*)surface->pixels;
+		p[0] = p[1] = p[2] = 0x40;
+		p[3] = 0x80;
+		source = danteSharePixels(surface, false);
+		if (!source) {
+			return NULL;
+		}
+		
+		dante_context->placeholder = source;
+	}
+	if (layer->scaled && layer->scaled->source == source) {
+		return layer->scaled->pixels;
+	}
+	
+	/* the image size is unknown yet, fill the whole requested area,
+	 * unscaled layers stretch the pixels when drawing, so that their
+	 * textures are cached like scaled ones
+	 */
+	w = (layer->width == 0)? source->surface->w : layer->width;
+	h = (layer->width == 0)? source->surface->h : layer->height;
+	danteLayerDiscard(layer);
+	layer->scaled = danteScaledAcquire(source, w, h, UDESK_FASTEST);
+	return (layer->scaled)? layer->scaled->pixels : NULL;
+}
+
+SDL_Surface* DANTEAPIENTRY danteLayerPixels(DanteObject* obj)
+{
+	DanteLayerObject* layer = &obj->d.layer;
+	SDL_Surface* src;
+	int w, h;
+	
+	if (layer->pixmap && layer->pixmap->d.pix.loading) {
+		/* streamed rows are still being written, never scale them */
+		return danteLayerPlaceholder(layer);
+	}
+	if (!layer->pixmap || !layer->pixmap->d.pix.pixels) {
+		return NULL;
+	}
+	
+	src = layer->pixmap->d.pix.pixels;
+	if (layer->width == 0) {
+		/* drop the placeholder, if any */
+		danteLayerDiscard(layer);
+		return src;
+	}
+	if (layer->scaled && layer->scaled->source == layer->pixmap->d.pix.buffer) {
+		/* entries are forgotten as soon as their source changes */
+		return layer->scaled->pixels;
+	}
+	
+	danteLayerDiscard(layer);
+	danteLayerSize(layer, src, &w, &h);
+	layer->scaled = danteScaledAcquire(layer->pixmap->d.pix.buffer, w, h, layer->filter);
+	return (layer->scaled)? layer->scaled->pixels : NULL;
+}
+
+void DANTEAPIENTRY danteForgetScaled(DantePixels* source)
+{
+	DanteScaled* entry;
+	DanteScaled* next;
+	DanteScaled** link;
+	UDint i;
+	
+	for (i = 0; i < DANTE_SCALED_BUCKETS; i++) {
+		link = &dante_context->scaled[i];
+		for (entry = *link; entry; entry = next) {
+			next = entry->next;
+			if (entry->source != source) {
+				link = &entry->next;
+				continue;
+			}
+			
+			/* unhash, layers still using it let it go later */
+			*link = next;
+			entry->source = NULL;
+			if (entry->refs == 0) {
+				danteScaledUnlink(entry);
+				danteScaledFree(entry);
+			}
+		}
+	}
+}
+
+void UDESKAPIENTRY udeskLayerPixmap(UDhandle layer, UDhandle pixmap)
+{
+	DanteObject* obj = danteRetrieveObject(layer, UDESK_HANDLE_LAYER);
+	
+	if (obj) {
+		DanteObject* pix = NULL;
+		
+		if (pixmap != UDESK_HANDLE_NONE) {
+			pix = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+			if (!pix) {
+				return;
+			}
+		}
+		
+		/* reference first, the pixmap may be the same */
+		danteRefObject(pix);
+		danteLayerClear(obj);
+		obj->d.layer.pixmap = pix;
+		if (pix) {
+			obj->d.layer.layer_next = pix->d.pix.layers;
+			pix->d.pix.layers = obj;
+		}
+		
+		danteInvalidateObject(obj);
+	}
+}
+
+void UDESKAPIENTRY udeskLayerScale(UDhandle layer, UDint width, UDint height, UDboolean keep_aspect)
+{
+	DanteObject* obj = danteRetrieveObject(layer, UDESK_HANDLE_LAYER);
+	
+	if (obj) {
+		DanteLayerObject* lay = &obj->d.layer;
+		
+		DANTE_ERROR_IF(width < 1 || height < 1 || width > DANTE_IMAGE_MAX || height > DANTE_IMAGE_MAX, UDESK_INVALID_VALUE);
+		
+		danteLayerDiscard(lay);
+		lay->width = width;
+		lay->height = height;
+		lay->keep_aspect = keep_aspect;
+		danteInvalidateObject(obj);
+		
+		/* scale now, rather than on first use */
+		if (lay->pixmap && lay->pixmap->d.pix.pixels) {
+			DANTE_ERROR_IF(!danteLayerPixels(obj), UDESK_OUT_OF_MEMORY);
+		}
+	}
+}
+
+void UDESKAPIENTRY udeskSetLayeriv(UDhandle layer, UDenum param, const UDint* to)
+{
+	DanteObject* obj = danteRetrieveObject(layer, UDESK_HANDLE_LAYER);
+	
+	if (obj) {
+		DANTE_ERROR_IF(!to, UDESK_INVALID_VALUE);
+		
+		switch (param) {
+		case UDESK_LAYER_FILTER_HINT:
+			DANTE_ERROR_IF(to[0] != UDESK_FASTEST && to[0] != UDESK_NICEST, UDESK_INVALID_ENUM);
+			if (obj->d.layer.filter != (UDenum)to[0]) {
+				/* scaled again on next use */
+				obj->d.layer.filter = to[0];
+				danteLayerDiscard(&obj->d.layer);
+				danteInvalidateObject(obj);
+			}
+			
+			break;
+		
+		default:
+			dante_context->error = UDESK_INVALID_ENUM;
+			break;
+		}
+	}
+}
+
+void UDESKAPIENTRY udeskSetLayeri(UDhandle layer, UDenum param, UDint to)
+{
+	udeskSetLayeriv(layer, param, &to);
+}
+
+void UDESKAPIENTRY udeskGetLayeriv(UDhandle layer, UDenum param, UDint* dst)
+{
+	DanteObject* obj = danteRetrieveObject(layer, UDESK_HANDLE_LAYER);
+	
+	if (obj) {
+		DANTE_ERROR_IF(!dst, UDESK_INVALID_VALUE);
+		
+		switch (param) {
+		case UDESK_LAYER_FILTER_HINT:
+			dst[0] = obj->d.layer.filter;
+			break;
+		
+		default:
+			dante_context->error = UDESK_INVALID_ENUM;
+			break;
+		}
+	}
+}
+
+UDboolean UDESKAPIENTRY udeskIsLayer(UDhandle handle)
+{
+	return danteCheckObjectType(handle, UDESK_HANDLE_LAYER);
+}
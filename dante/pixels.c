@@ -0,0 +1,249 @@
+/* pixels.c: Shared pixel buffers.
+ *
+ * Pixmap pixels live in reference counted buffers, identical
+ * pixels loaded into different pixmaps are found by content hash
+ * and share a single buffer. Shared buffers are never modified,
+ * writing to a pixmap gives it a private copy first.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Returns true if 'a' and 'b' hold the same pixels. */
+static UDboolean danteSameSurface(const SDL_Surface* a, const SDL_Surface* b);
+/* Removes the shared 'buffer' from the context hash table, making it
+ * private.
+ */
+static void danteUnlinkPixels(DantePixels* buffer);
+/* Returns true if 'a' and 'b' identify the same file. */
+static UDboolean danteSameFile(const DanteFileID* a, const DanteFileID* b);
+
+Uint32 DANTEAPIENTRY danteHashPixels(const SDL_Surface* surface)
+{
+	Uint32 hash = 2166136261u;
+	int x, y;
+	
+	/* FNV-1a over 32 bits words, rows padding excluded */
+	hash = (hash ^ (Uint32)surface->w) * 16777619u;
+	hash = (hash ^ (Uint32)surface->h) * 16777619u;
+	for (y = 0; y < surface->h; y++) {
+		const Uint32* row = (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+		
+		for (x = 0; x < surface->w; x++) {
+			hash = (hash ^ row[x]) * 16777619u;
+		}
+	}
+	
+	return hash;
+}
+
+static UDboolean danteSameSurface(const SDL_Surface* a, const SDL_Surface* b)
+{
+	int y;
+	
+	if (a->w != b->w || a->h != b->h) {
+		return false;
+	}
+	
+	for (y = 0; y < a->h; y++) {
+		if (memcmp((const Uint8*)a->pixels + y * a->pitch, (const Uint8*)b->pixels + y * b->pitch, a->w * 4) != 0) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+DantePixels* DANTEAPIENTRY danteSharePixels(SDL_Surface* surface, UDboolean share)
+{
+	DantePixels* buffer;
+	
+	if (share) {
+		return danteShareHashed(surface, danteHashPixels(surface));
+	}
+	
+	buffer = (DantePixels*)malloc(sizeof(*buffer));
+	if (!buffer) {
+		SDL_FreeSurface(surface);
+		return NULL;
+	}
+	
+	buffer->surface = surface;
+	buffer->refs = 1;
+	buffer->hash = 0;
+	buffer->shared = false;
+	buffer->next = NULL;
+	buffer->mapping = NULL;
+	buffer->mapped = 0;
+	memset(&buffer->id, 0, sizeof(buffer->id));
+	return buffer;
+}
+
+DantePixels* DANTEAPIENTRY danteShareHashed(SDL_Surface* surface, Uint32 hash)
+{
+	DantePixels** bucket = &dante_context->buffers[hash & (DANTE_PIXELS_BUCKETS - 1)];
+	DantePixels* buffer;
+	
+	/* pixels are only compared when hashes match, buffers mapped
+	 * from a known file are hashed by its identity instead
+	 */
+	for (buffer = *bucket; buffer; buffer = buffer->next) {
+		if (buffer->hash == hash && buffer->id.size == 0 && danteSameSurface(buffer->surface, surface)) {
+			SDL_FreeSurface(surface);
+			buffer->refs++;
+			return buffer;
+		}
+	}
+	
+	buffer = danteSharePixels(surface, false);
+	if (!buffer) {
+		return NULL;
+	}
+	
+	buffer->hash = hash;
+	buffer->shared = true;
+	buffer->next = *bucket;
+	*bucket = buffer;
+	return buffer;
+}
+
+static void danteUnlinkPixels(DantePixels* buffer)
+{
+	DantePixels** link = &dante_context->buffers[buffer->hash & (DANTE_PIXELS_BUCKETS - 1)];
+	
+	for (; *link != buffer; link = &(*link)->next);
+	
+	*link = buffer->next;
+	buffer->next = NULL;
+	buffer->shared = false;
+}
+
+static UDboolean danteSameFile(const DanteFileID* a, const DanteFileID* b)
+{
+	return a->dev == b->dev && a->ino == b->ino && a->mtime == b->mtime && a->size == b->size;
+}
+
+DantePixels* DANTEAPIENTRY danteShareMapped(SDL_Surface* surface, const void* mapping, size_t mapped, const DanteFileID* id)
+{
+	DantePixels** bucket;
+	DantePixels* buffer;
+	Uint32 hash = 2166136261u;
+	
+	/* FNV-1a over the identity, the pixels are never read */
+	hash = (hash ^ (Uint32)id->dev) * 16777619u;
+	hash = (hash ^ (Uint32)id->ino) * 16777619u;
+	hash = (hash ^ (Uint32)(id->ino >> 32)) * 16777619u;
+	hash = (hash ^ (Uint32)id->mtime) * 16777619u;
+	hash = (hash ^ (Uint32)id->size) * 16777619u;
+	bucket = &dante_context->buffers[hash & (DANTE_PIXELS_BUCKETS - 1)];
+	for (buffer = *bucket; buffer; buffer = buffer->next) {
+		if (buffer->hash == hash && danteSameFile(&buffer->id, id) &&
+		    buffer->surface->w == surface->w && buffer->surface->h == surface->h) {
+			SDL_FreeSurface(surface);
+			danteUnmapFile(mapping, mapped);
+			buffer->refs++;
+			return buffer;
+		}
+	}
+	
+	buffer = danteSharePixels(surface, false);
+	if (!buffer) {
+		danteUnmapFile(mapping, mapped);
+		return NULL;
+	}
+	
+	buffer->hash = hash;
+	buffer->shared = true;
+	buffer->mapping = mapping;
+	buffer->mapped = mapped;
+	buffer->id = *id;
+	buffer->next = *bucket;
+	*bucket = buffer;
+	return buffer;
+}
+
+void DANTEAPIENTRY danteReleasePixels(DantePixels* buffer)
+{
+	if (--buffer->refs > 0) {
+		return;
+	}
+	if (buffer->shared) {
+		danteUnlinkPixels(buffer);
+	}
+	
+	danteForgetScaled(buffer);
+	SDL_FreeSurface(buffer->surface);
+	if (buffer->mapping) {
+		danteUnmapFile(buffer->mapping, buffer->mapped);
+	}
+	
+	free(buffer);
+}
+
+SDL_Surface* DANTEAPIENTRY dantePixmapWritable(DanteObject* obj)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	DantePixels* buffer = pix->buffer;
+	SDL_Surface* copy;
+	
+	if (!buffer) {
+		return NULL;
+	}
+	if (buffer->refs == 1 && !buffer->mapping) {
+		/* sole user, written in place, no longer matching its hash,
+		 * results derived from the old contents go stale
+		 */
+		if (buffer->shared) {
+			danteUnlinkPixels(buffer);
+		}
+		
+		danteForgetScaled(buffer);
+		return buffer->surface;
+	}
+	
+	/* copy on write, other users keep the old buffer, file
+	 * mappings are never written
+	 */
+	copy = SDL_ConvertSurfaceFormat(buffer->surface, DANTE_PIXMAP_FORMAT, 0);
+	if (!copy) {
+		return NULL;
+	}
+	
+	buffer = danteSharePixels(copy, false);
+	if (!buffer) {
+		return NULL;
+	}
+	
+	/* textures reference the old surface */
+	danteEvictTextures(&pix->textures);
+	danteReleasePixels(pix->buffer);
+	pix->buffer = buffer;
+	pix->pixels = buffer->surface;
+	return pix->pixels;
+}
@@ -0,0 +1,672 @@
+/* pixmap.c: Pixmap objects and texture cache.
+ *
+ * Pixmaps keep their pixels in system memory and upload them lazily
+ * as textures, one for each window renderer drawing them, split in
+ * tiles so that only the drawn areas are uploaded.
+ * Textures live in a context wide LRU cache bounded by a byte budget,
+ * evicted textures are uploaded again on demand, windows whose
+ * display list referenced them record it again from scratch.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Pixmap virtual table handlers. */
+static void dantePixmapRegisterHandler(DanteObject* obj, UDenum param, UDhandlerproc proc);
+static void dantePixmapClear(DanteObject* obj);
+/* Pixmap event handlers. */
+static void dantePixmapLoadedHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+static void dantePixmapProgressHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+/* Texture render jobs, uploading the DanteTextureUpdate 'arg' rows of
+ * a new texture tile with the renderer of the job window, and destroying
+ * the SDL_Texture 'arg'.
+ */
+static void danteTextureUploadJob(DanteRenderJob* job);
+static void danteTextureDestroyJob(DanteRenderJob* job);
+/* Inserts 'entry' at the head of the context LRU list. */
+static void danteLinkTexture(DanteTexture* entry);
+/* Removes 'entry' from the context LRU list and from its owner,
+ * leaving the texture alive.
+ */
+static void danteUnlinkTexture(DanteTexture* entry);
+/* Removes 'entry' from the cache and destroys its texture once every
+ * frame already submitted by its window completed, the window is
+ * marked stale and redrawn.
+ */
+static void danteEvictTexture(DanteTexture* entry);
+/* Texture render job, uploading the DanteTextureUpdate 'arg' area. */
+static void danteTextureUpdateJob(DanteRenderJob* job);
+/* Returns the texture of the 'tile' area of 'pixels' for the renderer
+ * of the window 'win', uploading it if it isn't linked to the 'owner'
+ * texture list, NULL on failure, setting a context error.
+ * Only the first 'rows' rows of 'pixels' are read.
+ */
+static SDL_Texture* danteCacheTile(DanteTexture** owner, SDL_Surface* pixels, int rows, DanteObject* win, const SDL_Rect* tile);
+
+/* Area of a texture tile to be uploaded, relative to the tile. */
+typedef struct DanteTextureUpdate_s {
+	DanteTexture* entry;
+	const SDL_Rect* rect;
+} DanteTextureUpdate;
+
+static void danteTextureUploadJob(DanteRenderJob* job)
+{
+	DanteTextureUpdate* upload = (DanteTextureUpdate*)job->arg;
+	DanteTexture* entry = upload->entry;
+	SDL_Surface* pixels = entry->pixels;
+	const Uint8* src = (const Uint8*)pixels->pixels + entry->area.y * pixels->pitch + entry->area.x * 4;
+	void* dst;
+	int pitch;
+	int y;
+	SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD
+	);
+	
+	if (upload->rect->h == entry->area.h) {
+		/* DANTE_PIXMAP_FORMAT is native to most renderers, no conversion */
+		entry->tex = SDL_CreateTexture(job->obj->d.win.render, pixels->format->format,
+		                               SDL_TEXTUREACCESS_STATIC, entry->area.w, entry->area.h);
+		if (entry->tex && SDL_UpdateTexture(entry->tex, NULL, src, pixels->pitch) != 0) {
+			SDL_DestroyTexture(entry->tex);
+			entry->tex = NULL;
+		}
+	} else {
+		/* rows past the uploaded ones are still being written, keep
+		 * them transparent until uploaded
+		 */
+		entry->tex = SDL_CreateTexture(job->obj->d.win.render, pixels->format->format,
+		                               SDL_TEXTUREACCESS_STREAMING, entry->area.w, entry->area.h);
+		if (entry->tex && SDL_LockTexture(entry->tex, NULL, &dst, &pitch) == 0) {
+			for (y = 0; y < entry->area.h; y++, dst = (Uint8*)dst + pitch) {
+				if (y < upload->rect->h) {
+					memcpy(dst, src + y * pixels->pitch, entry->area.w * 4);
+				} else {
+					memset(dst, 0, entry->area.w * 4);
+				}
+			}
+			
+			SDL_UnlockTexture(entry->tex);
+		} else if (entry->tex) {
+			SDL_DestroyTexture(entry->tex);
+			entry->tex = NULL;
+		}
+	}
+	if (entry->tex && SDL_SetTextureBlendMode(entry->tex, premultiplied) != 0) {
+		/* renderer without custom blending, translucent
+		 * pixels come out slightly darker
+		 */
+		SDL_SetTextureBlendMode(entry->tex, SDL_BLENDMODE_BLEND);
+	}
+}
+
+static void danteTextureDestroyJob(DanteRenderJob* job)
+{
+	SDL_DestroyTexture((SDL_Texture*)job->arg);
+}
+
+static void danteTextureUpdateJob(DanteRenderJob* job)
+{
+	DanteTextureUpdate* update = (DanteTextureUpdate*)job->arg;
+	SDL_Surface* pixels = update->entry->pixels;
+	int x = update->entry->area.x + update->rect->x;
+	int y = update->entry->area.y + update->rect->y;
+	
+	SDL_UpdateTexture(update->entry->tex, update->rect,
+	                  (Uint8*)pixels->pixels + y * pixels->pitch + x * 4, pixels->pitch);
+}
+
+static void danteLinkTexture(DanteTexture* entry)
+{
+	DanteTexture* head = &dante_context->textures;
+	
+	entry->lru_prev = head;
+	entry->lru_next = head->lru_next;
+	head->lru_next->lru_prev = entry;
+	head->lru_next = entry;
+}
+
+static void danteUnlinkTexture(DanteTexture* entry)
+{
+	DanteTexture** link;
+	
+	entry->lru_prev->lru_next = entry->lru_next;
+	entry->lru_next->lru_prev = entry->lru_prev;
+	for (link = entry->owner; *link != entry; link = &(*link)->next);
+	
+	*link = entry->next;
+	dante_context->texture_bytes -= entry->bytes;
+}
+
+static void danteEvictTexture(DanteTexture* entry)
+{
+	DanteWindowObject* win = &entry->win->d.win;
+	DanteRenderJob* job;
+	
+	danteUnlinkTexture(entry);
+	
+	/* frames already submitted may still sample the texture, the
+	 * queue destroys it after them
+	 */
+	job = danteQueueAcquire(win->queue);
+	job->run = danteTextureDestroyJob;
+	job->obj = entry->win;
+	job->arg = entry->tex;
+	danteQueueSubmit(win->queue);
+	
+	win->stale = true;
+	danteInvalidateObject(entry->win);
+	free(entry);
+}
+
+UDboolean DANTEAPIENTRY dantePixmapReplace(DanteObject* obj, SDL_Surface* surface, UDboolean share)
+{
+	DantePixels* buffer = NULL;
+	
+	if (surface) {
+		buffer = danteSharePixels(surface, share);
+	}
+	
+	dantePixmapAttach(obj, buffer);
+	return !surface || buffer;
+}
+
+void DANTEAPIENTRY dantePixmapAttach(DanteObject* obj, DantePixels* buffer)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	
+	if (pix->loading) {
+		/* the pending load completes with no effect */
+		pix->loading->pixmap = NULL;
+		pix->loading = NULL;
+	}
+	if (pix->atlas) {
+		danteAtlasRemove(obj);
+	}
+	danteEvictTextures(&pix->textures);
+	if (pix->buffer) {
+		danteReleasePixels(pix->buffer);
+		pix->buffer = NULL;
+		pix->pixels = NULL;
+	}
+	if (buffer) {
+		pix->buffer = buffer;
+		pix->pixels = buffer->surface;
+	}
+	
+	/* layers drawing no texture yet aren't redrawn by evictions */
+	danteInvalidateLayers(obj);
+}
+
+void DANTEAPIENTRY danteInvalidateLayers(DanteObject* obj)
+{
+	DanteObject* layer;
+	
+	for (layer = obj->d.pix.layers; layer; layer = layer->d.layer.layer_next) {
+		danteInvalidateObject(layer);
+	}
+}
+
+static void dantePixmapRegisterHandler(DanteObject* obj, UDenum param, UDhandlerproc proc)
+{
+	switch (param) {
+	case UDESK_EVENT_LOAD_EXT:
+		obj->d.pix.loaded = proc;
+		break;
+	
+	case UDESK_EVENT_PROGRESS_EXT:
+		obj->d.pix.progress = proc;
+		break;
+	
+	default:
+		dante_context->error = UDESK_INVALID_ENUM;
+		break;
+	}
+}
+
+static void dantePixmapClear(DanteObject* obj)
+{
+	dantePixmapReplace(obj, NULL, false);
+}
+
+static void dantePixmapLoadedHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	
+	if (pix->loaded) {
+		pix->loaded(ev->handle);
+	}
+}
+
+static void dantePixmapProgressHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DantePixmapObject* pix = &obj->d.pix;
+	
+	if (pix->progress) {
+		pix->progress(ev->handle);
+	}
+}
+
+UDboolean DANTEAPIENTRY dantePixmapInit(DanteObject* obj)
+{
+	static const DanteVTable pix_table = {
+		dantePixmapRegisterHandler,
+		NULL, /* no begin */
+		NULL, /* no end */
+		NULL, /* nothing to flush */
+		NULL, /* nothing to submit */
+		dantePixmapClear,
+		NULL /* cheap teardown */
+	};
+	static const DanteEventDispatch dispatch_table = {
+		NULL, /* enter */
+		NULL, /* leave */
+		NULL, /* focus */
+		NULL, /* draw */
+		NULL, /* destroy */
+		NULL, /* key */
+		NULL, /* button */
+		NULL, /* motion */
+		NULL, /* touch */
+		NULL, /* flushed */
+		dantePixmapLoadedHandler,
+		dantePixmapProgressHandler
+	};
+	
+	DantePixmapObject* pix = &obj->d.pix;
+	
+	pix->buffer = NULL;
+	pix->pixels = NULL;
+	pix->target = UDESK_PIXMAP_IMAGE;
+	pix->usage = UDESK_PIXMAP_USAGE_STATIC;
+	pix->textures = NULL;
+	pix->atlas = NULL;
+	pix->atlas_next = NULL;
+	pix->loading = NULL;
+	pix->loaded = NULL;
+	pix->progress = NULL;
+	pix->layers = NULL;
+	obj->vt = &pix_table;
+	obj->dispatch = &dispatch_table;
+	return true;
+}
+
+void DANTEAPIENTRY dantePixmapCopy(DanteObject* pixmap, DanteObject* win, const SDL_Rect* src, const SDL_Rect* dst)
+{
+	DantePixmapObject* pix = &pixmap->d.pix;
+	SDL_Rect from;
+	int rows;
+	
+	if (!pix->pixels) {
+		return;
+	}
+	if (pix->atlas) {
+		/* consecutive copies from the same texture are batched by SDL */
+		from = *src;
+		from.x += pix->atlas_rect.x;
+		from.y += pix->atlas_rect.y;
+		dantePixmapCopy(pix->atlas->pixmap, win, &from, dst);
+		return;
+	}
+	
+	rows = pix->pixels->h;
+	if (pix->loading && pix->buffer == pix->loading->stream.buffer) {
+		/* rows past the shown ones are being decoded */
+		rows = pix->loading->stream.shown;
+	}
+	
+	danteDrawTiles(win, &pix->textures, pix->pixels, rows, src, dst);
+}
+
+void DANTEAPIENTRY danteDrawTiles(DanteObject* win, DanteTexture** owner, SDL_Surface* pixels, int rows, const SDL_Rect* src, const SDL_Rect* dst)
+{
+	const SDL_Point* size = &win->d.win.tile;
+	SDL_Texture* tex;
+	SDL_Rect tile;
+	SDL_Rect part;
+	SDL_Rect to;
+	int x, y;
+	
+	if (src->w < 1 || src->h < 1) {
+		return;
+	}
+	
+	/* tiles outside 'src' are left alone, those uploaded for earlier
+	 * frames age in the LRU list until evicted
+	 */
+	for (y = src->y - src->y % size->y; y < src->y + src->h; y += size->y) {
+		for (x = src->x - src->x % size->x; x < src->x + src->w; x += size->x) {
+			tile.x = x;
+			tile.y = y;
+			tile.w = SDL_min(size->x, pixels->w - x);
+			tile.h = SDL_min(size->y, pixels->h - y);
+			tex = danteCacheTile(owner, pixels, rows, win, &tile);
+			if (!tex) {
+				return;
+			}
+			
+			/* edges shared by neighbouring tiles are scaled alike,
+			 * leaving no seams between them
+			 */
+			SDL_IntersectRect(src, &tile, &part);
+			to.x = dst->x + (int)((long)(part.x - src->x) * dst->w / src->w);
+			to.y = dst->y + (int)((long)(part.y - src->y) * dst->h / src->h);
+			to.w = dst->x + (int)((long)(part.x + part.w - src->x) * dst->w / src->w) - to.x;
+			to.h = dst->y + (int)((long)(part.y + part.h - src->y) * dst->h / src->h) - to.y;
+			if (to.w < 1 || to.h < 1) {
+				continue;
+			}
+			
+			part.x -= tile.x;
+			part.y -= tile.y;
+			danteRenderCopy(win, tex, &part, &to);
+		}
+	}
+}
+
+static SDL_Texture* danteCacheTile(DanteTexture** owner, SDL_Surface* pixels, int rows, DanteObject* win, const SDL_Rect* tile)
+{
+	DanteTextureUpdate upload;
+	DanteTexture* entry;
+	SDL_Rect rect;
+	
+	for (entry = *owner; entry; entry = entry->next) {
+		if (entry->win == win && entry->area.x == tile->x && entry->area.y == tile->y) {
+			/* move to the LRU head */
+			entry->lru_prev->lru_next = entry->lru_next;
+			entry->lru_next->lru_prev = entry->lru_prev;
+			danteLinkTexture(entry);
+			dante_context->texture_hits++;
+			return entry->tex;
+		}
+	}
+	
+	dante_context->texture_misses++;
+	entry = (DanteTexture*)malloc(sizeof(*entry));
+	DANTE_ERROR_AND_RETVAL_IF(!entry, UDESK_OUT_OF_MEMORY, NULL);
+	
+	/* textures are created by the thread owning the renderer, the
+	 * cache is trimmed before the next window is drawn
+	 */
+	entry->tex = NULL;
+	entry->pixels = pixels;
+	entry->area = *tile;
+	entry->owner = owner;
+	entry->win = win;
+	rect.x = 0;
+	rect.y = 0;
+	rect.w = tile->w;
+	rect.h = SDL_max(SDL_min(rows - tile->y, tile->h), 0);
+	upload.entry = entry;
+	upload.rect = &rect;
+	danteQueueCall(win->d.win.queue, danteTextureUploadJob, win, &upload);
+	if (!entry->tex) {
+		/* tiles fit the renderer limits, texture memory ran out */
+		free(entry);
+		dante_context->error = UDESK_OPERATION_FAILED;
+		return NULL;
+	}
+	
+	entry->bytes = (Uint32)tile->w * (Uint32)tile->h * 4;
+	entry->next = *owner;
+	*owner = entry;
+	danteLinkTexture(entry);
+	dante_context->texture_bytes += entry->bytes;
+	return entry->tex;
+}
+
+void DANTEAPIENTRY danteEvictTextures(DanteTexture** owner)
+{
+	while (*owner) {
+		danteEvictTexture(*owner);
+	}
+}
+
+void DANTEAPIENTRY dantePixmapDraw(DanteObject* pixmap, DanteObject* win, const SDL_Rect* area)
+{
+	SDL_Surface* pixels = pixmap->d.pix.pixels;
+	SDL_Rect src;
+	SDL_Rect dst;
+	
+	if (!pixels) {
+		return;
+	}
+	
+	src.x = 0;
+	src.y = 0;
+	src.w = SDL_min(pixels->w, area->w);
+	src.h = SDL_min(pixels->h, area->h);
+	dst.x = area->x;
+	dst.y = area->y;
+	dst.w = src.w;
+	dst.h = src.h;
+	dantePixmapCopy(pixmap, win, &src, &dst);
+}
+
+void DANTEAPIENTRY dantePixmapUpdate(DanteObject* obj, const SDL_Rect* rect)
+{
+	DanteTextureUpdate update;
+	DanteTexture* entry;
+	SDL_Rect part;
+	
+	/* areas being updated aren't referenced by frames in flight */
+	update.rect = &part;
+	for (entry = obj->d.pix.textures; entry; entry = entry->next) {
+		if (!SDL_IntersectRect(rect, &entry->area, &part)) {
+			continue;
+		}
+		
+		part.x -= entry->area.x;
+		part.y -= entry->area.y;
+		update.entry = entry;
+		danteQueueCall(entry->win->d.win.queue, danteTextureUpdateJob, entry->win, &update);
+	}
+}
+
+void DANTEAPIENTRY danteTrimTextures(void)
+{
+	DanteTexture* head = &dante_context->textures;
+	
+	while (dante_context->texture_bytes > dante_context->texture_budget && head->lru_prev != head) {
+		danteEvictTexture(head->lru_prev);
+	}
+}
+
+void DANTEAPIENTRY danteReleaseTextures(DanteObject* win)
+{
+	DanteTexture* head = &dante_context->textures;
+	DanteTexture* entry;
+	DanteTexture* next;
+	
+	for (entry = head->lru_next; entry != head; entry = next) {
+		next = entry->lru_next;
+		if (entry->win == win) {
+			danteUnlinkTexture(entry);
+			free(entry);
+		}
+	}
+}
+
+void UDESKAPIENTRY udeskPixmapFile(UDhandle pixmap, UDenum target, const char* name, UDenum usage)
+{
+	DanteObject* obj = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+	
+	if (obj) {
+		DantePixels* buffer;
+		UDenum err;
+		
+		DANTE_ERROR_IF(target != UDESK_PIXMAP_IMAGE && target != UDESK_PIXMAP_ICON, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(usage < UDESK_PIXMAP_USAGE_STATIC || usage > UDESK_PIXMAP_USAGE_ICON_LARGE, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(!name, UDESK_INVALID_VALUE);
+		
+		err = danteLoadImage(name, &buffer);
+		DANTE_ERROR_IF(err != UDESK_NO_ERROR, err);
+		
+		/* pixmaps loaded from the same image share their pixels */
+		obj->d.pix.target = target;
+		obj->d.pix.usage = usage;
+		dantePixmapAttach(obj, buffer);
+		danteAtlasAdd(obj);
+	}
+}
+
+void UDESKAPIENTRY udeskPixmapFileAsyncEXT(UDhandle pixmap, UDenum target, const char* name, UDenum usage)
+{
+	DanteObject* obj = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+	
+	if (obj) {
+		DANTE_ERROR_IF(target != UDESK_PIXMAP_IMAGE && target != UDESK_PIXMAP_ICON, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(usage < UDESK_PIXMAP_USAGE_STATIC || usage > UDESK_PIXMAP_USAGE_ICON_LARGE, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(!name, UDESK_INVALID_VALUE);
+		
+		/* the pixmap has no pixels until the load completes */
+		obj->d.pix.target = target;
+		obj->d.pix.usage = usage;
+		DANTE_ERROR_IF(!danteLoadImageAsync(obj, name, false), UDESK_OUT_OF_MEMORY);
+	}
+}
+
+void UDESKAPIENTRY udeskPixmapFileStreamEXT(UDhandle pixmap, UDenum target, const char* name, UDenum usage)
+{
+	DanteObject* obj = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+	
+	if (obj) {
+		DANTE_ERROR_IF(target != UDESK_PIXMAP_IMAGE && target != UDESK_PIXMAP_ICON, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(usage < UDESK_PIXMAP_USAGE_STATIC || usage > UDESK_PIXMAP_USAGE_ICON_LARGE, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(!name, UDESK_INVALID_VALUE);
+		
+		/* the pixmap has no pixels until the first band is decoded */
+		obj->d.pix.target = target;
+		obj->d.pix.usage = usage;
+		DANTE_ERROR_IF(!danteLoadImageAsync(obj, name, true), UDESK_OUT_OF_MEMORY);
+	}
+}
+
+void UDESKAPIENTRY udeskPixmapData(UDhandle pixmap, UDint width, UDint height, UDenum format, const void* data)
+{
+	DanteObject* obj = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+	
+	if (obj) {
+		SDL_Surface* surface;
+		int bpp;
+		
+		DANTE_ERROR_IF(format != UDESK_RGBA && format != UDESK_RGB_EXT, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(width < 1 || height < 1 || !data, UDESK_INVALID_VALUE);
+		
+		surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, DANTE_PIXMAP_FORMAT);
+		DANTE_ERROR_IF(!surface, UDESK_OUT_OF_MEMORY);
+		
+		bpp = (format == UDESK_RGBA) ? 4 : 3;
+		danteConvertPixels(surface, data, width * bpp, format);
+		
+		/* pixels shared with other pixmaps are left untouched */
+		obj->d.pix.target = UDESK_PIXMAP_IMAGE;
+		obj->d.pix.usage = UDESK_PIXMAP_USAGE_STATIC;
+		DANTE_ERROR_IF(!dantePixmapReplace(obj, surface, true), UDESK_OUT_OF_MEMORY);
+	}
+}
+
+void UDESKAPIENTRY udeskPixmapSubDataEXT(UDhandle pixmap, UDint x, UDint y, UDint width, UDint height, UDenum format, const void* data)
+{
+	DanteObject* obj = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+	
+	if (obj) {
+		SDL_Surface* pixels = obj->d.pix.pixels;
+		SDL_Surface* area;
+		SDL_Rect rect;
+		int bpp;
+		
+		DANTE_ERROR_IF(format != UDESK_RGBA && format != UDESK_RGB_EXT, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(!pixels || obj->d.pix.loading, UDESK_INVALID_OPERATION);
+		DANTE_ERROR_IF(x < 0 || y < 0 || width < 1 || height < 1 || !data, UDESK_INVALID_VALUE);
+		DANTE_ERROR_IF(width > pixels->w - x || height > pixels->h - y, UDESK_INVALID_VALUE);
+		
+		if (obj->d.pix.atlas) {
+			/* packed pixels are a copy, packed again once written */
+			danteAtlasRemove(obj);
+		}
+		
+		pixels = dantePixmapWritable(obj);
+		DANTE_ERROR_IF(!pixels, UDESK_OUT_OF_MEMORY);
+		
+		/* the area is converted through a surface viewing it */
+		area = SDL_CreateRGBSurfaceWithFormatFrom((Uint8*)pixels->pixels + y * pixels->pitch + x * 4,
+		                                          width, height, 32, pixels->pitch, DANTE_PIXMAP_FORMAT);
+		DANTE_ERROR_IF(!area, UDESK_OUT_OF_MEMORY);
+		
+		bpp = (format == UDESK_RGBA) ? 4 : 3;
+		danteConvertPixels(area, data, width * bpp, format);
+		SDL_FreeSurface(area);
+		
+		rect.x = x;
+		rect.y = y;
+		rect.w = width;
+		rect.h = height;
+		dantePixmapUpdate(obj, &rect);
+		danteInvalidateLayers(obj);
+		danteAtlasAdd(obj);
+	}
+}
+
+void UDESKAPIENTRY udeskGetPixmapiv(UDhandle pixmap, UDenum param, UDint* dst)
+{
+	DanteObject* obj = danteRetrieveObject(pixmap, UDESK_HANDLE_PIXMAP);
+	
+	if (obj) {
+		DANTE_ERROR_IF(!dst, UDESK_INVALID_VALUE);
+		
+		switch (param) {
+		case UDESK_PIXMAP_TARGET:
+			dst[0] = obj->d.pix.target;
+			break;
+		
+		case UDESK_PIXMAP_LOADING_EXT:
+			dst[0] = (obj->d.pix.loading != NULL);
+			break;
+		
+		case UDESK_PIXMAP_ROWS_EXT:
+			if (obj->d.pix.loading) {
+				dst[0] = (obj->d.pix.pixels)? obj->d.pix.loading->stream.shown : 0;
+			} else {
+				dst[0] = (obj->d.pix.pixels)? obj->d.pix.pixels->h : 0;
+			}
+			
+			break;
+		
+		default:
+			dante_context->error = UDESK_INVALID_ENUM;
+			break;
+		}
+	}
+}
+
+UDboolean UDESKAPIENTRY udeskIsPixmap(UDhandle handle)
+{
+	return danteCheckObjectType(handle, UDESK_HANDLE_PIXMAP);
+}
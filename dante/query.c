@@ -30,12 +30,59 @@
  */
 
 #include "dante.h"
+#include <string.h>
 
 /* major version of the standard implemented by Dante. */
 #define DANTE_UDESK_VERSION_MAJOR 0
 /* minor version of the standard implemented by Dante. */
 #define DANTE_UDESK_VERSION_MINOR 1
 
+/* Extension procedure entry, maps an exported extension function
+ * name to its address for udeskGetProcAddress().
+ */
+typedef struct DanteProcEntry_s {
+	/* procedure name, as declared in udeskext.h. */
+	const char* name;
+	/* procedure address. */
+	void (UDESKAPIENTRYP proc)(void);
+} DanteProcEntry;
+
+/* Convenience macro to build a DanteProcEntry from a function name. */
+#define DANTE_PROC_ENTRY(func) { #func, (void (UDESKAPIENTRYP)(void))func }
+
+/* Extensions supported by Dante, as reported by udeskQueryExtension(). */
+static const char* const dante_extensions[] = {
+	"UDESK_INPUT_STATE_EXT",
+	"UDESK_FRAME_STATS_EXT",
+	"UDESK_WINDOW_READ_PIXELS_EXT",
+	"UDESK_ASYNC_FLUSH_EXT",
+	"UDESK_WINDOW_BUILD_EXT",
+	"UDESK_TEXTURE_CACHE_EXT",
+	"UDESK_PIXEL_FORMATS_EXT",
+	"UDESK_SCALED_CACHE_EXT",
+	"UDESK_ASYNC_PIXMAP_EXT",
+	"UDESK_PIXMAP_EXTENDED_FILE_FORMATS_EXT",
+	"UDESK_STREAM_PIXMAP_EXT",
+	"UDESK_PIXMAP_SUB_DATA_EXT"
+};
+
+/* Extension procedures exported by Dante. */
+static const DanteProcEntry dante_procs[] = {
+	DANTE_PROC_ENTRY(udeskGetKeyStateEXT),
+	DANTE_PROC_ENTRY(udeskGetModifiersEXT),
+	DANTE_PROC_ENTRY(udeskReadWindowPixelsEXT),
+	DANTE_PROC_ENTRY(udeskFlushAsyncEXT),
+	DANTE_PROC_ENTRY(udeskPollFenceEXT),
+	DANTE_PROC_ENTRY(udeskWaitFenceEXT),
+	DANTE_PROC_ENTRY(udeskPixmapFileAsyncEXT),
+	DANTE_PROC_ENTRY(udeskQueryFileFormatEXT),
+	DANTE_PROC_ENTRY(udeskPixmapFileStreamEXT),
+	DANTE_PROC_ENTRY(udeskPixmapSubDataEXT)
+};
+
+/* Number of elements in a static array. */
+#define DANTE_ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
 const char* UDESKAPIENTRY udeskQueryString(UDenum param)
 {
 	switch (param) {
@@ -62,7 +109,11 @@ UDenum UDESKAPIENTRY udeskQueryiv(UDenum param, UDint* dst)
 		return UDESK_NO_ERROR;
 	
 	case UDESK_NUM_EXTENSIONS:
-		dst[0] = 0;
+		dst[0] = (UDint)DANTE_ARRAY_SIZE(dante_extensions);
+		return UDESK_NO_ERROR;
+	
+	case UDESK_NUM_FILE_FORMATS_EXT:
+		dst[0] = danteNumDecoders();
 		return UDESK_NO_ERROR;
 		
 	default:
@@ -72,7 +123,24 @@ UDenum UDESKAPIENTRY udeskQueryiv(UDenum param, UDint* dst)
 
 const char* UDESKAPIENTRY udeskQueryExtension(UDint extnum)
 {
-	(void)extnum;
+	if (extnum < 0 || (size_t)extnum >= DANTE_ARRAY_SIZE(dante_extensions)) {
+		return NULL;
+	}
+	
+	return dante_extensions[extnum];
+}
+
+void (UDESKAPIENTRY UDESKAPIENTRYP udeskGetProcAddress(const char* name))(void)
+{
+	size_t i;
+	
+	DANTE_IGNORE_AND_RETVAL_IF(!dante_context || !name, NULL);
+	
+	for (i = 0; i < DANTE_ARRAY_SIZE(dante_procs); i++) {
+		if (strcmp(dante_procs[i].name, name) == 0) {
+			return dante_procs[i].proc;
+		}
+	}
 	
 	return NULL;
 }
@@ -0,0 +1,432 @@
+/* queue.c: Render queue.
+ *
+ * Implements the render queues used to issue every renderer call,
+ * a queue either runs its jobs on a dedicated render thread, letting
+ * the event loop record frames while previous ones are presented, or
+ * immediately on submission.
+ * Jobs are stored into a fixed ring, submitting never allocates.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+
+/* Returns true if fence 'a' comes after, or is, fence 'b'. */
+#define DANTE_FENCE_REACHED(a, b) ((Sint32)((a) - (b)) >= 0)
+
+/* Render thread entry point, runs 'data' queue jobs until asked to quit. */
+static int SDLCALL danteQueueThread(void* data);
+/* Returns true if no job of 'queue' up to fence 'fence' is pending,
+ * 'queue' must be locked if it has a thread.
+ */
+static UDboolean danteQueueReached(const DanteRenderQueue* queue, Uint32 fence);
+/* Worker thread entry point, runs 'data' workers tasks and background
+ * jobs until asked to quit.
+ */
+static int SDLCALL danteWorkerThread(void* data);
+/* Runs tasks of 'workers' until none is left to be taken,
+ * 'workers' must be locked.
+ */
+static void danteWorkersDrain(DanteWorkers* workers);
+/* Starts the context worker threads, one less than the CPU count. */
+static void danteWorkersStart(DanteWorkers* workers);
+
+static int SDLCALL danteQueueThread(void* data)
+{
+	DanteRenderQueue* queue = (DanteRenderQueue*)data;
+	DanteRenderJob* job;
+	
+	SDL_LockMutex(queue->lock);
+	for (;;) {
+		while (queue->completed == queue->submitted && !queue->quit) {
+			SDL_CondWait(queue->wake, queue->lock);
+		}
+		if (queue->completed == queue->submitted) {
+			/* asked to quit and no job left */
+			break;
+		}
+		
+		/* the slot isn't reused until the job completes, run it unlocked */
+		job = &queue->jobs[(queue->completed + 1) % DANTE_RENDER_JOBS];
+		SDL_UnlockMutex(queue->lock);
+		job->run(job);
+		SDL_LockMutex(queue->lock);
+		
+		queue->completed++;
+		SDL_CondBroadcast(queue->done);
+	}
+	
+	SDL_UnlockMutex(queue->lock);
+	return 0;
+}
+
+static UDboolean danteQueueReached(const DanteRenderQueue* queue, Uint32 fence)
+{
+	if (queue->completed == queue->submitted) {
+		return true;
+	}
+	
+	/* jobs complete in order, test the oldest pending one */
+	return !DANTE_FENCE_REACHED(fence, queue->jobs[(queue->completed + 1) % DANTE_RENDER_JOBS].fence);
+}
+
+void DANTEAPIENTRY danteQueueInit(DanteRenderQueue* queue, UDboolean threaded)
+{
+	queue->thread = NULL;
+	queue->lock = NULL;
+	queue->wake = NULL;
+	queue->done = NULL;
+	queue->submitted = 0;
+	queue->completed = 0;
+	queue->quit = false;
+	if (!threaded) {
+		return;
+	}
+	
+	queue->lock = SDL_CreateMutex();
+	queue->wake = SDL_CreateCond();
+	queue->done = SDL_CreateCond();
+	if (queue->lock && queue->wake && queue->done) {
+		queue->thread = SDL_CreateThread(danteQueueThread, "dante-render", queue);
+	}
+	if (!queue->thread) {
+		/* run jobs on submission */
+		danteQueueDestroy(queue);
+	}
+}
+
+void DANTEAPIENTRY danteQueueDestroy(DanteRenderQueue* queue)
+{
+	if (queue->thread) {
+		SDL_LockMutex(queue->lock);
+		queue->quit = true;
+		SDL_CondSignal(queue->wake);
+		SDL_UnlockMutex(queue->lock);
+		SDL_WaitThread(queue->thread, NULL);
+		queue->thread = NULL;
+	}
+	if (queue->done) {
+		SDL_DestroyCond(queue->done);
+		queue->done = NULL;
+	}
+	if (queue->wake) {
+		SDL_DestroyCond(queue->wake);
+		queue->wake = NULL;
+	}
+	if (queue->lock) {
+		SDL_DestroyMutex(queue->lock);
+		queue->lock = NULL;
+	}
+}
+
+DanteRenderJob* DANTEAPIENTRY danteQueueAcquire(DanteRenderQueue* queue)
+{
+	if (queue->thread) {
+		/* only the submitting thread advances 'submitted', the slot
+		 * can be filled unlocked once there's room
+		 */
+		SDL_LockMutex(queue->lock);
+		while (queue->submitted - queue->completed >= DANTE_RENDER_JOBS) {
+			SDL_CondWait(queue->done, queue->lock);
+		}
+		
+		SDL_UnlockMutex(queue->lock);
+	}
+	
+	return &queue->jobs[(queue->submitted + 1) % DANTE_RENDER_JOBS];
+}
+
+Uint32 DANTEAPIENTRY danteQueueSubmit(DanteRenderQueue* queue)
+{
+	DanteRenderJob* job = &queue->jobs[(queue->submitted + 1) % DANTE_RENDER_JOBS];
+	Uint32 fence;
+	
+	/* fences come from the context, so that they are ordered
+	 * across queues, only the submitting thread advances it
+	 */
+	fence = ++dante_context->fence;
+	if (!queue->thread) {
+		job->fence = fence;
+		queue->submitted++;
+		job->run(job);
+		queue->completed++;
+		return fence;
+	}
+	
+	SDL_LockMutex(queue->lock);
+	job->fence = fence;
+	queue->submitted++;
+	SDL_CondSignal(queue->wake);
+	SDL_UnlockMutex(queue->lock);
+	return fence;
+}
+
+UDboolean DANTEAPIENTRY danteQueuePoll(DanteRenderQueue* queue, Uint32 fence)
+{
+	UDboolean ret;
+	
+	if (!queue->thread) {
+		return true;
+	}
+	
+	SDL_LockMutex(queue->lock);
+	ret = danteQueueReached(queue, fence);
+	SDL_UnlockMutex(queue->lock);
+	return ret;
+}
+
+void DANTEAPIENTRY danteQueueWait(DanteRenderQueue* queue, Uint32 fence)
+{
+	if (!queue->thread) {
+		return;
+	}
+	
+	SDL_LockMutex(queue->lock);
+	while (!danteQueueReached(queue, fence)) {
+		SDL_CondWait(queue->done, queue->lock);
+	}
+	
+	SDL_UnlockMutex(queue->lock);
+}
+
+UDboolean DANTEAPIENTRY danteFencePoll(Uint32 fence)
+{
+	UDint i;
+	
+	for (i = 0; i < DANTE_RENDER_QUEUES; i++) {
+		if (!danteQueuePoll(&dante_context->render[i], fence)) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+void DANTEAPIENTRY danteFenceWait(Uint32 fence)
+{
+	UDint i;
+	
+	/* every queue kept running while waiting on the previous ones */
+	for (i = 0; i < DANTE_RENDER_QUEUES; i++) {
+		danteQueueWait(&dante_context->render[i], fence);
+	}
+}
+
+void DANTEAPIENTRY danteQueueCall(DanteRenderQueue* queue, DanteJobproc run, DanteObject* obj, void* arg)
+{
+	DanteRenderJob* job = danteQueueAcquire(queue);
+	
+	job->run = run;
+	job->obj = obj;
+	job->arg = arg;
+	job->notify = 0;
+	danteQueueWait(queue, danteQueueSubmit(queue));
+}
+
+static void danteWorkersDrain(DanteWorkers* workers)
+{
+	UDint index;
+	
+	while (workers->next < workers->count) {
+		index = workers->next++;
+		SDL_UnlockMutex(workers->lock);
+		workers->run(workers->data, index);
+		SDL_LockMutex(workers->lock);
+		
+		workers->finished++;
+		if (workers->finished == workers->count) {
+			/* callers of earlier generations may still be waiting */
+			SDL_CondBroadcast(workers->done);
+		}
+	}
+}
+
+static int SDLCALL danteWorkerThread(void* data)
+{
+	DanteWorkers* workers = (DanteWorkers*)data;
+	
+	DanteBackgroundJob* job;
+	
+	SDL_LockMutex(workers->lock);
+	while (!workers->quit) {
+		danteWorkersDrain(workers);
+		if (workers->jobs && !workers->quit) {
+			/* parallel tasks are waited on, they come first */
+			job = workers->jobs;
+			workers->jobs = job->next;
+			SDL_UnlockMutex(workers->lock);
+			job->run(job);
+			SDL_LockMutex(workers->lock);
+			continue;
+		}
+		if (!workers->quit) {
+			SDL_CondWait(workers->wake, workers->lock);
+		}
+	}
+	
+	SDL_UnlockMutex(workers->lock);
+	return 0;
+}
+
+static void danteWorkersStart(DanteWorkers* workers)
+{
+	UDint num = SDL_GetCPUCount() - 1;
+	
+	workers->started = true;
+	if (num > DANTE_WORKER_THREADS) {
+		num = DANTE_WORKER_THREADS;
+	}
+	if (num <= 0) {
+		return;
+	}
+	
+	workers->lock = SDL_CreateMutex();
+	workers->wake = SDL_CreateCond();
+	workers->done = SDL_CreateCond();
+	if (!workers->lock || !workers->wake || !workers->done) {
+		danteWorkersDestroy();
+		workers->started = true;
+		return;
+	}
+	
+	while (workers->num_threads < num) {
+		SDL_Thread* thread = SDL_CreateThread(danteWorkerThread, "dante-worker", workers);
+		
+		if (!thread) {
+			/* run with fewer threads */
+			break;
+		}
+		
+		workers->threads[workers->num_threads++] = thread;
+	}
+}
+
+void DANTEAPIENTRY danteRunTasks(DanteTaskproc run, void* data, UDint count)
+{
+	DanteWorkers* workers = &dante_context->workers;
+	Uint32 generation;
+	UDint i;
+	
+	if (count > 1 && !workers->started) {
+		danteWorkersStart(workers);
+	}
+	if (count <= 1 || workers->num_threads == 0) {
+		for (i = 0; i < count; i++) {
+			run(data, i);
+		}
+		
+		return;
+	}
+	
+	SDL_LockMutex(workers->lock);
+	if (workers->finished < workers->count) {
+		/* tasks of another thread are running, run these alone */
+		SDL_UnlockMutex(workers->lock);
+		for (i = 0; i < count; i++) {
+			run(data, i);
+		}
+		
+		return;
+	}
+	
+	workers->run = run;
+	workers->data = data;
+	workers->next = 0;
+	workers->count = count;
+	workers->finished = 0;
+	generation = ++workers->generation;
+	SDL_CondBroadcast(workers->wake);
+	
+	/* the calling thread takes tasks as well, once they complete
+	 * another thread may start its own before this one wakes up
+	 */
+	danteWorkersDrain(workers);
+	while (workers->generation == generation && workers->finished < workers->count) {
+		SDL_CondWait(workers->done, workers->lock);
+	}
+	
+	SDL_UnlockMutex(workers->lock);
+}
+
+void DANTEAPIENTRY danteRunBackground(DanteBackgroundJob* job)
+{
+	DanteWorkers* workers = &dante_context->workers;
+	
+	if (!workers->started) {
+		danteWorkersStart(workers);
+	}
+	if (workers->num_threads == 0) {
+		job->run(job);
+		return;
+	}
+	
+	job->next = NULL;
+	SDL_LockMutex(workers->lock);
+	if (workers->jobs) {
+		workers->last_job->next = job;
+	} else {
+		workers->jobs = job;
+	}
+	
+	workers->last_job = job;
+	SDL_CondSignal(workers->wake);
+	SDL_UnlockMutex(workers->lock);
+}
+
+void DANTEAPIENTRY danteWorkersDestroy(void)
+{
+	DanteWorkers* workers = &dante_context->workers;
+	UDint i;
+	
+	if (workers->num_threads > 0) {
+		SDL_LockMutex(workers->lock);
+		workers->quit = true;
+		SDL_CondBroadcast(workers->wake);
+		SDL_UnlockMutex(workers->lock);
+		for (i = 0; i < workers->num_threads; i++) {
+			SDL_WaitThread(workers->threads[i], NULL);
+		}
+		
+		workers->num_threads = 0;
+	}
+	if (workers->done) {
+		SDL_DestroyCond(workers->done);
+		workers->done = NULL;
+	}
+	if (workers->wake) {
+		SDL_DestroyCond(workers->wake);
+		workers->wake = NULL;
+	}
+	if (workers->lock) {
+		SDL_DestroyMutex(workers->lock);
+		workers->lock = NULL;
+	}
+	
+	workers->jobs = NULL;
+	workers->last_job = NULL;
+	workers->started = false;
+	workers->quit = false;
+}
@@ -0,0 +1,660 @@
+/* render.c: Window damage tracking and rendering.
+ *
+ * Implements the damage region and the retained display list kept by
+ * every window: the draw pass records renderer calls into a compact
+ * command list, objects whose subtree wasn't invalidated copy their
+ * previous command range instead of drawing again.
+ * The list is replayed against a retained window canvas only for
+ * the damaged rectangles, then the canvas is presented, so that
+ * exposing an unchanged window just presents the canvas again.
+ * Replaying and presenting run as frame jobs on the window render
+ * queue, while the next list is recorded.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial number of display list commands. */
+#define DANTE_LIST_CMDS 64
+/* Initial number of display list ranges. */
+#define DANTE_LIST_RANGES 16
+
+/* Damages the whole area of the window 'obj'. */
+static void danteDamageWindow(DanteObject* obj);
+/* Ensures room for 'cmds' more commands and 'ranges' more ranges
+ * inside 'list', flags the list as failed on out of memory condition.
+ */
+static UDboolean danteListReserve(DanteDisplayList* list, UDint cmds, UDint ranges);
+/* Copies the range 'idx' of 'old', along with its descendants, at
+ * the end of the display list being recorded by 'win'.
+ */
+static void danteListSplice(DanteWindowObject* win, const DanteDisplayList* old, UDint idx);
+/* Executes 'cmd' on the window renderer, commands outside the rectangle
+ * being redrawn are skipped, executed ones are accounted into the
+ * frame statistics.
+ */
+static void danteExecuteCmd(DanteWindowObject* win, const DanteDrawCmd* cmd);
+/* Prepares the window 'obj' for a frame, redirecting rendering to
+ * the window canvas and resetting the frame statistics, 'dmg' is
+ * extended to the whole window if the canvas contents were lost.
+ * It returns true if there's damage to replay.
+ */
+static UDboolean danteRenderBegin(DanteObject* obj, DanteDamage* dmg);
+/* Replays the display list 'idx' of the window 'obj' for each
+ * rectangle in 'dmg', ranges outside the rectangle are skipped.
+ */
+static void danteListReplay(DanteObject* obj, UDint idx, const DanteDamage* dmg);
+/* Presents the canvas of the window 'obj'. */
+static void danteRenderEnd(DanteObject* obj);
+/* Frame job, replays and presents a window frame. */
+static void danteFrameJob(DanteRenderJob* job);
+/* Pixels readback job, 'arg' is a DanteReadback. */
+static void danteReadbackJob(DanteRenderJob* job);
+
+/* Pixels readback job argument. */
+typedef struct DanteReadback_s {
+	/* area to read. */
+	const SDL_Rect* rect;
+	/* destination buffer. */
+	void* dst;
+	/* job result. */
+	UDboolean ok;
+} DanteReadback;
+
+/* Returns the area growth caused by merging 'a' and 'b'. */
+static long danteMergeCost(const SDL_Rect* a, const SDL_Rect* b)
+{
+	SDL_Rect u;
+	
+	SDL_UnionRect(a, b, &u);
+	return (long)u.w * u.h - (long)a->w * a->h;
+}
+
+void DANTEAPIENTRY danteDamageAdd(DanteDamage* dmg, const SDL_Rect* rect, int w, int h)
+{
+	SDL_Rect bounds;
+	SDL_Rect r;
+	UDint best;
+	UDint i;
+	
+	bounds.x = 0;
+	bounds.y = 0;
+	bounds.w = w;
+	bounds.h = h;
+	if (!SDL_IntersectRect(rect, &bounds, &r)) {
+		return;
+	}
+	
+	for (;;) {
+		/* absorb overlapping rectangles, each merge may reveal new overlaps */
+		i = 0;
+		while (i < dmg->count) {
+			if (SDL_HasIntersection(&dmg->rects[i], &r)) {
+				SDL_UnionRect(&dmg->rects[i], &r, &r);
+				dmg->rects[i] = dmg->rects[--dmg->count];
+				i = 0;
+			} else {
+				i++;
+			}
+		}
+		
+		if (dmg->count < DANTE_DAMAGE_RECTS) {
+			break;
+		}
+		
+		/* region full, merge with the rectangle growing the least */
+		best = 0;
+		for (i = 1; i < dmg->count; i++) {
+			if (danteMergeCost(&dmg->rects[i], &r) < danteMergeCost(&dmg->rects[best], &r)) {
+				best = i;
+			}
+		}
+		
+		SDL_UnionRect(&dmg->rects[best], &r, &r);
+		dmg->rects[best] = dmg->rects[--dmg->count];
+	}
+	
+	dmg->rects[dmg->count++] = r;
+}
+
+UDboolean DANTEAPIENTRY danteDamageIntersects(const DanteDamage* dmg, const SDL_Rect* rect)
+{
+	UDint i;
+	
+	for (i = 0; i < dmg->count; i++) {
+		if (SDL_HasIntersection(&dmg->rects[i], rect)) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+static void danteDamageWindow(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	SDL_Rect all;
+	
+	all.x = 0;
+	all.y = 0;
+	all.w = win->grid.width;
+	all.h = win->grid.height;
+	danteDamageAdd(&win->damage, &all, win->grid.width, win->grid.height);
+}
+
+void DANTEAPIENTRY danteInvalidateObject(DanteObject* obj)
+{
+	DanteObject* it;
+	DanteObject* win = NULL;
+	
+	for (it = obj; it; it = it->parent) {
+		it->dirty = true;
+		if (it->type == UDESK_HANDLE_WINDOW) {
+			win = it;
+		}
+	}
+	
+	if (!win) {
+		/* not attached to any window */
+		return;
+	}
+	
+	if (obj == win) {
+		danteDamageWindow(win);
+	} else {
+		danteDamageAdd(&win->d.win.damage, &obj->area, win->d.win.grid.width, win->d.win.grid.height);
+	}
+}
+
+void DANTEAPIENTRY danteDamageTexture(DanteObject* obj, SDL_Texture* tex, const SDL_Rect* rect, int w, int h)
+{
+	DanteWindowObject* win = &obj->d.win;
+	const DanteDisplayList* list = &win->lists[win->front];
+	const DanteDrawCmd* cmd;
+	SDL_Rect src, dst, r;
+	UDint i;
+	
+	for (i = 0; i < list->num_cmds; i++) {
+		cmd = &list->cmds[i];
+		if (cmd->op != DANTE_CMD_COPY || cmd->tex != tex) {
+			continue;
+		}
+		
+		src.x = 0;
+		src.y = 0;
+		src.w = w;
+		src.h = h;
+		if (cmd->has_src) {
+			src = cmd->src;
+		}
+		if (!SDL_IntersectRect(&src, rect, &r)) {
+			continue;
+		}
+		
+		dst.x = 0;
+		dst.y = 0;
+		dst.w = win->grid.width;
+		dst.h = win->grid.height;
+		if (cmd->has_dst) {
+			dst = cmd->dst;
+		}
+		
+		/* scale to the destination, rounding outwards */
+		r.w = (int)(((long)(r.x - src.x + r.w) * dst.w + src.w - 1) / src.w);
+		r.h = (int)(((long)(r.y - src.y + r.h) * dst.h + src.h - 1) / src.h);
+		r.x = (int)((long)(r.x - src.x) * dst.w / src.w);
+		r.y = (int)((long)(r.y - src.y) * dst.h / src.h);
+		r.w -= r.x;
+		r.h -= r.y;
+		r.x += dst.x;
+		r.y += dst.y;
+		danteDamageAdd(&win->damage, &r, win->grid.width, win->grid.height);
+	}
+}
+
+static UDboolean danteListReserve(DanteDisplayList* list, UDint cmds, UDint ranges)
+{
+	UDint capacity;
+	
+	if (list->num_cmds + cmds > list->cmd_capacity) {
+		DanteDrawCmd* buf;
+		
+		capacity = (list->cmd_capacity > 0)? list->cmd_capacity * 2 : DANTE_LIST_CMDS;
+		if (capacity < list->num_cmds + cmds) {
+			capacity = list->num_cmds + cmds;
+		}
+		
+		buf = (DanteDrawCmd*)realloc(list->cmds, capacity * sizeof(*buf));
+		if (!buf) {
+			list->failed = true;
+			return false;
+		}
+		
+		list->cmds = buf;
+		list->cmd_capacity = capacity;
+	}
+	if (list->num_ranges + ranges > list->range_capacity) {
+		DanteDrawRange* buf;
+		
+		capacity = (list->range_capacity > 0)? list->range_capacity * 2 : DANTE_LIST_RANGES;
+		if (capacity < list->num_ranges + ranges) {
+			capacity = list->num_ranges + ranges;
+		}
+		
+		buf = (DanteDrawRange*)realloc(list->ranges, capacity * sizeof(*buf));
+		if (!buf) {
+			list->failed = true;
+			return false;
+		}
+		
+		list->ranges = buf;
+		list->range_capacity = capacity;
+	}
+	
+	return true;
+}
+
+void DANTEAPIENTRY danteListClear(DanteDisplayList* list)
+{
+	free(list->cmds);
+	free(list->ranges);
+	memset(list, 0, sizeof(*list));
+}
+
+void DANTEAPIENTRY danteListBegin(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteDisplayList* list = &win->lists[1 - win->front];
+	DanteDrawRange* range;
+	
+	/* the list may still be replayed by an older frame */
+	danteQueueWait(win->queue, win->fences[1 - win->front]);
+	list->num_cmds = 0;
+	list->num_ranges = 0;
+	list->failed = false;
+	win->color.r = 0;
+	win->color.g = 0;
+	win->color.b = 0;
+	win->color.a = SDL_ALPHA_OPAQUE;
+	win->depth = 1;
+	obj->dirty = false;
+	if (danteListReserve(list, 0, 1)) {
+		range = &list->ranges[list->num_ranges++];
+		range->obj = obj;
+		range->area.x = 0;
+		range->area.y = 0;
+		range->area.w = win->grid.width;
+		range->area.h = win->grid.height;
+		range->first = 0;
+		range->count = 0;
+		range->depth = 0;
+		obj->range = 0;
+	}
+}
+
+static void danteListSplice(DanteWindowObject* win, const DanteDisplayList* old, UDint idx)
+{
+	DanteDisplayList* list = &win->lists[1 - win->front];
+	const DanteDrawRange* root = &old->ranges[idx];
+	UDint end;
+	UDint i;
+	
+	for (end = idx + 1; end < old->num_ranges && old->ranges[end].depth > root->depth; end++);
+	
+	if (!danteListReserve(list, root->count, end - idx)) {
+		return;
+	}
+	
+	memcpy(list->cmds + list->num_cmds, old->cmds + root->first, root->count * sizeof(*list->cmds));
+	for (i = idx; i < end; i++) {
+		DanteDrawRange* range = &list->ranges[list->num_ranges];
+		
+		*range = old->ranges[i];
+		range->first = range->first - root->first + list->num_cmds;
+		range->depth = range->depth - root->depth + win->depth;
+		range->obj->range = list->num_ranges++;
+	}
+	
+	list->num_cmds += root->count;
+}
+
+void DANTEAPIENTRY danteDrawObject(DanteObject* obj, DanteObject* child)
+{
+	DanteWindowObject* win = &obj->d.win;
+	const DanteDisplayList* old = &win->lists[win->front];
+	DanteDisplayList* list = &win->lists[1 - win->front];
+	DanteDrawRange* range;
+	UDint idx;
+	
+	if (list->failed) {
+		return;
+	}
+	if (!child->dirty && !win->stale && child->range >= 0 && child->range < old->num_ranges && old->ranges[child->range].obj == child) {
+		/* nothing changed in this subtree, reuse its commands */
+		danteListSplice(win, old, child->range);
+		return;
+	}
+	if (!danteListReserve(list, 0, 1)) {
+		return;
+	}
+	
+	/* the list may be reallocated by the child, refer to the range by index */
+	idx = list->num_ranges++;
+	range = &list->ranges[idx];
+	range->obj = child;
+	range->area = child->area;
+	range->first = list->num_cmds;
+	range->count = 0;
+	range->depth = win->depth;
+	child->range = idx;
+	child->dirty = false;
+	
+	win->depth++;
+	dantePropagateEvent(DANTE_DRAW_DISPATCH_ID, NULL, child);
+	win->depth--;
+	
+	if (!list->failed) {
+		list->ranges[idx].count = list->num_cmds - list->ranges[idx].first;
+	}
+}
+
+UDboolean DANTEAPIENTRY danteListEnd(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteDisplayList* list = &win->lists[1 - win->front];
+	
+	win->depth = 0;
+	if (list->failed) {
+		/* the previous list may reference objects no longer drawn, drop both */
+		danteQueueWait(win->queue, win->fences[win->front]);
+		list->num_cmds = 0;
+		list->num_ranges = 0;
+		win->lists[win->front].num_cmds = 0;
+		win->lists[win->front].num_ranges = 0;
+		obj->dirty = true;
+		return false;
+	}
+	
+	list->ranges[0].count = list->num_cmds;
+	win->front = 1 - win->front;
+	win->stale = false;
+	return true;
+}
+
+static void danteExecuteCmd(DanteWindowObject* win, const DanteDrawCmd* cmd)
+{
+	const SDL_Rect* dst = (cmd->has_dst)? &cmd->dst : NULL;
+	SDL_Rect r;
+	
+	if (dst) {
+		if (!SDL_IntersectRect(dst, win->clip, &r)) {
+			return;
+		}
+	} else {
+		r = *win->clip;
+	}
+	
+	win->stats.calls++;
+	win->stats.pixels += r.w * r.h;
+	switch (cmd->op) {
+	case DANTE_CMD_FILL:
+		SDL_SetRenderDrawColor(win->render, cmd->color.r, cmd->color.g, cmd->color.b, cmd->color.a);
+		SDL_RenderFillRect(win->render, dst);
+		break;
+	
+	case DANTE_CMD_COPY:
+		SDL_RenderCopy(win->render, cmd->tex, (cmd->has_src)? &cmd->src : NULL, dst);
+		break;
+	
+	default:
+		break;
+	}
+}
+
+static void danteListReplay(DanteObject* obj, UDint idx, const DanteDamage* dmg)
+{
+	DanteWindowObject* win = &obj->d.win;
+	const DanteDisplayList* list = &win->lists[idx];
+	UDint i;
+	UDint c;
+	UDint r;
+	
+	for (i = 0; i < dmg->count; i++) {
+		win->clip = &dmg->rects[i];
+		SDL_RenderSetClipRect(win->render, win->clip);
+		
+		c = 0;
+		r = 0;
+		while (c < list->num_cmds) {
+			/* enter the ranges starting here, skipping the subtrees
+			 * lying outside the rectangle
+			 */
+			while (r < list->num_ranges && list->ranges[r].first == c) {
+				const DanteDrawRange* range = &list->ranges[r++];
+				
+				if (range->depth > 0 && !SDL_HasIntersection(&range->area, win->clip)) {
+					c = range->first + range->count;
+					while (r < list->num_ranges && list->ranges[r].depth > range->depth) {
+						r++;
+					}
+				}
+			}
+			
+			if (c < list->num_cmds) {
+				danteExecuteCmd(win, &list->cmds[c++]);
+			}
+		}
+	}
+	
+	win->clip = NULL;
+}
+
+static UDboolean danteRenderBegin(DanteObject* obj, DanteDamage* dmg)
+{
+	DanteWindowObject* win = &obj->d.win;
+	SDL_Rect all;
+	int w;
+	int h;
+	
+	win->stats.calls = 0;
+	win->stats.pixels = 0;
+	win->stats.rects = 0;
+	
+	if (SDL_GetRendererOutputSize(win->render, &w, &h) != 0) {
+		return false;
+	}
+	
+	all.x = 0;
+	all.y = 0;
+	all.w = w;
+	all.h = h;
+	if (win->canvas && (w != win->canvas_w || h != win->canvas_h)) {
+		/* window resized, old contents are useless */
+		SDL_DestroyTexture(win->canvas);
+		win->canvas = NULL;
+	}
+	if (!win->canvas && SDL_RenderTargetSupported(win->render)) {
+		win->canvas = SDL_CreateTexture(win->render, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+		win->canvas_w = w;
+		win->canvas_h = h;
+		danteDamageAdd(dmg, &all, w, h);
+	}
+	if (win->canvas && SDL_SetRenderTarget(win->render, win->canvas) != 0) {
+		SDL_DestroyTexture(win->canvas);
+		win->canvas = NULL;
+	}
+	if (!win->canvas) {
+		/* drawing straight to the backbuffer, whose contents
+		 * are undefined after presenting, replay everything
+		 */
+		danteDamageAdd(dmg, &all, w, h);
+	}
+	
+	win->stats.rects = dmg->count;
+	return dmg->count > 0;
+}
+
+static void danteRenderEnd(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	SDL_RenderSetClipRect(win->render, NULL);
+	if (win->canvas) {
+		SDL_SetRenderTarget(win->render, NULL);
+		SDL_RenderCopy(win->render, win->canvas, NULL, NULL);
+	}
+	
+	SDL_RenderPresent(win->render);
+}
+
+static void danteFrameJob(DanteRenderJob* job)
+{
+	SDL_Event ev;
+	
+	if (danteRenderBegin(job->obj, &job->damage)) {
+		danteListReplay(job->obj, job->list, &job->damage);
+	}
+	
+	danteRenderEnd(job->obj);
+	if (job->notify) {
+		/* SDL_PushEvent() is thread safe, the window is looked up
+		 * again by identifier in case it was destroyed meanwhile
+		 */
+		memset(&ev, 0, sizeof(ev));
+		ev.type = dante_context->flush_event;
+		ev.user.windowID = job->notify;
+		ev.user.code = (Sint32)job->fence;
+		SDL_PushEvent(&ev);
+	}
+}
+
+Uint32 DANTEAPIENTRY danteRenderFrame(DanteObject* obj, UDboolean notify)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteRenderJob* job;
+	
+	job = danteQueueAcquire(win->queue);
+	job->run = danteFrameJob;
+	job->obj = obj;
+	job->arg = NULL;
+	job->list = win->front;
+	job->damage = win->damage;
+	job->notify = 0;
+	if (notify && dante_context->flush_event != (Uint32)-1) {
+		job->notify = SDL_GetWindowID(win->swin);
+	}
+	
+	win->damage.count = 0;
+	win->fences[win->front] = danteQueueSubmit(win->queue);
+	return win->fences[win->front];
+}
+
+static void danteReadbackJob(DanteRenderJob* job)
+{
+	DanteWindowObject* win = &job->obj->d.win;
+	DanteReadback* rb = (DanteReadback*)job->arg;
+	const SDL_Rect* rect = rb->rect;
+	const Uint8* src;
+	
+	rb->ok = false;
+	if (win->canvas) {
+		/* the canvas holds the presented frame */
+		rb->ok = (SDL_SetRenderTarget(win->render, win->canvas) == 0 &&
+		          SDL_RenderReadPixels(win->render, rect, SDL_PIXELFORMAT_RGBA32, rb->dst, rect->w * 4) == 0);
+		SDL_SetRenderTarget(win->render, NULL);
+		
+	} else if (win->surface) {
+		if (rect->x + rect->w <= win->surface->w && rect->y + rect->h <= win->surface->h) {
+			src = (const Uint8*)win->surface->pixels + rect->y * win->surface->pitch + rect->x * 4;
+			rb->ok = (SDL_ConvertPixels(rect->w, rect->h, win->surface->format->format, src, win->surface->pitch,
+			                            SDL_PIXELFORMAT_RGBA32, rb->dst, rect->w * 4) == 0);
+		}
+	}
+	/* else: backbuffer contents are undefined after presenting */
+}
+
+UDboolean DANTEAPIENTRY danteRenderReadPixels(DanteObject* obj, const SDL_Rect* rect, void* dst)
+{
+	DanteReadback rb;
+	
+	rb.rect = rect;
+	rb.dst = dst;
+	danteQueueCall(obj->d.win.queue, danteReadbackJob, obj, &rb);
+	return rb.ok;
+}
+
+void DANTEAPIENTRY danteRenderSetColor(DanteObject* obj, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	win->color.r = r;
+	win->color.g = g;
+	win->color.b = b;
+	win->color.a = a;
+}
+
+void DANTEAPIENTRY danteRenderFillRect(DanteObject* obj, const SDL_Rect* rect)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteDisplayList* list = &win->lists[1 - win->front];
+	DanteDrawCmd* cmd;
+	
+	if (danteListReserve(list, 1, 0)) {
+		cmd = &list->cmds[list->num_cmds++];
+		cmd->op = DANTE_CMD_FILL;
+		cmd->has_src = false;
+		cmd->has_dst = (rect != NULL);
+		cmd->color = win->color;
+		cmd->tex = NULL;
+		if (rect) {
+			cmd->dst = *rect;
+		}
+	}
+}
+
+void DANTEAPIENTRY danteRenderCopy(DanteObject* obj, SDL_Texture* tex, const SDL_Rect* src, const SDL_Rect* dst)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteDisplayList* list = &win->lists[1 - win->front];
+	DanteDrawCmd* cmd;
+	
+	if (danteListReserve(list, 1, 0)) {
+		cmd = &list->cmds[list->num_cmds++];
+		cmd->op = DANTE_CMD_COPY;
+		cmd->has_src = (src != NULL);
+		cmd->has_dst = (dst != NULL);
+		cmd->tex = tex;
+		if (src) {
+			cmd->src = *src;
+		}
+		if (dst) {
+			cmd->dst = *dst;
+		}
+	}
+}
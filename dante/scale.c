@@ -0,0 +1,547 @@
+/* scale.c: Image scaling.
+ *
+ * Scales pixmap pixels for layers. UDESK_FASTEST uses a vectorized
+ * bilinear filter, or nearest neighbour sampling when shrinking to
+ * half the size or less, UDESK_NICEST uses a separable Lanczos filter
+ * whose kernel is widened when downscaling, so that every source pixel
+ * contributes. Large images are split in bands of rows, scaled in
+ * parallel by the context worker threads.
+ *
+ * Copyright (C) 2012-2013 Lorenzo Cogotti
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met: 
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required. 
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dante.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DANTE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DANTE_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+/* Rows scaled by each task. */
+#define DANTE_SCALE_BAND 32
+/* Images with fewer destination pixels are scaled by the calling
+ * thread alone.
+ */
+#define DANTE_SCALE_PARALLEL (256 * 256)
+/* Lanczos kernel radius, in source pixels when upscaling. */
+#define DANTE_LANCZOS_RADIUS 3
+/* Fixed point precision of Lanczos weights. */
+#define DANTE_WEIGHT_BITS 14
+/* Fixed point precision of bilinear fractions. */
+#define DANTE_FRAC_BITS 7
+#define DANTE_FRAC_ONE (1 << DANTE_FRAC_BITS)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Bilinear row kernel, blends rows 'row0' and 'row1' by 'fy' and
+ * samples 'count' pixels at the 'xs' columns, blending each with the
+ * next column by 'fx'.
+ */
+typedef void (*DanteBilinearFunc)(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count);
+
+/* Lanczos filter along one axis, mapping a source size to a
+ * destination size.
+ */
+typedef struct DanteFilter_s {
+	/* weights for each destination pixel. */
+	int taps;
+	/* first source pixel of each destination pixel. */
+	int* start;
+	/* 'taps' weights for each destination pixel. */
+	Sint32* weights;
+} DanteFilter;
+
+/* Scaling state, shared by the tasks of a danteScaleSurface() call. */
+typedef struct DanteScale_s {
+	SDL_Surface* dst;
+	const SDL_Surface* src;
+	/* rows handled by each task. */
+	int band;
+	/* source column of each destination column, for nearest and
+	 * bilinear sampling, and bilinear column fractions.
+	 */
+	int* xs;
+	Uint8* fx;
+	/* Lanczos filters. */
+	DanteFilter horz;
+	DanteFilter vert;
+	/* Lanczos horizontal pass output, dst->w x src->h pixels. */
+	Uint8* tmp;
+} DanteScale;
+
+/* Lanczos kernel. */
+static double danteLanczos(double x);
+/* Fills 'filter' for scaling 'src' pixels to 'dst', it returns
+ * false if out of memory.
+ */
+static UDboolean danteFilterInit(DanteFilter* filter, int src, int dst);
+/* Frees the 'filter' buffers. */
+static void danteFilterClear(DanteFilter* filter);
+/* Converts the weighted sum 'acc' to an 8 bit value. */
+static Uint8 danteWeighted(Sint32 acc);
+/* Bilinear row kernels. */
+static void danteBilinearRow(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count);
+#ifdef DANTE_HAVE_SSE2
+static void danteBilinearRowSSE2(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count);
+#endif
+#ifdef DANTE_HAVE_NEON
+static void danteBilinearRowNEON(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count);
+#endif
+/* Scaling tasks, 'index' is the band of destination rows, or of
+ * source rows for the Lanczos horizontal pass.
+ */
+static void danteNearestTask(void* data, UDint index);
+static void danteBilinearTask(void* data, UDint index);
+static void danteHorizontalTask(void* data, UDint index);
+static void danteVerticalTask(void* data, UDint index);
+/* Runs 'run' over 'rows' rows, in bands when worth it. */
+static void danteScaleRun(DanteScale* scale, DanteTaskproc run, int rows);
+
+/* Bilinear row kernel selected by danteInitScale(). */
+static DanteBilinearFunc dante_bilinear_row = danteBilinearRow;
+
+static double danteLanczos(double x)
+{
+	if (x < 0.0) {
+		x = -x;
+	}
+	if (x < 1e-8) {
+		return 1.0;
+	}
+	if (x >= DANTE_LANCZOS_RADIUS) {
+		return 0.0;
+	}
+	
+	x *= M_PI;
+	return DANTE_LANCZOS_RADIUS * sin(x) * sin(x / DANTE_LANCZOS_RADIUS) / (x * x);
+}
+
+static UDboolean danteFilterInit(DanteFilter* filter, int src, int dst)
+{
+	double ratio = (double)src / dst;
+	double scale = (ratio > 1.0)? ratio : 1.0;
+	double support = DANTE_LANCZOS_RADIUS * scale;
+	double* row;
+	int o;
+	
+	filter->taps = (int)ceil(support) * 2 + 1;
+	filter->start = NULL;
+	filter->weights = NULL;
+	if ((size_t)dst > (size_t)-1 / sizeof(*filter->weights) / filter->taps) {
+		return false;
+	}
+	
+	filter->start = (int*)malloc(dst * sizeof(*filter->start));
+	filter->weights = (Sint32*)malloc((size_t)dst * filter->taps * sizeof(*filter->weights));
+	row = (double*)malloc(filter->taps * sizeof(*row));
+	if (!filter->start || !filter->weights || !row) {
+		free(row);
+		danteFilterClear(filter);
+		return false;
+	}
+	
+	for (o = 0; o < dst; o++) {
+		Sint32* weights = filter->weights + (size_t)o * filter->taps;
+		double center = (o + 0.5) * ratio;
+		double sum = 0.0;
+		Sint32 total = 0;
+		int left = (int)floor(center - support);
+		int start = left;
+		int best = 0;
+		int i, k;
+		
+		/* keep the window inside the source, pixels past the
+		 * edges fold onto the edge pixels
+		 */
+		if (start > src - filter->taps) {
+			start = src - filter->taps;
+		}
+		if (start < 0) {
+			start = 0;
+		}
+		
+		memset(row, 0, filter->taps * sizeof(*row));
+		for (k = 0; k < filter->taps; k++) {
+			double w = danteLanczos((left + k + 0.5 - center) / scale);
+			
+			i = left + k;
+			if (i < 0) {
+				i = 0;
+			} else if (i >= src) {
+				i = src - 1;
+			}
+			
+			row[i - start] += w;
+			sum += w;
+		}
+		for (k = 0; k < filter->taps; k++) {
+			weights[k] = (Sint32)floor(row[k] / sum * (1 << DANTE_WEIGHT_BITS) + 0.5);
+			total += weights[k];
+			if (weights[k] > weights[best]) {
+				best = k;
+			}
+		}
+		
+		/* weights must add up exactly, flat areas stay flat */
+		weights[best] += (1 << DANTE_WEIGHT_BITS) - total;
+		filter->start[o] = start;
+	}
+	
+	free(row);
+	return true;
+}
+
+static void danteFilterClear(DanteFilter* filter)
+{
+	free(filter->start);
+	free(filter->weights);
+	filter->start = NULL;
+	filter->weights = NULL;
+}
+
+static Uint8 danteWeighted(Sint32 acc)
+{
+	/* Lanczos lobes may overshoot either way */
+	if (acc <= 0) {
+		return 0;
+	}
+	
+	acc = (acc + (1 << (DANTE_WEIGHT_BITS - 1))) >> DANTE_WEIGHT_BITS;
+	return (acc > 255)? 255 : (Uint8)acc;
+}
+
+static void danteBilinearRow(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count)
+{
+	int i, c;
+	
+	for (i = 0; i < count; i++) {
+		const Uint8* p0 = row0 + xs[i] * 4;
+		const Uint8* p1 = row1 + xs[i] * 4;
+		
+		for (c = 0; c < 4; c++) {
+			/* same rounding as the vector kernels */
+			int left = (p0[c] * (DANTE_FRAC_ONE - fy) + p1[c] * fy) >> DANTE_FRAC_BITS;
+			int right = (p0[c + 4] * (DANTE_FRAC_ONE - fy) + p1[c + 4] * fy) >> DANTE_FRAC_BITS;
+			
+			dst[c] = (Uint8)((left * (DANTE_FRAC_ONE - fx[i]) + right * fx[i]) >> DANTE_FRAC_BITS);
+		}
+		
+		dst += 4;
+	}
+}
+
+#ifdef DANTE_HAVE_SSE2
+
+static void danteBilinearRowSSE2(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wy0 = _mm_set1_epi16((short)(DANTE_FRAC_ONE - fy));
+	const __m128i wy1 = _mm_set1_epi16((short)fy);
+	__m128i top;
+	__m128i bottom;
+	__m128i v;
+	__m128i wx;
+	int i;
+	
+	for (i = 0; i < count; i++) {
+		/* both columns of both rows, 16 bits per channel */
+		top = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row0 + xs[i] * 4)), zero);
+		bottom = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row1 + xs[i] * 4)), zero);
+		v = _mm_add_epi16(_mm_mullo_epi16(top, wy0), _mm_mullo_epi16(bottom, wy1));
+		v = _mm_srli_epi16(v, DANTE_FRAC_BITS);
+		
+		/* left column in the low half, right one in the high half */
+		wx = _mm_set_epi16(fx[i], fx[i], fx[i], fx[i], DANTE_FRAC_ONE - fx[i], DANTE_FRAC_ONE - fx[i], DANTE_FRAC_ONE - fx[i], DANTE_FRAC_ONE - fx[i]);
+		v = _mm_mullo_epi16(v, wx);
+		v = _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_si128(v, 8)), DANTE_FRAC_BITS);
+		*(Uint32*)(dst + i * 4) = (Uint32)_mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+	}
+}
+
+#endif /* DANTE_HAVE_SSE2 */
+
+#ifdef DANTE_HAVE_NEON
+
+static void danteBilinearRowNEON(Uint8* dst, const Uint8* row0, const Uint8* row1, const int* xs, const Uint8* fx, int fy, int count)
+{
+	const uint16x8_t wy0 = vdupq_n_u16((uint16_t)(DANTE_FRAC_ONE - fy));
+	const uint16x8_t wy1 = vdupq_n_u16((uint16_t)fy);
+	uint16x8_t v;
+	uint16x4_t h;
+	int i;
+	
+	for (i = 0; i < count; i++) {
+		v = vmulq_u16(vmovl_u8(vld1_u8(row0 + xs[i] * 4)), wy0);
+		v = vshrq_n_u16(vmlaq_u16(v, vmovl_u8(vld1_u8(row1 + xs[i] * 4)), wy1), DANTE_FRAC_BITS);
+		h = vmul_u16(vget_low_u16(v), vdup_n_u16((uint16_t)(DANTE_FRAC_ONE - fx[i])));
+		h = vshr_n_u16(vmla_u16(h, vget_high_u16(v), vdup_n_u16(fx[i])), DANTE_FRAC_BITS);
+		vst1_lane_u32((uint32_t*)(dst + i * 4), vreinterpret_u32_u8(vmovn_u16(vcombine_u16(h, h))), 0);
+	}
+}
+
+#endif /* DANTE_HAVE_NEON */
+
+static void danteNearestTask(void* data, UDint index)
+{
+	DanteScale* scale = (DanteScale*)data;
+	const SDL_Surface* src = scale->src;
+	SDL_Surface* dst = scale->dst;
+	int y = index * scale->band;
+	int end = (y + scale->band < dst->h)? y + scale->band : dst->h;
+	
+	for (; y < end; y++) {
+		const Uint32* row = (const Uint32*)((const Uint8*)src->pixels + (int)((y + 0.5) * src->h / dst->h) * src->pitch);
+		Uint32* out = (Uint32*)((Uint8*)dst->pixels + y * dst->pitch);
+		int x;
+		
+		for (x = 0; x < dst->w; x++) {
+			out[x] = row[scale->xs[x]];
+		}
+	}
+}
+
+static void danteBilinearTask(void* data, UDint index)
+{
+	DanteScale* scale = (DanteScale*)data;
+	const SDL_Surface* src = scale->src;
+	SDL_Surface* dst = scale->dst;
+	int y = index * scale->band;
+	int end = (y + scale->band < dst->h)? y + scale->band : dst->h;
+	
+	for (; y < end; y++) {
+		double sy = (y + 0.5) * src->h / dst->h - 0.5;
+		int y0, y1, fy;
+		
+		if (sy < 0.0) {
+			sy = 0.0;
+		}
+		
+		y0 = (int)sy;
+		fy = (int)((sy - y0) * DANTE_FRAC_ONE + 0.5);
+		if (y0 >= src->h - 1) {
+			y0 = src->h - 1;
+			fy = 0;
+		}
+		
+		y1 = (y0 + 1 < src->h)? y0 + 1 : y0;
+		dante_bilinear_row((Uint8*)dst->pixels + y * dst->pitch,
+		                   (const Uint8*)src->pixels + y0 * src->pitch,
+		                   (const Uint8*)src->pixels + y1 * src->pitch,
+		                   scale->xs, scale->fx, fy, dst->w);
+	}
+}
+
+static void danteHorizontalTask(void* data, UDint index)
+{
+	DanteScale* scale = (DanteScale*)data;
+	const SDL_Surface* src = scale->src;
+	const DanteFilter* horz = &scale->horz;
+	int w = scale->dst->w;
+	int y = index * scale->band;
+	int end = (y + scale->band < src->h)? y + scale->band : src->h;
+	
+	for (; y < end; y++) {
+		const Uint8* row = (const Uint8*)src->pixels + y * src->pitch;
+		Uint8* out = scale->tmp + (size_t)y * w * 4;
+		int x, k;
+		
+		for (x = 0; x < w; x++) {
+			const Sint32* weights = horz->weights + (size_t)x * horz->taps;
+			const Uint8* p = row + horz->start[x] * 4;
+			Sint32 acc[4] = { 0, 0, 0, 0 };
+			int taps = horz->taps;
+			
+			if (taps > src->w) {
+				taps = src->w;
+			}
+			for (k = 0; k < taps; k++, p += 4) {
+				acc[0] += weights[k] * p[0];
+				acc[1] += weights[k] * p[1];
+				acc[2] += weights[k] * p[2];
+				acc[3] += weights[k] * p[3];
+			}
+			
+			out[0] = danteWeighted(acc[0]);
+			out[1] = danteWeighted(acc[1]);
+			out[2] = danteWeighted(acc[2]);
+			out[3] = danteWeighted(acc[3]);
+			out += 4;
+		}
+	}
+}
+
+static void danteVerticalTask(void* data, UDint index)
+{
+	DanteScale* scale = (DanteScale*)data;
+	const DanteFilter* vert = &scale->vert;
+	SDL_Surface* dst = scale->dst;
+	int pitch = dst->w * 4;
+	int taps = (vert->taps < scale->src->h)? vert->taps : scale->src->h;
+	int y = index * scale->band;
+	int end = (y + scale->band < dst->h)? y + scale->band : dst->h;
+	
+	for (; y < end; y++) {
+		const Sint32* weights = vert->weights + (size_t)y * vert->taps;
+		const Uint8* column = scale->tmp + (size_t)vert->start[y] * pitch;
+		Uint8* out = (Uint8*)dst->pixels + y * dst->pitch;
+		int x, k;
+		
+		for (x = 0; x < dst->w; x++) {
+			const Uint8* p = column + x * 4;
+			Sint32 acc[4] = { 0, 0, 0, 0 };
+			Uint8 a;
+			
+			for (k = 0; k < taps; k++, p += pitch) {
+				acc[0] += weights[k] * p[0];
+				acc[1] += weights[k] * p[1];
+				acc[2] += weights[k] * p[2];
+				acc[3] += weights[k] * p[3];
+			}
+			
+			/* premultiplied channels can't exceed alpha */
+			a = danteWeighted(acc[3]);
+			out[0] = SDL_min(danteWeighted(acc[0]), a);
+			out[1] = SDL_min(danteWeighted(acc[1]), a);
+			out[2] = SDL_min(danteWeighted(acc[2]), a);
+			out[3] = a;
+			out += 4;
+		}
+	}
+}
+
+static void danteScaleRun(DanteScale* scale, DanteTaskproc run, int rows)
+{
+	if (scale->dst->w * rows < DANTE_SCALE_PARALLEL) {
+		scale->band = rows;
+		run(scale, 0);
+		return;
+	}
+	
+	scale->band = DANTE_SCALE_BAND;
+	danteRunTasks(run, scale, (rows + DANTE_SCALE_BAND - 1) / DANTE_SCALE_BAND);
+}
+
+void DANTEAPIENTRY danteInitScale(void)
+{
+#ifdef DANTE_HAVE_SSE2
+	if (SDL_HasSSE2()) {
+		dante_bilinear_row = danteBilinearRowSSE2;
+	}
+#endif
+#ifdef DANTE_HAVE_NEON
+	if (SDL_HasNEON()) {
+		dante_bilinear_row = danteBilinearRowNEON;
+	}
+#endif
+}
+
+UDboolean DANTEAPIENTRY danteScaleSurface(SDL_Surface* dst, const SDL_Surface* src, UDenum filter)
+{
+	DanteScale scale;
+	UDboolean ret = true;
+	int x, y;
+	
+	if (dst->w == src->w && dst->h == src->h) {
+		for (y = 0; y < dst->h; y++) {
+			memcpy((Uint8*)dst->pixels + y * dst->pitch, (const Uint8*)src->pixels + y * src->pitch, dst->w * 4);
+		}
+		
+		return true;
+	}
+	
+	memset(&scale, 0, sizeof(scale));
+	scale.dst = dst;
+	scale.src = src;
+	if (filter == UDESK_NICEST) {
+		/* the horizontal pass output may be larger than both surfaces */
+		if ((size_t)dst->w <= (size_t)-1 / 4 / src->h) {
+			scale.tmp = (Uint8*)malloc((size_t)dst->w * src->h * 4);
+		}
+		if (!scale.tmp || !danteFilterInit(&scale.horz, src->w, dst->w) || !danteFilterInit(&scale.vert, src->h, dst->h)) {
+			ret = false;
+		} else {
+			danteScaleRun(&scale, danteHorizontalTask, src->h);
+			danteScaleRun(&scale, danteVerticalTask, dst->h);
+		}
+		
+		danteFilterClear(&scale.horz);
+		danteFilterClear(&scale.vert);
+		free(scale.tmp);
+		return ret;
+	}
+	
+	scale.xs = (int*)malloc(dst->w * sizeof(*scale.xs));
+	scale.fx = (Uint8*)malloc(dst->w);
+	if (!scale.xs || !scale.fx) {
+		free(scale.xs);
+		free(scale.fx);
+		return false;
+	}
+	
+	if (src->w < 2 || (dst->w * 2 <= src->w && dst->h * 2 <= src->h)) {
+		/* bilinear sampling would skip most pixels anyway */
+		for (x = 0; x < dst->w; x++) {
+			scale.xs[x] = (int)((x + 0.5) * src->w / dst->w);
+		}
+		
+		danteScaleRun(&scale, danteNearestTask, dst->h);
+		
+	} else {
+		for (x = 0; x < dst->w; x++) {
+			double sx = (x + 0.5) * src->w / dst->w - 0.5;
+			int x0;
+			
+			if (sx < 0.0) {
+				sx = 0.0;
+			}
+			
+			/* the next column is always sampled, keep it inside */
+			x0 = (int)sx;
+			scale.fx[x] = (Uint8)((sx - x0) * DANTE_FRAC_ONE + 0.5);
+			if (x0 >= src->w - 1) {
+				x0 = src->w - 2;
+				scale.fx[x] = DANTE_FRAC_ONE;
+			}
+			
+			scale.xs[x] = x0;
+		}
+		
+		danteScaleRun(&scale, danteBilinearTask, dst->h);
+	}
+	
+	free(scale.xs);
+	free(scale.fx);
+	return true;
+}
@@ -29,6 +29,8 @@
  */
 
 #include "dante.h"
+#include <stdlib.h>
+#include <string.h>
 
 /* default window title. */
 #define DANTE_WINDOW_TITLE "udesk window"
@@ -39,16 +41,95 @@
 /* default window height. */
 #define DANTE_WINDOW_HEIGHT 240
 
+/* Window properties waiting to be applied, see DanteWindowObject 'pending'. */
+#define DANTE_WINDOW_SET_POSITION 0x01
+#define DANTE_WINDOW_SET_SIZE     0x02
+#define DANTE_WINDOW_SET_TITLE    0x04
+#define DANTE_WINDOW_SET_RESIZE   0x08
+#define DANTE_WINDOW_SET_MODE     0x10
+#define DANTE_WINDOW_SET_DECORATE 0x20
+
+/* Packs a renderer driver index and renderer flags for the context probe. */
+#define DANTE_PROBE(index, flags) ((((index) + 1) << 8) | (flags))
+/* Renderer driver index of a packed probe. */
+#define DANTE_PROBE_INDEX(probe) (((probe) >> 8) - 1)
+/* Renderer flags of a packed probe. */
+#define DANTE_PROBE_FLAGS(probe) ((Uint32)(probe) & 0xff)
+
 /* Creates a window renderer, according to the current context.
  * If context requires vsync but it could not be obtained, a
  * renderer with no vertical sync is created.
+ * Headless contexts create a software renderer drawing into a new
+ * 'w' x 'h' surface, returned into 'surface'.
  * It returns NULL if creation was unsuccessful.
  */
-static SDL_Renderer* danteCreateWindowRenderer(SDL_Window* window);
+static SDL_Renderer* danteCreateWindowRenderer(SDL_Window* window, int w, int h, SDL_Surface** surface);
+/* Stores the driver index of 'render', created with 'flags', into
+ * the context probe, so that later renderers skip probing.
+ */
+static void danteCacheRendererProbe(SDL_Renderer* render, Uint32 flags);
+/* Stores into 'tile' the texture tile size for 'render'. */
+static void danteRendererTile(SDL_Renderer* render, SDL_Point* tile);
+/* Creates a default sized hidden SDL window, it returns NULL on failure. */
+static SDL_Window* danteCreateSDLWindow(void);
+/* Creates the SDL window and renderer of 'obj', if not created yet,
+ * applying the properties stored in the window object.
+ * It returns false on failure.
+ */
+static UDboolean danteRealizeWindow(DanteObject* obj);
+/* Applies the pending properties of the window 'obj' in one batch,
+ * resulting in at most one relayout, the window is realized if its
+ * mode leaves UDESK_WINDOW_HIDDEN.
+ */
+static void danteWindowCommit(DanteObject* obj);
+/* Window render jobs, creating the SDL window, sized as the SDL_Rect
+ * 'arg', and its renderer, replacing the headless rendering surface
+ * and its renderer with ones as large as the SDL_Rect 'arg' (leaving
+ * them untouched on failure), and destroying the window renderer
+ * along with its resources and the SDL window. Windows are created
+ * and destroyed by the thread owning their renderer, as required
+ * by several SDL backends.
+ */
+static void danteWindowSetupJob(DanteRenderJob* job);
+static void danteWindowResizeJob(DanteRenderJob* job);
+static void danteWindowTeardownJob(DanteRenderJob* job);
+/* Window pool render jobs, creating and destroying the SDL window
+ * and renderer of the DantePooledWindow 'arg'.
+ */
+static void danteWindowPoolJob(DanteRenderJob* job);
+static void danteWindowUnpoolJob(DanteRenderJob* job);
 /* Maps the window as specified by the 'mode' parameter,
  * sets the context error accordingly on failure or invalid mode.
  */
 static void danteSetWindowMode(SDL_Window* win, UDint mode);
+/* Resolves the object under the pointer position of the input event
+ * 'ev' using the window spatial index, NULL if the position lies
+ * outside any laid out object.
+ */
+static DanteObject* danteWindowPick(DanteObject* obj, const DanteObject* ev);
+/* Sends a synthesized 'type' event to 'to', originated from the SDL
+ * event 'sev', preserving the context current event.
+ */
+static void danteWindowNotify(const SDL_Event* sev, UDenum type, DanteDispatchID id, DanteObject* to);
+/* Truncates the window hover path to 'depth' objects, sending leave
+ * events to the removed ones (deepest first) when 'sev' isn't NULL.
+ */
+static void danteWindowTruncateHover(DanteObject* obj, UDint depth, const SDL_Event* sev);
+/* Updates the window hover path so that it ends with 'target',
+ * only the objects that actually changed receive leave or enter
+ * events.
+ */
+static void danteWindowUpdateHover(DanteObject* obj, DanteObject* target, const SDL_Event* sev);
+/* Redraws the damaged region of the window and presents it, the
+ * window display list is recorded again first if any object was
+ * invalidated, then replayed over the damaged rectangles.
+ * It returns the fence of the submitted frame.
+ */
+static Uint32 danteWindowRepaint(DanteObject* obj, UDboolean notify);
+/* Returns the statistics of the last frame of the window 'obj', the
+ * render thread writes them, so the frame is waited for first.
+ */
+static const DanteFrameStats* danteWindowStats(DanteObject* obj);
 /* Window event dispatch table handlers. */
 static void danteWindowEnterHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
 static void danteWindowLeaveHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
@@ -56,15 +137,50 @@ static void danteWindowFocusHandler(DanteObject* obj, DanteDispatchID id, DanteO
 static void danteWindowDrawHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
 static void danteWindowMotionHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
 static void danteWindowDestroyHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+static void danteWindowKeyHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+static void danteWindowButtonHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+static void danteWindowTouchHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
+static void danteWindowFlushedHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev);
 /* Window virtual table handlers. */
 static void danteWindowRegisterHandler(DanteObject* obj, UDenum param, UDhandlerproc proc);
+static void danteWindowBegin(DanteObject* obj, UDenum mode);
+static void danteWindowEnd(DanteObject* obj);
 static void danteWindowFlush(DanteObject* obj);
+static Uint32 danteWindowSubmit(DanteObject* obj, UDboolean notify);
 static void danteWindowClear(DanteObject* obj);
+static void danteWindowRetire(DanteObject* obj);
 
-static SDL_Renderer* danteCreateWindowRenderer(SDL_Window* window)
+static SDL_Renderer* danteCreateWindowRenderer(SDL_Window* window, int w, int h, SDL_Surface** surface)
 {
 	SDL_Renderer* ret;
 	Uint32 flags;
+	int probe;
+	
+	if (dante_context->headless) {
+		*surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+		if (!*surface) {
+			return NULL;
+		}
+		
+		ret = SDL_CreateSoftwareRenderer(*surface);
+		if (!ret) {
+			SDL_FreeSurface(*surface);
+			*surface = NULL;
+		}
+		
+		return ret;
+	}
+	
+	/* the outcome of probing doesn't change within a context,
+	 * reuse the driver found by the first window
+	 */
+	probe = SDL_AtomicGet(&dante_context->probe);
+	if (probe) {
+		ret = SDL_CreateRenderer(window, DANTE_PROBE_INDEX(probe), DANTE_PROBE_FLAGS(probe));
+		if (ret) {
+			return ret;
+		}
+	}
 	
 	flags = 0;
 	if (dante_context->vsync) {
@@ -84,10 +200,167 @@ static SDL_Renderer* danteCreateWindowRenderer(SDL_Window* window)
 		flags &= ~SDL_RENDERER_PRESENTVSYNC;
 		ret = SDL_CreateRenderer(window, -1, flags);
 	}
+	if (ret) {
+		danteCacheRendererProbe(ret, flags);
+	}
 	
 	return ret;
 }
 
+static void danteCacheRendererProbe(SDL_Renderer* render, Uint32 flags)
+{
+	SDL_RendererInfo info;
+	SDL_RendererInfo driver;
+	int i;
+	int n;
+	
+	if (SDL_GetRendererInfo(render, &info) < 0) {
+		return;
+	}
+	
+	n = SDL_GetNumRenderDrivers();
+	for (i = 0; i < n; i++) {
+		if (SDL_GetRenderDriverInfo(i, &driver) == 0 && strcmp(driver.name, info.name) == 0) {
+			SDL_AtomicSet(&dante_context->probe, DANTE_PROBE(i, flags));
+			break;
+		}
+	}
+}
+
+static void danteRendererTile(SDL_Renderer* render, SDL_Point* tile)
+{
+	SDL_RendererInfo info;
+	
+	tile->x = DANTE_TEXTURE_TILE;
+	tile->y = DANTE_TEXTURE_TILE;
+	if (SDL_GetRendererInfo(render, &info) < 0) {
+		return;
+	}
+	
+	/* software renderers report no limit */
+	if (info.max_texture_width > 0) {
+		tile->x = SDL_min(tile->x, info.max_texture_width);
+	}
+	if (info.max_texture_height > 0) {
+		tile->y = SDL_min(tile->y, info.max_texture_height);
+	}
+}
+
+static SDL_Window* danteCreateSDLWindow(void)
+{
+	return SDL_CreateWindow(DANTE_WINDOW_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+	                        DANTE_WINDOW_WIDTH, DANTE_WINDOW_HEIGHT, SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE);
+}
+
+static UDboolean danteRealizeWindow(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DantePooledWindow* pooled;
+	SDL_Rect size;
+	
+	if (win->swin) {
+		return true;
+	}
+	
+	size.x = 0;
+	size.y = 0;
+	size.w = win->geometry.w;
+	size.h = win->geometry.h;
+	if (dante_context->num_pooled > 0) {
+		/* pooled windows are created with default properties */
+		pooled = &dante_context->pool[--dante_context->num_pooled];
+		win->swin = pooled->swin;
+		win->render = pooled->render;
+		win->tile = pooled->tile;
+		win->surface = pooled->surface;
+		win->queue = pooled->queue;
+		if (win->title) {
+			SDL_SetWindowTitle(win->swin, win->title);
+		}
+		if (win->geometry.x != SDL_WINDOWPOS_UNDEFINED) {
+			SDL_SetWindowPosition(win->swin, win->geometry.x, win->geometry.y);
+		}
+		if (size.w != DANTE_WINDOW_WIDTH || size.h != DANTE_WINDOW_HEIGHT) {
+			SDL_SetWindowSize(win->swin, size.w, size.h);
+			if (dante_context->headless) {
+				danteQueueCall(win->queue, danteWindowResizeJob, obj, &size);
+			}
+		}
+		
+	} else {
+		/* the window and its renderer belong to the render queue */
+		win->queue = &dante_context->render[dante_context->next_queue];
+		dante_context->next_queue = (dante_context->next_queue + 1) % DANTE_RENDER_QUEUES;
+		danteQueueCall(win->queue, danteWindowSetupJob, obj, &size);
+		if (!win->swin) {
+			win->queue = NULL;
+			return false;
+		}
+	}
+	
+	if (!win->decorated) {
+		SDL_SetWindowBordered(win->swin, SDL_FALSE);
+	}
+	if (!win->resizable) {
+		SDL_SetWindowResizable(win->swin, SDL_FALSE);
+	}
+	
+	/* install an userspace identifier to retrieve an object from a
+	 * SDL window handle.
+	 */
+	SDL_SetWindowData(win->swin, DANTE_WINDOW_OBJECT, obj);
+	SDL_GetWindowPosition(win->swin, &win->geometry.x, &win->geometry.y);
+	free(win->title);
+	win->title = NULL;
+	danteInvalidateObject(obj);
+	return true;
+}
+
+static void danteWindowCommit(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	Uint32 pending = win->pending;
+	
+	win->pending = 0;
+	if (!win->swin) {
+		/* stored properties are applied on realization */
+		if ((pending & DANTE_WINDOW_SET_SIZE) &&
+		    (win->geometry.w != win->grid.width || win->geometry.h != win->grid.height)) {
+			danteWindowResize(obj, win->geometry.w, win->geometry.h);
+		}
+		if (!(pending & DANTE_WINDOW_SET_MODE) || win->mode == UDESK_WINDOW_HIDDEN) {
+			return;
+		}
+		
+		DANTE_ERROR_IF(!danteRealizeWindow(obj), UDESK_OPERATION_FAILED);
+		
+		danteSetWindowMode(win->swin, win->mode);
+		return;
+	}
+	
+	if (pending & DANTE_WINDOW_SET_TITLE) {
+		SDL_SetWindowTitle(win->swin, win->title);
+		free(win->title);
+		win->title = NULL;
+	}
+	if (pending & DANTE_WINDOW_SET_DECORATE) {
+		SDL_SetWindowBordered(win->swin, win->decorated);
+	}
+	if (pending & DANTE_WINDOW_SET_RESIZE) {
+		SDL_SetWindowResizable(win->swin, win->resizable);
+	}
+	if (pending & DANTE_WINDOW_SET_POSITION) {
+		SDL_SetWindowPosition(win->swin, win->geometry.x, win->geometry.y);
+	}
+	if (pending & DANTE_WINDOW_SET_SIZE) {
+		/* relayout once SDL reports the new size */
+		SDL_SetWindowSize(win->swin, win->geometry.w, win->geometry.h);
+	}
+	if (pending & DANTE_WINDOW_SET_MODE) {
+		danteSetWindowMode(win->swin, win->mode);
+	}
+}
+
 static void danteSetWindowMode(SDL_Window* win, UDint mode)
 {
 	switch (mode) {
@@ -115,29 +388,131 @@ static void danteSetWindowMode(SDL_Window* win, UDint mode)
 	}
 }
 
+static DanteObject* danteWindowPick(DanteObject* obj, const DanteObject* ev)
+{
+	const DanteGrid* grid = &obj->d.win.grid;
+	const SDL_Event* sev = ev->d.ev.sev;
+	
+	if (!sev) {
+		return NULL;
+	}
+	
+	switch (sev->type) {
+	case SDL_MOUSEMOTION:
+		return danteGridPick(grid, sev->motion.x, sev->motion.y);
+	
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		return danteGridPick(grid, sev->button.x, sev->button.y);
+	
+	case SDL_FINGERDOWN:
+	case SDL_FINGERUP:
+	case SDL_FINGERMOTION:
+		/* the grid always covers the whole window */
+		return danteGridPick(grid, (UDint)(sev->tfinger.x * grid->width), (UDint)(sev->tfinger.y * grid->height));
+	
+	default:
+		return NULL;
+	}
+}
+
+static void danteWindowNotify(const SDL_Event* sev, UDenum type, DanteDispatchID id, DanteObject* to)
+{
+	DanteObject* saved = dante_context->ev;
+	
+	danteGenerateFrom(sev, type);
+	dantePropagateEvent(id, NULL, to);
+	danteFinishEvent();
+	dante_context->ev = saved;
+}
+
+static void danteWindowTruncateHover(DanteObject* obj, UDint depth, const SDL_Event* sev)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	while (win->hover_depth > depth) {
+		DanteObject* node = win->hover[--win->hover_depth];
+		
+		win->hover[win->hover_depth] = NULL;
+		if (sev) {
+			danteWindowNotify(sev, UDESK_EVENT_LEAVE, DANTE_LEAVE_DISPATCH_ID, node);
+		}
+		
+		danteUnrefObject(node);
+	}
+}
+
+static void danteWindowUpdateHover(DanteObject* obj, DanteObject* target, const SDL_Event* sev)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteObject* path[DANTE_HOVER_DEPTH];
+	DanteObject* it;
+	UDint depth;
+	UDint common;
+	UDint i;
+	
+	if (win->hover_depth > 0 && win->hover[win->hover_depth - 1] == target) {
+		/* pointer still over the same object, nothing changed */
+		return;
+	}
+	
+	/* collect the new path, it is filled backwards, deeper objects
+	 * beyond DANTE_HOVER_DEPTH are discarded.
+	 */
+	depth = 0;
+	for (it = target; it && it != obj; it = it->parent) {
+		depth++;
+	}
+	
+	i = depth;
+	for (it = target; it && it != obj; it = it->parent) {
+		i--;
+		if (i < DANTE_HOVER_DEPTH) {
+			path[i] = it;
+		}
+	}
+	
+	if (depth > DANTE_HOVER_DEPTH) {
+		depth = DANTE_HOVER_DEPTH;
+	}
+	
+	common = 0;
+	while (common < depth && common < win->hover_depth && win->hover[common] == path[common]) {
+		common++;
+	}
+	
+	danteWindowTruncateHover(obj, common, sev);
+	for (i = common; i < depth; i++) {
+		win->hover[i] = danteRefObject(path[i]);
+		win->hover_depth = i + 1;
+		danteWindowNotify(sev, UDESK_EVENT_ENTER, DANTE_ENTER_DISPATCH_ID, path[i]);
+	}
+}
+
 static void danteWindowEnterHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
 {
 	DanteWindowObject* win = &obj->d.win;
 	
+	(void)id;
+	
+	/* children are entered by the following motion events */
 	if (win->enter) {
 		win->enter(ev->handle);
 	}
-	if (win->child) {
-		dantePropagateEvent(id, NULL, win->child);
-	}
 }
 
 static void danteWindowLeaveHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
 {
 	DanteWindowObject* win = &obj->d.win;
 	
+	(void)id;
+	
 	if (win->leave) {
 		win->leave(ev->handle);
 	}
-	if (win->child) {
-		dantePropagateEvent(id, NULL, win->child);
-		/* TODO, this should be done only for "focused" child */
-	}
+	
+	/* only the hovered objects are left */
+	danteWindowTruncateHover(obj, 0, ev->d.ev.sev);
 }
 
 static void danteWindowFocusHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
@@ -145,32 +520,80 @@ static void danteWindowFocusHandler(DanteObject* obj, DanteDispatchID id, DanteO
 	/* TODO: stub */
 }
 
-static void danteWindowDrawHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+static Uint32 danteWindowRepaint(DanteObject* obj, UDboolean notify)
 {
 	DanteWindowObject* win = &obj->d.win;
-	DanteObject* child = win->child;
+	DanteObject* saved;
 	
-	/* TODO: make the rendering process themeable, a SDL_Renderer
-	 * wrapper would be enough.
-	 */
-	SDL_SetRenderDrawColor(win->render, 128, 128, 128, SDL_ALPHA_OPAQUE);
-	SDL_RenderClear(win->render);
-	if (child) {
-		dantePropagateEvent(id, NULL, child);
+	if (!win->swin) {
+		/* nothing to present before the window is first shown */
+		return 0;
+	}
+	
+	/* evictions mark their windows dirty, trim before recording */
+	danteTrimTextures();
+	if (obj->dirty) {
+		/* draw events are synthesized when flushing outside the event loop */
+		saved = dante_context->ev;
+		danteGenerateFrom((saved)? saved->d.ev.sev : NULL, UDESK_EVENT_DRAW);
+		danteListBegin(obj);
+		/* TODO: make the rendering process themeable, the
+		 * render.c wrappers would be enough.
+		 */
+		danteRenderSetColor(obj, 128, 128, 128, SDL_ALPHA_OPAQUE);
+		danteRenderFillRect(obj, NULL);
+		if (win->child) {
+			danteDrawObject(obj, win->child);
+		}
+		if (!danteListEnd(obj)) {
+			dante_context->error = UDESK_OUT_OF_MEMORY;
+		}
+		
+		danteFinishEvent();
+		dante_context->ev = saved;
 	}
 	
-	danteWindowFlush(obj);
+	return danteRenderFrame(obj, notify);
+}
+
+static const DanteFrameStats* danteWindowStats(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	if (win->queue) {
+		/* the render queue lock orders the writes before the reads */
+		danteQueueWait(win->queue, win->fences[win->front]);
+	}
+	
+	return &win->stats;
+}
+
+static void danteWindowDrawHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	/* exposed windows present their canvas again, only damage is replayed,
+	 * no need to wait for the frame
+	 */
+	danteWindowRepaint(obj, false);
 }
 
 static void danteWindowMotionHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
 {
-	/* TODO: stub, should also perform enter/leave events propagation
-	 * it should propagate the event to its child, if any,
-	 * to do this, the appropriate region should be selected, according
-	 * to the cursor position, notice that the SDL will report enter
-	 * events to the Window itself, it has no notion of "our" objects.
+	DanteWindowObject* win = &obj->d.win;
+	
+	DanteObject* target;
+	
+	if (win->motion) {
+		win->motion(ev->handle);
+	}
+	
+	/* SDL reports enter and leave events for the window itself only,
+	 * synthesize them for the objects under the cursor.
 	 */
-	return;
+	target = danteWindowPick(obj, ev);
+	danteWindowUpdateHover(obj, target, ev->d.ev.sev);
+	if (target) {
+		dantePropagateEvent(id, NULL, target);
+	}
 }
 
 static void danteWindowDestroyHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
@@ -185,6 +608,59 @@ static void danteWindowDestroyHandler(DanteObject* obj, DanteDispatchID id, Dant
 	}
 }
 
+static void danteWindowKeyHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	if (win->keyboard) {
+		win->keyboard(ev->handle);
+	}
+	if (win->child) {
+		dantePropagateEvent(id, NULL, win->child);
+	}
+}
+
+static void danteWindowButtonHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteObject* target;
+	UDhandlerproc proc;
+	
+	proc = (ev->d.ev.type == UDESK_EVENT_PRESS)? win->press : win->release;
+	if (proc) {
+		proc(ev->handle);
+	}
+	
+	target = danteWindowPick(obj, ev);
+	if (target) {
+		dantePropagateEvent(id, NULL, target);
+	}
+}
+
+static void danteWindowTouchHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DanteWindowObject* win = &obj->d.win;
+	DanteObject* target;
+	
+	if (win->touch) {
+		win->touch(ev->handle);
+	}
+	
+	target = danteWindowPick(obj, ev);
+	if (target) {
+		dantePropagateEvent(id, NULL, target);
+	}
+}
+
+static void danteWindowFlushedHandler(DanteObject* obj, DanteDispatchID id, DanteObject* ev)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	if (win->flushed) {
+		win->flushed(ev->handle);
+	}
+}
+
 static void danteWindowRegisterHandler(DanteObject* obj, UDenum param, UDhandlerproc proc)
 {
 	DanteWindowObject* win = &obj->d.win;
@@ -206,35 +682,111 @@ static void danteWindowRegisterHandler(DanteObject* obj, UDenum param, UDhandler
 		win->leave = proc;
 		break;
 	
+	case UDESK_EVENT_KEYBOARD:
+		win->keyboard = proc;
+		break;
+	
+	case UDESK_EVENT_PRESS:
+		win->press = proc;
+		break;
+	
+	case UDESK_EVENT_RELEASE:
+		win->release = proc;
+		break;
+	
+	case UDESK_EVENT_MOTION:
+		win->motion = proc;
+		break;
+	
+	case UDESK_EVENT_TOUCH:
+		win->touch = proc;
+		break;
+	
+	case UDESK_EVENT_FLUSH_EXT:
+		win->flushed = proc;
+		break;
+	
 	default:
 		dante_context->error = UDESK_INVALID_ENUM;
 		break;
 	}
 }
 
+static void danteWindowBegin(DanteObject* obj, UDenum mode)
+{
+	DANTE_ERROR_IF(mode != UDESK_WINDOW_PROPERTIES_EXT, UDESK_INVALID_ENUM);
+	DANTE_ERROR_IF(obj->d.win.building, UDESK_INVALID_OPERATION);
+	
+	obj->d.win.building = true;
+}
+
+static void danteWindowEnd(DanteObject* obj)
+{
+	DANTE_ERROR_IF(!obj->d.win.building, UDESK_INVALID_OPERATION);
+	
+	obj->d.win.building = false;
+	danteWindowCommit(obj);
+}
+
 static void danteWindowFlush(DanteObject* obj)
 {
-	SDL_RenderPresent(obj->d.win.render);
+	/* udeskFlush() returns once the screen is updated */
+	danteQueueWait(obj->d.win.queue, danteWindowRepaint(obj, false));
 }
 
-static void danteWindowClear(DanteObject* obj)
+static Uint32 danteWindowSubmit(DanteObject* obj, UDboolean notify)
+{
+	return danteWindowRepaint(obj, notify);
+}
+
+static void danteWindowRetire(DanteObject* obj)
 {
 	DanteWindowObject* win = &obj->d.win;
 	
+	if (win->swin) {
+		/* window disappears at once, pending events for it are discarded */
+		SDL_HideWindow(win->swin);
+		SDL_SetWindowData(win->swin, DANTE_WINDOW_OBJECT, NULL);
+	}
+	
+	danteWindowTruncateHover(obj, 0, NULL);
+	danteGridClear(&win->grid);
+	if (win->child) {
+		win->child->parent = NULL;
+	}
+	
 	danteUnrefObject(win->icon);
 	danteUnrefObject(win->child);
-	SDL_DestroyRenderer(win->render);
-	SDL_DestroyWindow(win->swin);
+	win->icon = NULL;
+	win->child = NULL;
+}
+
+static void danteWindowClear(DanteObject* obj)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	/* no-op on already retired windows */
+	danteWindowRetire(obj);
+	danteListClear(&win->lists[0]);
+	danteListClear(&win->lists[1]);
+	free(win->title);
+	if (win->swin) {
+		/* textures are destroyed along with the renderer */
+		danteReleaseTextures(obj);
+		danteQueueCall(win->queue, danteWindowTeardownJob, obj, NULL);
+	}
 }
 
 UDboolean DANTEAPIENTRY danteWindowInit(DanteObject* obj)
 {
 	static const DanteVTable win_table = {
 		danteWindowRegisterHandler,
-		NULL, /* no begin */
-		NULL, /* no end */
+		danteWindowBegin,
+		danteWindowEnd,
 		danteWindowFlush,
-		danteWindowClear
+		danteWindowSubmit,
+		danteWindowClear,
+		danteWindowRetire
 	};
 	
 	static const DanteEventDispatch dispatch_table = {
@@ -243,65 +795,349 @@ UDboolean DANTEAPIENTRY danteWindowInit(DanteObject* obj)
 		danteWindowFocusHandler,
 		danteWindowDrawHandler,
 		danteWindowDestroyHandler,
-		NULL, /* key */
-		NULL, /* button */
+		danteWindowKeyHandler,
+		danteWindowButtonHandler,
 		danteWindowMotionHandler,
-		NULL  /* touch */
+		danteWindowTouchHandler,
+		danteWindowFlushedHandler,
+		NULL, /* loaded */
+		NULL /* progress */
 	};
 	
 	DanteWindowObject* win = &obj->d.win;
-	SDL_Window* swin = NULL;
-	SDL_Renderer* render = NULL;
 	
-	swin = SDL_CreateWindow(DANTE_WINDOW_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-	                        DANTE_WINDOW_WIDTH, DANTE_WINDOW_HEIGHT, SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE);
-	if (!swin) {
-		dante_context->error = UDESK_OPERATION_FAILED;
-		goto fail;
+	/* windows start hidden, SDL resources are created once the
+	 * window is first shown, many windows never are.
+	 */
+	win->swin = NULL;
+	win->render = NULL;
+	win->tile.x = DANTE_TEXTURE_TILE;
+	win->tile.y = DANTE_TEXTURE_TILE;
+	win->surface = NULL;
+	win->queue = NULL;
+	win->title = NULL;
+	win->geometry.x = SDL_WINDOWPOS_UNDEFINED;
+	win->geometry.y = SDL_WINDOWPOS_UNDEFINED;
+	win->geometry.w = DANTE_WINDOW_WIDTH;
+	win->geometry.h = DANTE_WINDOW_HEIGHT;
+	win->decorated = true;
+	win->resizable = true;
+	win->mode = UDESK_WINDOW_HIDDEN;
+	win->pending = 0;
+	win->building = false;
+	obj->vt = &win_table;
+	obj->dispatch = &dispatch_table;
+	danteGridInit(&win->grid, DANTE_WINDOW_WIDTH, DANTE_WINDOW_HEIGHT);
+	return true;
+}
+
+DanteObject* DANTEAPIENTRY danteGetObjectFromWindowID(Uint32 id)
+{
+	SDL_Window* win = SDL_GetWindowFromID(id);
+	
+	if (!win) {
+		return NULL;
+	}
+	
+	return (DanteObject*)SDL_GetWindowData(win, DANTE_WINDOW_OBJECT);
+}
+
+DanteObject* DANTEAPIENTRY danteGetObjectWindow(DanteObject* obj)
+{
+	while (obj && obj->type != UDESK_HANDLE_WINDOW) {
+		obj = obj->parent;
 	}
 	
-	render = danteCreateWindowRenderer(swin);
+	return obj;
+}
+
+UDboolean DANTEAPIENTRY danteLayoutObject(DanteObject* obj, const SDL_Rect* area)
+{
+	DanteObject* win;
+	
+	win = danteGetObjectWindow(obj->parent);
+	if (!win) {
+		/* not attached to a window yet, nothing to index */
+		obj->area = *area;
+		return true;
+	}
+	
+	/* both the uncovered and the covered areas need redrawing */
+	danteInvalidateObject(obj);
+	obj->area = *area;
+	danteInvalidateObject(obj);
+	return danteGridUpdate(&win->d.win.grid, obj);
+}
+
+static void danteWindowSetupJob(DanteRenderJob* job)
+{
+	DanteWindowObject* win = &job->obj->d.win;
+	const SDL_Rect* size = (const SDL_Rect*)job->arg;
+	
+	win->swin = SDL_CreateWindow((win->title)? win->title : DANTE_WINDOW_TITLE,
+	                             win->geometry.x, win->geometry.y, size->w, size->h,
+	                             SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE);
+	if (!win->swin) {
+		return;
+	}
+	
+	win->render = danteCreateWindowRenderer(win->swin, size->w, size->h, &win->surface);
+	if (!win->render) {
+		SDL_DestroyWindow(win->swin);
+		win->swin = NULL;
+		return;
+	}
+	
+	danteRendererTile(win->render, &win->tile);
+}
+
+static void danteWindowResizeJob(DanteRenderJob* job)
+{
+	DanteWindowObject* win = &job->obj->d.win;
+	const SDL_Rect* size = (const SDL_Rect*)job->arg;
+	SDL_Surface* surface;
+	SDL_Renderer* render;
+	
+	render = danteCreateWindowRenderer(win->swin, size->w, size->h, &surface);
 	if (!render) {
-		dante_context->error = UDESK_OPERATION_FAILED;
-		goto fail;
+		/* keep drawing on the old surface, clipped */
+		return;
 	}
 	
-	/* install an userspace identifier to retrieve an object from a
-	 * SDL window handle.
-	 */
-	SDL_SetWindowData(swin, DANTE_WINDOW_OBJECT, obj);
-	obj->vt = &win_table;
-	obj->dispatch = &dispatch_table;
-	win->swin = swin;
+	if (win->canvas) {
+		SDL_DestroyTexture(win->canvas);
+		win->canvas = NULL;
+	}
+	
+	SDL_DestroyRenderer(win->render);
+	SDL_FreeSurface(win->surface);
 	win->render = render;
-	win->resizable = true;
-	return true;
+	win->surface = surface;
+	danteRendererTile(render, &win->tile);
+}
 
-fail:
-	if (swin) {
-		SDL_DestroyWindow(swin);
+static void danteWindowTeardownJob(DanteRenderJob* job)
+{
+	DanteWindowObject* win = &job->obj->d.win;
+	
+	if (win->canvas) {
+		SDL_DestroyTexture(win->canvas);
+		win->canvas = NULL;
 	}
-	if (render) {
-		SDL_DestroyRenderer(render);
+	if (win->render) {
+		SDL_DestroyRenderer(win->render);
+		win->render = NULL;
+	}
+	if (win->surface) {
+		SDL_FreeSurface(win->surface);
+		win->surface = NULL;
+	}
+	
+	SDL_DestroyWindow(win->swin);
+	win->swin = NULL;
+}
+
+static void danteWindowPoolJob(DanteRenderJob* job)
+{
+	DantePooledWindow* pooled = (DantePooledWindow*)job->arg;
+	
+	pooled->render = NULL;
+	pooled->swin = danteCreateSDLWindow();
+	if (!pooled->swin) {
+		return;
+	}
+	
+	pooled->render = danteCreateWindowRenderer(pooled->swin, DANTE_WINDOW_WIDTH, DANTE_WINDOW_HEIGHT, &pooled->surface);
+	if (!pooled->render) {
+		SDL_DestroyWindow(pooled->swin);
+		pooled->swin = NULL;
+		return;
+	}
+	
+	danteRendererTile(pooled->render, &pooled->tile);
+}
+
+static void danteWindowUnpoolJob(DanteRenderJob* job)
+{
+	DantePooledWindow* pooled = (DantePooledWindow*)job->arg;
+	
+	SDL_DestroyRenderer(pooled->render);
+	if (pooled->surface) {
+		SDL_FreeSurface(pooled->surface);
+	}
+	
+	SDL_DestroyWindow(pooled->swin);
+}
+
+UDboolean DANTEAPIENTRY danteFillWindowPool(UDint budget)
+{
+	DantePooledWindow* pooled;
+	
+	while (dante_context->num_pooled < dante_context->pool_size) {
+		pooled = &dante_context->pool[dante_context->num_pooled];
+		pooled->surface = NULL;
+		pooled->queue = &dante_context->render[dante_context->next_queue];
+		dante_context->next_queue = (dante_context->next_queue + 1) % DANTE_RENDER_QUEUES;
+		danteQueueCall(pooled->queue, danteWindowPoolJob, NULL, pooled);
+		if (!pooled->render) {
+			break;
+		}
+		
+		dante_context->num_pooled++;
+		if (budget > 0 && --budget == 0) {
+			return dante_context->num_pooled < dante_context->pool_size;
+		}
 	}
 	
+	/* on failure, shrink the pool rather than retrying in a loop */
+	dante_context->pool_size = dante_context->num_pooled;
 	return false;
 }
 
-DanteObject* DANTEAPIENTRY danteGetObjectFromWindowID(Uint32 id)
+void DANTEAPIENTRY danteDrainWindowPool(void)
 {
-	SDL_Window* win = SDL_GetWindowFromID(id);
+	DantePooledWindow* pooled;
 	
-	if (!win) {
-		return NULL;
+	while (dante_context->num_pooled > 0) {
+		pooled = &dante_context->pool[--dante_context->num_pooled];
+		danteQueueCall(pooled->queue, danteWindowUnpoolJob, NULL, pooled);
 	}
+}
+
+void DANTEAPIENTRY danteWindowUpdateState(DanteObject* obj, const SDL_WindowEvent* wev)
+{
+	DanteWindowObject* win = &obj->d.win;
 	
-	return (DanteObject*)SDL_GetWindowData(win, DANTE_WINDOW_OBJECT);
+	/* values set while building take precedence, they're applied later */
+	switch (wev->event) {
+	case SDL_WINDOWEVENT_MOVED:
+		if (!(win->pending & DANTE_WINDOW_SET_POSITION)) {
+			win->geometry.x = wev->data1;
+			win->geometry.y = wev->data2;
+		}
+		
+		return;
+	
+	case SDL_WINDOWEVENT_SHOWN:
+	case SDL_WINDOWEVENT_RESTORED:
+		if (!(win->pending & DANTE_WINDOW_SET_MODE)) {
+			win->mode = UDESK_WINDOW_SHOW;
+		}
+		
+		return;
+	
+	case SDL_WINDOWEVENT_HIDDEN:
+		if (!(win->pending & DANTE_WINDOW_SET_MODE)) {
+			win->mode = UDESK_WINDOW_HIDDEN;
+		}
+		
+		return;
+	
+	case SDL_WINDOWEVENT_MINIMIZED:
+		if (!(win->pending & DANTE_WINDOW_SET_MODE)) {
+			win->mode = UDESK_WINDOW_ICONIFIED;
+		}
+		
+		return;
+	
+	case SDL_WINDOWEVENT_MAXIMIZED:
+		if (!(win->pending & DANTE_WINDOW_SET_MODE)) {
+			win->mode = UDESK_WINDOW_MAXIMIZED;
+		}
+		
+		return;
+	
+	default:
+		/* sizes are tracked by danteWindowResize() */
+		return;
+	}
+}
+
+void DANTEAPIENTRY danteWindowResize(DanteObject* obj, int w, int h)
+{
+	DanteWindowObject* win = &obj->d.win;
+	
+	if (!(win->pending & DANTE_WINDOW_SET_SIZE)) {
+		/* a size set while building takes precedence */
+		win->geometry.w = w;
+		win->geometry.h = h;
+	}
+	if (win->swin && dante_context->headless) {
+		SDL_Rect size;
+		
+		size.x = 0;
+		size.y = 0;
+		size.w = w;
+		size.h = h;
+		danteReleaseTextures(obj);
+		danteQueueCall(win->queue, danteWindowResizeJob, obj, &size);
+		/* recorded commands may reference textures of the old
+		 * renderer, drop them so that every object records again
+		 */
+		win->lists[0].num_cmds = 0;
+		win->lists[0].num_ranges = 0;
+		win->lists[1].num_cmds = 0;
+		win->lists[1].num_ranges = 0;
+	}
+	
+	danteGridResize(&win->grid, w, h);
+	danteInvalidateObject(obj);
+	if (win->child) {
+		SDL_Rect area;
+		
+		area.x = 0;
+		area.y = 0;
+		area.w = w;
+		area.h = h;
+		danteLayoutObject(win->child, &area);
+	}
 }
 
 void UDESKAPIENTRY udeskWindowChild(UDhandle window, UDhandle child)
 {
-	/* TODO stub */
+	DanteObject* obj;
+	DanteObject* cobj = NULL;
+	DanteWindowObject* win;
+	
+	obj = danteRetrieveObject(window, UDESK_HANDLE_WINDOW);
+	if (!obj) {
+		return;
+	}
+	
+	win = &obj->d.win;
+	if (child != UDESK_HANDLE_NONE) {
+		cobj = danteGetObject(child);
+		DANTE_ERROR_IF(!cobj, UDESK_INVALID_VALUE);
+		/* only interface objects can be laid out inside a window */
+		DANTE_ERROR_IF(cobj->type == UDESK_HANDLE_WINDOW || cobj->type == UDESK_HANDLE_EVENT ||
+		               cobj->type == UDESK_HANDLE_PIXMAP || cobj->type == UDESK_HANDLE_TIMER, UDESK_INVALID_VALUE);
+		DANTE_ERROR_IF(cobj->parent && cobj->parent != obj, UDESK_INVALID_OPERATION);
+	}
+	
+	if (cobj == win->child) {
+		return;
+	}
+	
+	if (win->child) {
+		danteInvalidateObject(win->child);
+		danteWindowTruncateHover(obj, 0, NULL);
+		danteGridRemoveTree(&win->grid, win->child);
+		win->child->parent = NULL;
+		danteUnrefObject(win->child);
+		win->child = NULL;
+	}
+	
+	if (cobj) {
+		SDL_Rect area;
+		
+		area.x = 0;
+		area.y = 0;
+		area.w = win->grid.width;
+		area.h = win->grid.height;
+		cobj->parent = obj;
+		win->child = danteRefObject(cobj);
+		DANTE_ERROR_IF(!danteLayoutObject(cobj, &area), UDESK_OUT_OF_MEMORY);
+	}
 }
 
 void UDESKAPIENTRY udeskWindowIcon(UDhandle window, UDhandle icon)
@@ -318,44 +1154,48 @@ void UDESKAPIENTRY udeskSetWindowiv(UDhandle window, UDenum param, const UDint*
 		
 		DANTE_ERROR_IF(!to, UDESK_INVALID_VALUE);
 		
+		/* properties are stored, then applied at once, immediately
+		 * or by udeskEnd() while building
+		 */
 		switch (param) {
 		case UDESK_WINDOW_POSITION:
 			DANTE_ERROR_IF(to[0] < 0 || to[1] < 0, UDESK_INVALID_VALUE);
-			SDL_SetWindowPosition(win->swin, to[0], to[1]);
+			win->geometry.x = to[0];
+			win->geometry.y = to[1];
+			win->pending |= DANTE_WINDOW_SET_POSITION;
 			break;
 		
 		case UDESK_WINDOW_SIZE:
 			DANTE_ERROR_IF(to[0] < 1 || to[1] < 1, UDESK_INVALID_VALUE);
-			SDL_SetWindowSize(win->swin, to[0], to[1]);
+			win->geometry.w = to[0];
+			win->geometry.h = to[1];
+			win->pending |= DANTE_WINDOW_SET_SIZE;
 			break;
 		
 		case UDESK_WINDOW_RESIZE:
-			if (win->resizable != DANTE_BOOL(to[0])) {
-				int w = 0;
-				int h = 0;
-				
-				if (DANTE_BOOL(to[0])) {
-					SDL_GetWindowSize(win->swin, &w, &h);
-				}
-				
-				SDL_SetWindowMinimumSize(win->swin, w, h);
-				SDL_SetWindowMaximumSize(win->swin, w, h);
-				win->resizable = DANTE_BOOL(to[0]);
-			}
-			
+			win->resizable = DANTE_BOOL(to[0]);
+			win->pending |= DANTE_WINDOW_SET_RESIZE;
 			break;
 		
 		case UDESK_WINDOW_MODE:
-			danteSetWindowMode(win->swin, to[0]);
+			DANTE_ERROR_IF(to[0] != UDESK_WINDOW_HIDDEN && to[0] != UDESK_WINDOW_ICONIFIED &&
+			               to[0] != UDESK_WINDOW_SHOW && to[0] != UDESK_WINDOW_MAXIMIZED, UDESK_INVALID_VALUE);
+			win->mode = to[0];
+			win->pending |= DANTE_WINDOW_SET_MODE;
 			break;
 		
 		case UDESK_WINDOW_DECORATE:
-			SDL_SetWindowBordered(win->swin, DANTE_BOOL(to[0]));
+			win->decorated = DANTE_BOOL(to[0]);
+			win->pending |= DANTE_WINDOW_SET_DECORATE;
 			break;
 		
 		default:
 			dante_context->error = UDESK_INVALID_ENUM;
-			break;
+			return;
+		}
+		
+		if (!win->building) {
+			danteWindowCommit(obj);
 		}
 	}
 }
@@ -385,24 +1225,27 @@ void UDESKAPIENTRY udeskGetWindowiv(UDhandle window, UDenum param, UDint* dst)
 	
 	if (obj) {
 		DanteWindowObject* win;
-		Uint32 flags;
-		int x;
-		int y;
 		
 		DANTE_ERROR_IF(!dst, UDESK_INVALID_VALUE);
+		DANTE_ERROR_IF(obj->d.win.building, UDESK_INVALID_OPERATION);
 		
+		/* window state is cached, kept current by window events */
 		win = &obj->d.win;
 		switch (param) {
 		case UDESK_WINDOW_POSITION:
-			SDL_GetWindowPosition(win->swin, &x, &y);
-			dst[0] = x;
-			dst[1] = y;
+			if (win->geometry.x != SDL_WINDOWPOS_UNDEFINED) {
+				dst[0] = win->geometry.x;
+				dst[1] = win->geometry.y;
+			} else {
+				dst[0] = 0;
+				dst[1] = 0;
+			}
+			
 			break;
 		
 		case UDESK_WINDOW_SIZE:
-			SDL_GetWindowSize(win->swin, &x, &y);
-			dst[0] = x;
-			dst[1] = y;
+			dst[0] = win->geometry.w;
+			dst[1] = win->geometry.h;
 			break;
 		
 		case UDESK_WINDOW_RESIZE:
@@ -410,22 +1253,23 @@ void UDESKAPIENTRY udeskGetWindowiv(UDhandle window, UDenum param, UDint* dst)
 			break;
 		
 		case UDESK_WINDOW_MODE:
-			flags = SDL_GetWindowFlags(win->swin);
-			if (flags & SDL_WINDOW_HIDDEN) {
-				dst[0] = UDESK_WINDOW_HIDDEN;
-			} else if (flags & SDL_WINDOW_MINIMIZED) {
-				dst[0] = UDESK_WINDOW_ICONIFIED;
-			} else if (flags & SDL_WINDOW_MAXIMIZED) {
-				dst[0] = UDESK_WINDOW_MAXIMIZED;
-			} else {
-				dst[0] = UDESK_WINDOW_SHOW;
-			}
-			
+			dst[0] = win->mode;
 			break;
 		
 		case UDESK_WINDOW_DECORATE:
-			flags = SDL_GetWindowFlags(win->swin);
-			dst[0] = DANTE_BOOL(flags & SDL_WINDOW_BORDERLESS);
+			dst[0] = win->decorated;
+			break;
+		
+		case UDESK_WINDOW_FRAME_PIXELS_EXT:
+			dst[0] = danteWindowStats(obj)->pixels;
+			break;
+		
+		case UDESK_WINDOW_FRAME_CALLS_EXT:
+			dst[0] = danteWindowStats(obj)->calls;
+			break;
+		
+		case UDESK_WINDOW_FRAME_RECTS_EXT:
+			dst[0] = danteWindowStats(obj)->rects;
 			break;
 		
 		default:
@@ -440,16 +1284,31 @@ void UDESKAPIENTRY udeskSetWindowString(UDhandle window, UDenum param, const cha
 	DanteObject* obj = danteRetrieveObject(window, UDESK_HANDLE_WINDOW);
 	
 	if (obj) {
+		DanteWindowObject* win = &obj->d.win;
+		char* title;
+		size_t len;
+		
 		DANTE_ERROR_IF(!to, UDESK_INVALID_VALUE);
 	
 		switch (param) {
 		case UDESK_WINDOW_TITLE:
-			SDL_SetWindowTitle(obj->d.win.swin, to);
+			len = strlen(to) + 1;
+			title = (char*)malloc(len);
+			DANTE_ERROR_IF(!title, UDESK_OUT_OF_MEMORY);
+			
+			memcpy(title, to, len);
+			free(win->title);
+			win->title = title;
+			win->pending |= DANTE_WINDOW_SET_TITLE;
 			break;
 		
 		default:
 			dante_context->error = UDESK_INVALID_ENUM;
-			break;
+			return;
+		}
+		
+		if (!win->building) {
+			danteWindowCommit(obj);
 		}
 	}
 }
@@ -462,8 +1321,14 @@ const char* UDESKAPIENTRY udeskGetWindowString(UDhandle window, UDenum param)
 		return NULL;
 	}
 	
+	DANTE_ERROR_AND_RETVAL_IF(obj->d.win.building, UDESK_INVALID_OPERATION, NULL);
+	
 	switch (param) {
 	case UDESK_WINDOW_TITLE:
+		if (!obj->d.win.swin) {
+			return (obj->d.win.title)? obj->d.win.title : DANTE_WINDOW_TITLE;
+		}
+		
 		return SDL_GetWindowTitle(obj->d.win.swin);
 	
 	default:
@@ -483,6 +1348,8 @@ UDhandle UDESKAPIENTRY udeskGetWindowHandle(UDhandle window, UDenum param)
 	}
 	
 	win = &obj->d.win;
+	DANTE_ERROR_AND_RETVAL_IF(win->building, UDESK_INVALID_OPERATION, UDESK_HANDLE_NONE);
+	
 	switch (param) {
 	case UDESK_WINDOW_ICON:
 		return (win->icon)? win->icon->handle : UDESK_HANDLE_NONE;
@@ -496,6 +1363,27 @@ UDhandle UDESKAPIENTRY udeskGetWindowHandle(UDhandle window, UDenum param)
 	}
 }
 
+void UDESKAPIENTRY udeskReadWindowPixelsEXT(UDhandle window, UDint x, UDint y, UDint width, UDint height, UDenum format, void* dst)
+{
+	DanteObject* obj = danteRetrieveObject(window, UDESK_HANDLE_WINDOW);
+	
+	if (obj) {
+		SDL_Rect rect;
+		
+		DANTE_ERROR_IF(format != UDESK_RGBA, UDESK_INVALID_ENUM);
+		DANTE_ERROR_IF(!dst || x < 0 || y < 0 || width < 1 || height < 1, UDESK_INVALID_VALUE);
+		DANTE_ERROR_IF(x + width > (UDint)obj->d.win.grid.width || y + height > (UDint)obj->d.win.grid.height, UDESK_INVALID_VALUE);
+		
+		DANTE_ERROR_IF(!obj->d.win.swin || obj->d.win.building, UDESK_INVALID_OPERATION);
+		
+		rect.x = x;
+		rect.y = y;
+		rect.w = width;
+		rect.h = height;
+		DANTE_ERROR_IF(!danteRenderReadPixels(obj, &rect, dst), UDESK_INVALID_OPERATION);
+	}
+}
+
 UDboolean UDESKAPIENTRY udeskIsWindow(UDhandle handle)
 {
 	return danteCheckObjectType(handle, UDESK_HANDLE_WINDOW);
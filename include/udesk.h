@@ -525,12 +525,19 @@ UDESKAPI void UDESKAPIENTRY udeskDeleteObjects(UDint num, const UDhandle* buff);
  *
  * Received events:
  *
- * UDESK_EVENT_DESTROY: Window was closed by the user, default handling
- *                      is ignoring the event, any application should
- *                      handle this event since the user expects a
- *                      response from the application.
- * UDESK_EVENT_ENTER:   The cursor entered into the window area.
- * UDESK_EVENT_LEAVE:   The cursor left the window area.
+ * UDESK_EVENT_DESTROY:  Window was closed by the user, default handling
+ *                       is ignoring the event, any application should
+ *                       handle this event since the user expects a
+ *                       response from the application.
+ * UDESK_EVENT_ENTER:    The cursor entered into the window area.
+ * UDESK_EVENT_LEAVE:    The cursor left the window area.
+ * UDESK_EVENT_KEYBOARD: A key was pressed or released while the window
+ *                       had keyboard focus.
+ * UDESK_EVENT_PRESS:    A mouse button was pressed inside the window.
+ * UDESK_EVENT_RELEASE:  A mouse button was released inside the window.
+ * UDESK_EVENT_MOTION:   The cursor moved inside the window area.
+ * UDESK_EVENT_TOUCH:    A touch device reported a finger press, release
+ *                       or motion inside the window.
  */
 
 /* right after context-wide queries: [0x0300, 0x37f] */
@@ -56,11 +56,27 @@ extern "C" {
 
 /* ==========
  * Extended image file formats support: UDESK_PIXMAP_EXTENDED_FILE_FORMATS_EXT
+ *
+ * udeskPixmapFile() recognizes image file formats from the file
+ * contents, rather than from the file name. The recognized formats
+ * are implementation defined, their names ("PNG", "JPEG", ...) are
+ * reported by udeskQueryFileFormatEXT(), for indices in
+ * [0, UDESK_NUM_FILE_FORMATS_EXT), as queried with udeskQueryiv().
  */
 #ifndef UDESK_PIXMAP_EXTENDED_FILE_FORMATS_EXT
 #define UDESK_PIXMAP_EXTENDED_FILE_FORMATS_EXT
-/* TODO stub */
 
+enum {
+  /* Query value, number of recognized image file formats. */
+  UDESK_NUM_FILE_FORMATS_EXT = 0x8090
+#define UDESK_NUM_FILE_FORMATS_EXT UDESK_NUM_FILE_FORMATS_EXT
+
+};
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI const char* UDESKAPIENTRY udeskQueryFileFormatEXT(UDint index);
+#endif
+typedef const char* (UDESKAPIENTRYP PFNUDESKQUERYFILEFORMATEXTPROC)(UDint index);
 #endif /* UDESK_PIXMAP_EXTENDED_FILE_FORMATS_EXT */
 
 /* ==========
@@ -91,6 +107,390 @@ typedef UDboolean (UDESKAPIENTRYP PFNUDESKISANIMATIONEXTPROC)(UDhandle handle);
 typedef void (UDESKAPIENTRYP PFNUDESKLAYERANIMATIONEXTPROC)(UDhandle layer, UDhandle animation);
 #endif /* UDESK_ANIMATION_OBJECT_EXT */
 
+/* ==========
+ * Input state snapshots: UDESK_INPUT_STATE_EXT
+ *
+ * Exposes the keyboard and mouse state tracked by the implementation
+ * while dispatching UDESK_EVENT_KEYBOARD, UDESK_EVENT_PRESS,
+ * UDESK_EVENT_RELEASE, UDESK_EVENT_MOTION and UDESK_EVENT_TOUCH events,
+ * so that handlers can test keys, buttons and modifiers without
+ * tracking them on their own.
+ * Key codes are the udeskplatform.h values, keys that have no udesk
+ * keycode are reported with implementation defined values greater
+ * than UDESK_KEYCODE_F16.
+ */
+#ifndef UDESK_INPUT_STATE_EXT
+#define UDESK_INPUT_STATE_EXT
+
+enum {
+  /* Event field, int value, key or button code of a UDESK_EVENT_KEYBOARD,
+   * UDESK_EVENT_PRESS or UDESK_EVENT_RELEASE event.
+   */
+  UDESK_EVENT_KEYCODE_EXT = 0x8010,
+#define UDESK_EVENT_KEYCODE_EXT   UDESK_EVENT_KEYCODE_EXT
+
+  /* Event field, int value, UDESK_EVENT_PRESS if the key or button
+   * of the event is down, UDESK_EVENT_RELEASE otherwise.
+   */
+  UDESK_EVENT_KEY_STATE_EXT = 0x8011,
+#define UDESK_EVENT_KEY_STATE_EXT UDESK_EVENT_KEY_STATE_EXT
+
+  /* Event field, int value, bitwise or of the UDESK_MODIFIER_*_EXT
+   * values active when the event was generated.
+   */
+  UDESK_EVENT_MODIFIERS_EXT = 0x8012,
+#define UDESK_EVENT_MODIFIERS_EXT UDESK_EVENT_MODIFIERS_EXT
+
+  /* Event field, float value in [0, 1], pressure of a UDESK_EVENT_TOUCH event. */
+  UDESK_EVENT_PRESSURE_EXT = 0x8013
+#define UDESK_EVENT_PRESSURE_EXT  UDESK_EVENT_PRESSURE_EXT
+
+};
+
+/* Modifier bits, as reported by UDESK_EVENT_MODIFIERS_EXT and
+ * udeskGetModifiersEXT().
+ */
+enum {
+
+  UDESK_MODIFIER_SHIFT_EXT = 0x0001,
+#define UDESK_MODIFIER_SHIFT_EXT UDESK_MODIFIER_SHIFT_EXT
+
+  UDESK_MODIFIER_CTRL_EXT = 0x0002,
+#define UDESK_MODIFIER_CTRL_EXT  UDESK_MODIFIER_CTRL_EXT
+
+  UDESK_MODIFIER_ALT_EXT = 0x0004,
+#define UDESK_MODIFIER_ALT_EXT   UDESK_MODIFIER_ALT_EXT
+
+  UDESK_MODIFIER_SUPER_EXT = 0x0008,
+#define UDESK_MODIFIER_SUPER_EXT UDESK_MODIFIER_SUPER_EXT
+
+  UDESK_MODIFIER_CAPS_EXT = 0x0010,
+#define UDESK_MODIFIER_CAPS_EXT  UDESK_MODIFIER_CAPS_EXT
+
+  UDESK_MODIFIER_NUM_EXT = 0x0020
+#define UDESK_MODIFIER_NUM_EXT   UDESK_MODIFIER_NUM_EXT
+
+};
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI UDboolean UDESKAPIENTRY udeskGetKeyStateEXT(UDint keycode);
+UDESKAPI UDint UDESKAPIENTRY udeskGetModifiersEXT(void);
+#endif
+typedef UDboolean (UDESKAPIENTRYP PFNUDESKGETKEYSTATEEXTPROC)(UDint keycode);
+typedef UDint (UDESKAPIENTRYP PFNUDESKGETMODIFIERSEXTPROC)(void);
+#endif /* UDESK_INPUT_STATE_EXT */
+
+/* ==========
+ * Frame statistics: UDESK_FRAME_STATS_EXT
+ *
+ * Reports the rendering work performed by the last frame of a window,
+ * implementations only redrawing the damaged part of a window report
+ * the redrawn area only.
+ * Queries wait for the last frame submitted for the window to complete.
+ */
+#ifndef UDESK_FRAME_STATS_EXT
+#define UDESK_FRAME_STATS_EXT
+
+enum {
+  /* Window field, int value, read only, pixels covered by the draw
+   * calls issued during the last frame.
+   */
+  UDESK_WINDOW_FRAME_PIXELS_EXT = 0x8020,
+#define UDESK_WINDOW_FRAME_PIXELS_EXT UDESK_WINDOW_FRAME_PIXELS_EXT
+
+  /* Window field, int value, read only, draw calls issued during the last frame. */
+  UDESK_WINDOW_FRAME_CALLS_EXT = 0x8021,
+#define UDESK_WINDOW_FRAME_CALLS_EXT  UDESK_WINDOW_FRAME_CALLS_EXT
+
+  /* Window field, int value, read only, rectangles redrawn during the last frame. */
+  UDESK_WINDOW_FRAME_RECTS_EXT = 0x8022
+#define UDESK_WINDOW_FRAME_RECTS_EXT  UDESK_WINDOW_FRAME_RECTS_EXT
+
+};
+
+#endif /* UDESK_FRAME_STATS_EXT */
+
+/* ==========
+ * Window frame readback: UDESK_WINDOW_READ_PIXELS_EXT
+ *
+ * Reads back the last frame presented by a window, rows are stored
+ * top to bottom, tightly packed, the only supported format is
+ * UDESK_RGBA. UDESK_INVALID_OPERATION is raised if the window
+ * contents can't be read back.
+ */
+#ifndef UDESK_WINDOW_READ_PIXELS_EXT
+#define UDESK_WINDOW_READ_PIXELS_EXT
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI void UDESKAPIENTRY udeskReadWindowPixelsEXT(UDhandle window, UDint x, UDint y, UDint width, UDint height, UDenum format, void* dst);
+#endif
+typedef void (UDESKAPIENTRYP PFNUDESKREADWINDOWPIXELSEXTPROC)(UDhandle window, UDint x, UDint y, UDint width, UDint height, UDenum format, void* dst);
+#endif /* UDESK_WINDOW_READ_PIXELS_EXT */
+
+/* ==========
+ * Asynchronous flush: UDESK_ASYNC_FLUSH_EXT
+ *
+ * udeskFlushAsyncEXT() queues the same work as udeskFlush() and
+ * returns without waiting for the screen to be updated, the returned
+ * fence can be polled with udeskPollFenceEXT() or waited on with
+ * udeskWaitFenceEXT(). A fence of 0 is always complete, it is
+ * returned when the flush completed before returning.
+ * Windows also deliver an UDESK_EVENT_FLUSH_EXT event once an
+ * asynchronous flush has been presented, reporting its fence in the
+ * UDESK_EVENT_FENCE_EXT field.
+ * Implementations may only present on a separate thread when their
+ * windowing system allows it, SDL based ones do so on X11 and KMSDRM
+ * displays and without a display, other flushes complete before
+ * udeskFlushAsyncEXT() returns.
+ */
+#ifndef UDESK_ASYNC_FLUSH_EXT
+#define UDESK_ASYNC_FLUSH_EXT
+
+enum {
+  /* Event type, an asynchronous window flush has been presented. */
+  UDESK_EVENT_FLUSH_EXT = 0x8030,
+#define UDESK_EVENT_FLUSH_EXT UDESK_EVENT_FLUSH_EXT
+
+  /* Event field, int value, fence of a UDESK_EVENT_FLUSH_EXT event. */
+  UDESK_EVENT_FENCE_EXT = 0x8031
+#define UDESK_EVENT_FENCE_EXT UDESK_EVENT_FENCE_EXT
+
+};
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI UDint UDESKAPIENTRY udeskFlushAsyncEXT(UDhandle handle);
+UDESKAPI UDboolean UDESKAPIENTRY udeskPollFenceEXT(UDint fence);
+UDESKAPI void UDESKAPIENTRY udeskWaitFenceEXT(UDint fence);
+#endif
+typedef UDint (UDESKAPIENTRYP PFNUDESKFLUSHASYNCEXTPROC)(UDhandle handle);
+typedef UDboolean (UDESKAPIENTRYP PFNUDESKPOLLFENCEEXTPROC)(UDint fence);
+typedef void (UDESKAPIENTRYP PFNUDESKWAITFENCEEXTPROC)(UDint fence);
+#endif /* UDESK_ASYNC_FLUSH_EXT */
+
+/* ==========
+ * Batched window properties: UDESK_WINDOW_BUILD_EXT
+ *
+ * Windows support the UDESK_WINDOW_PROPERTIES_EXT udeskBegin() mode,
+ * properties set while building are stored and applied at once by
+ * udeskEnd(), resulting in a single window manager update and at
+ * most one relayout and redraw.
+ * Querying a window property while building raises
+ * UDESK_INVALID_OPERATION.
+ */
+#ifndef UDESK_WINDOW_BUILD_EXT
+#define UDESK_WINDOW_BUILD_EXT
+
+enum {
+  /* Window udeskBegin() mode, batches property changes. */
+  UDESK_WINDOW_PROPERTIES_EXT = 0x8040
+#define UDESK_WINDOW_PROPERTIES_EXT UDESK_WINDOW_PROPERTIES_EXT
+
+};
+
+#endif /* UDESK_WINDOW_BUILD_EXT */
+
+/* ==========
+ * Texture cache: UDESK_TEXTURE_CACHE_EXT
+ *
+ * Pixmaps are uploaded to the window renderers on demand, uploaded
+ * textures are cached up to a budget and the least recently used
+ * ones are evicted (and uploaded again when needed) beyond it.
+ * The budget and the cache counters are context-wide values,
+ * accessed with udeskGetiv() and udeskSetiv().
+ */
+#ifndef UDESK_TEXTURE_CACHE_EXT
+#define UDESK_TEXTURE_CACHE_EXT
+
+enum {
+  /* Context field, int value, read and write, texture cache
+   * budget in KiB (default is implementation defined).
+   */
+  UDESK_TEXTURE_BUDGET_EXT = 0x8050,
+#define UDESK_TEXTURE_BUDGET_EXT   UDESK_TEXTURE_BUDGET_EXT
+
+  /* Context field, int value, read only, KiB of cached textures. */
+  UDESK_TEXTURE_RESIDENT_EXT = 0x8051,
+#define UDESK_TEXTURE_RESIDENT_EXT UDESK_TEXTURE_RESIDENT_EXT
+
+  /* Context field, int value, texture lookups served by the cache,
+   * it may only be set to 0, resetting it.
+   */
+  UDESK_TEXTURE_HITS_EXT = 0x8052,
+#define UDESK_TEXTURE_HITS_EXT     UDESK_TEXTURE_HITS_EXT
+
+  /* Context field, int value, texture lookups that uploaded a
+   * texture, it may only be set to 0, resetting it.
+   */
+  UDESK_TEXTURE_MISSES_EXT = 0x8053
+#define UDESK_TEXTURE_MISSES_EXT   UDESK_TEXTURE_MISSES_EXT
+
+};
+
+#endif /* UDESK_TEXTURE_CACHE_EXT */
+
+/* ==========
+ * Additional pixel formats: UDESK_PIXEL_FORMATS_EXT
+ *
+ * Pixel formats accepted by udeskPixmapData() besides UDESK_RGBA,
+ * rows are tightly packed as with UDESK_RGBA.
+ */
+#ifndef UDESK_PIXEL_FORMATS_EXT
+#define UDESK_PIXEL_FORMATS_EXT
+
+enum {
+  /* 8 bit per channel red, green and blue, 3 bytes per pixel. */
+  UDESK_RGB_EXT = 0x8060
+#define UDESK_RGB_EXT UDESK_RGB_EXT
+
+};
+
+#endif /* UDESK_PIXEL_FORMATS_EXT */
+
+/* ==========
+ * Scaled pixels cache: UDESK_SCALED_CACHE_EXT
+ *
+ * Layers scaling the same pixmap to the same size with the same
+ * filter share their scaled pixels, which are kept after the last
+ * layer stops using them, up to a budget, least recently used first.
+ * Both values are context-wide, accessed with udeskGetiv() and
+ * udeskSetiv().
+ */
+#ifndef UDESK_SCALED_CACHE_EXT
+#define UDESK_SCALED_CACHE_EXT
+
+enum {
+  /* Context field, int value, read and write, budget for scaled
+   * pixels no layer uses, in KiB (default is implementation defined).
+   */
+  UDESK_SCALED_BUDGET_EXT = 0x8070,
+#define UDESK_SCALED_BUDGET_EXT   UDESK_SCALED_BUDGET_EXT
+
+  /* Context field, int value, read only, KiB of scaled pixels,
+   * used or not.
+   */
+  UDESK_SCALED_RESIDENT_EXT = 0x8071
+#define UDESK_SCALED_RESIDENT_EXT UDESK_SCALED_RESIDENT_EXT
+
+};
+
+#endif /* UDESK_SCALED_CACHE_EXT */
+
+/* ==========
+ * Asynchronous pixmap loading: UDESK_ASYNC_PIXMAP_EXT
+ *
+ * udeskPixmapFileAsyncEXT() validates its arguments like
+ * udeskPixmapFile() and returns immediately, the image file is
+ * decoded by a worker thread meanwhile. The pixmap has no pixels
+ * until the load completes, layers using it draw a placeholder.
+ * Once completed, the pixmap delivers an UDESK_EVENT_LOAD_EXT event,
+ * reporting the load outcome in the UDESK_EVENT_ERROR_EXT field.
+ * Loading another image into the pixmap, or deleting it, cancels a
+ * pending load, which then delivers no event.
+ */
+#ifndef UDESK_ASYNC_PIXMAP_EXT
+#define UDESK_ASYNC_PIXMAP_EXT
+
+enum {
+  /* Event type, an asynchronous pixmap load completed. */
+  UDESK_EVENT_LOAD_EXT = 0x8080,
+#define UDESK_EVENT_LOAD_EXT     UDESK_EVENT_LOAD_EXT
+
+  /* Event field, int value, UDESK_NO_ERROR if the pixmap of a
+   * UDESK_EVENT_LOAD_EXT event was loaded, the error udeskPixmapFile()
+   * would have raised otherwise.
+   */
+  UDESK_EVENT_ERROR_EXT = 0x8081,
+#define UDESK_EVENT_ERROR_EXT    UDESK_EVENT_ERROR_EXT
+
+  /* Pixmap field, boolean value, read only, UDESK_TRUE while an
+   * asynchronous load is pending.
+   */
+  UDESK_PIXMAP_LOADING_EXT = 0x8082,
+#define UDESK_PIXMAP_LOADING_EXT UDESK_PIXMAP_LOADING_EXT
+
+  /* Context field, int value, read only, asynchronous loads queued,
+   * being decoded or waiting for completion.
+   */
+  UDESK_DECODE_PENDING_EXT = 0x8083,
+#define UDESK_DECODE_PENDING_EXT UDESK_DECODE_PENDING_EXT
+
+  /* Context field, int value, milliseconds spent decoding completed
+   * asynchronous loads, it may only be set to 0, resetting it along
+   * with UDESK_DECODE_COUNT_EXT.
+   */
+  UDESK_DECODE_TIME_EXT = 0x8084,
+#define UDESK_DECODE_TIME_EXT    UDESK_DECODE_TIME_EXT
+
+  /* Context field, int value, completed asynchronous loads, it may
+   * only be set to 0, resetting it along with UDESK_DECODE_TIME_EXT.
+   */
+  UDESK_DECODE_COUNT_EXT = 0x8085
+#define UDESK_DECODE_COUNT_EXT   UDESK_DECODE_COUNT_EXT
+
+};
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI void UDESKAPIENTRY udeskPixmapFileAsyncEXT(UDhandle pixmap, UDenum target, const char* name, UDenum usage);
+#endif
+typedef void (UDESKAPIENTRYP PFNUDESKPIXMAPFILEASYNCEXTPROC)(UDhandle pixmap, UDenum target, const char* name, UDenum usage);
+#endif /* UDESK_ASYNC_PIXMAP_EXT */
+
+/* ==========
+ * Progressive pixmap loading: UDESK_STREAM_PIXMAP_EXT
+ *
+ * udeskPixmapFileStreamEXT() loads an image file asynchronously, like
+ * udeskPixmapFileAsyncEXT(), but rows are decoded top to bottom in
+ * bands and the pixmap holds the full size image as soon as the first
+ * band is decoded, rows not decoded yet are transparent. Each band is
+ * uploaded as it completes, windows presenting the pixmap are damaged
+ * where its pixels changed and the pixmap delivers an
+ * UDESK_EVENT_PROGRESS_EXT event, flushing the window shows the new
+ * rows. The load still completes with an UDESK_EVENT_LOAD_EXT event.
+ * Memory used while decoding is bounded by a band of rows, formats
+ * which can't be decoded in bands are shown at completion only.
+ */
+#ifndef UDESK_STREAM_PIXMAP_EXT
+#define UDESK_STREAM_PIXMAP_EXT
+
+enum {
+  /* Event type, a progressive pixmap load decoded more rows. */
+  UDESK_EVENT_PROGRESS_EXT = 0x80a0,
+#define UDESK_EVENT_PROGRESS_EXT UDESK_EVENT_PROGRESS_EXT
+
+  /* Pixmap field, int value, read only, rows of the pixmap decoded
+   * so far, its height unless a load is pending.
+   */
+  UDESK_PIXMAP_ROWS_EXT = 0x80a1
+#define UDESK_PIXMAP_ROWS_EXT    UDESK_PIXMAP_ROWS_EXT
+
+};
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI void UDESKAPIENTRY udeskPixmapFileStreamEXT(UDhandle pixmap, UDenum target, const char* name, UDenum usage);
+#endif
+typedef void (UDESKAPIENTRYP PFNUDESKPIXMAPFILESTREAMEXTPROC)(UDhandle pixmap, UDenum target, const char* name, UDenum usage);
+#endif /* UDESK_STREAM_PIXMAP_EXT */
+
+/* ==========
+ * Pixmap area updates: UDESK_PIXMAP_SUB_DATA_EXT
+ *
+ * udeskPixmapSubDataEXT() overwrites the 'width' x 'height' area at
+ * 'x', 'y' of the pixels of a pixmap with 'data', in any format
+ * accepted by udeskPixmapData(). Pixels shared with other pixmaps are
+ * copied first, those pixmaps are left untouched, and only the
+ * written area is uploaded again. The pixmap must have pixels and no
+ * pending load, or an UDESK_INVALID_OPERATION error is set, the area
+ * must lie within it, or an UDESK_INVALID_VALUE error is set.
+ */
+#ifndef UDESK_PIXMAP_SUB_DATA_EXT
+#define UDESK_PIXMAP_SUB_DATA_EXT
+
+#ifdef UDESK_EXT_PROTOTYPES
+UDESKAPI void UDESKAPIENTRY udeskPixmapSubDataEXT(UDhandle pixmap, UDint x, UDint y, UDint width, UDint height, UDenum format, const void* data);
+#endif
+typedef void (UDESKAPIENTRYP PFNUDESKPIXMAPSUBDATAEXTPROC)(UDhandle pixmap, UDint x, UDint y, UDint width, UDint height, UDenum format, const void* data);
+#endif /* UDESK_PIXMAP_SUB_DATA_EXT */
+
 #ifdef __cplusplus
 }
 #endif